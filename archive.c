@@ -0,0 +1,468 @@
+/*
+ * Delta-encoded result archive (see archive.h)
+ *
+ * Block layout (all varints are unsigned LEB128):
+ *     varint    payload length in bytes (everything below)
+ *     varint    record count n
+ *     16 bytes  first address
+ *     n-1 *     address deltas: varint (delta << 1), or varint 1 followed by
+ *               16 raw bytes when the delta does not fit in 63 bits
+ *     varint    dictionary size d
+ *     d *       varint deltas between consecutive dictionary ports
+ *     packed    n port indexes, ceil(log2 d) bits each
+ *     packed    n states, 2 bits each
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "archive.h"
+
+#define ARC_MAGIC "PSARC1\n"
+#define IDX_MAGIC "PSIDX1\n"
+#define ARC_HEADER 16
+#define ARC_FOOTER 20
+#define IDX_ENTRY 30
+
+// ---- little helpers ----
+
+static void put_le(unsigned char *p, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++)
+        p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static uint64_t get_le(const unsigned char *p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++)
+        v |= (uint64_t)p[i] << (8 * i);
+    return v;
+}
+
+static size_t put_varint(unsigned char *p, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (unsigned char)v;
+    return n;
+}
+
+// Returns bytes consumed, 0 on truncated input
+static size_t get_varint(const unsigned char *p, const unsigned char *end, uint64_t *v) {
+    uint64_t x = 0;
+    for (size_t n = 0; n < 10 && p + n < end; n++) {
+        x |= (uint64_t)(p[n] & 0x7f) << (7 * n);
+        if ((p[n] & 0x80) == 0) {
+            *v = x;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+static int bits_for(uint32_t d) {
+    int bits = 0;
+    while ((1u << bits) < d)
+        bits++;
+    return bits;
+}
+
+// Split a 16-byte big-endian address into two 64-bit halves
+static void addr_split(const unsigned char a[16], uint64_t *hi, uint64_t *lo) {
+    *hi = 0;
+    *lo = 0;
+    for (int i = 0; i < 8; i++) {
+        *hi = (*hi << 8) | a[i];
+        *lo = (*lo << 8) | a[8 + i];
+    }
+}
+
+static void addr_join(unsigned char a[16], uint64_t hi, uint64_t lo) {
+    for (int i = 7; i >= 0; i--) {
+        a[i] = (unsigned char)hi;
+        a[8 + i] = (unsigned char)lo;
+        hi >>= 8;
+        lo >>= 8;
+    }
+}
+
+static int rec_cmp(const ArcRecord *a, const unsigned char addr[16], uint16_t port) {
+    int c = memcmp(a->addr, addr, 16);
+    if (c != 0) return c;
+    return (a->port > port) - (a->port < port);
+}
+
+static int port_cmp(const void *a, const void *b) {
+    return (int)*(const uint16_t*)a - (int)*(const uint16_t*)b;
+}
+
+static int ensure_buf(unsigned char **buf, size_t *cap, size_t need) {
+    if (*cap >= need)
+        return 0;
+    unsigned char *p = realloc(*buf, need);
+    if (p == NULL)
+        return -1;
+    *buf = p;
+    *cap = need;
+    return 0;
+}
+
+// ---- writer ----
+
+int arc_writer_open(ArcWriter *w, const char *path) {
+    memset(w, 0, sizeof(*w));
+    w->block = malloc(ARC_BLOCK_RECORDS * sizeof(ArcRecord));
+    if (w->block == NULL)
+        return -1;
+
+    w->f = fopen(path, "wb");
+    if (!w->f) {
+        printf("Archive: could not create %s\n", path);
+        free(w->block);
+        return -1;
+    }
+    setvbuf(w->f, NULL, _IOFBF, 1 << 16);
+
+    unsigned char header[ARC_HEADER] = {0};
+    memcpy(header, ARC_MAGIC, 8);
+    put_le(header + 8, ARC_BLOCK_RECORDS, 4);
+    if (fwrite(header, 1, ARC_HEADER, w->f) != ARC_HEADER) {
+        fclose(w->f);
+        free(w->block);
+        return -1;
+    }
+    return 0;
+}
+
+// Encode the buffered records as one block and append it
+static int flush_block(ArcWriter *w) {
+    uint32_t n = w->count;
+    if (n == 0)
+        return 0;
+
+    // Worst case: per record 1+16 address bytes, 2 index bytes, plus the
+    // dictionary (3 bytes per port) and fixed fields
+    size_t need = 64 + (size_t)n * (17 + 3 + 3);
+    if (ensure_buf(&w->buf, &w->buf_cap, need) != 0)
+        return -1;
+
+    // Per-block port dictionary
+    uint16_t dict[ARC_BLOCK_RECORDS];
+    for (uint32_t i = 0; i < n; i++)
+        dict[i] = w->block[i].port;
+    qsort(dict, n, sizeof(uint16_t), port_cmp);
+    uint32_t d = 0;
+    for (uint32_t i = 0; i < n; i++)
+        if (d == 0 || dict[d - 1] != dict[i])
+            dict[d++] = dict[i];
+
+    // Payload is built after a reserved slot for its own length
+    unsigned char *p = w->buf + 10;
+    unsigned char *start = p;
+
+    p += put_varint(p, n);
+    memcpy(p, w->block[0].addr, 16);
+    p += 16;
+
+    uint64_t prev_hi, prev_lo;
+    addr_split(w->block[0].addr, &prev_hi, &prev_lo);
+    for (uint32_t i = 1; i < n; i++) {
+        uint64_t hi, lo;
+        addr_split(w->block[i].addr, &hi, &lo);
+        // 128-bit subtraction; sorted input guarantees cur >= prev
+        uint64_t dlo = lo - prev_lo;
+        uint64_t dhi = hi - prev_hi - (lo < prev_lo);
+        if (dhi == 0 && dlo < (1ULL << 63)) {
+            p += put_varint(p, dlo << 1);
+        } else {
+            p += put_varint(p, 1);
+            memcpy(p, w->block[i].addr, 16);
+            p += 16;
+        }
+        prev_hi = hi;
+        prev_lo = lo;
+    }
+
+    p += put_varint(p, d);
+    for (uint32_t i = 0; i < d; i++)
+        p += put_varint(p, i == 0 ? dict[0] : (uint64_t)(dict[i] - dict[i - 1]));
+
+    // Bit-packed port index column
+    int bits = bits_for(d);
+    size_t col = ((size_t)n * bits + 7) / 8;
+    memset(p, 0, col);
+    size_t bitpos = 0;
+    for (uint32_t i = 0; i < n && bits > 0; i++) {
+        uint16_t *hit = bsearch(&w->block[i].port, dict, d, sizeof(uint16_t), port_cmp);
+        uint32_t idx = (uint32_t)(hit - dict);
+        for (int b = 0; b < bits; b++, bitpos++)
+            if (idx & (1u << b))
+                p[bitpos >> 3] |= (unsigned char)(1u << (bitpos & 7));
+    }
+    p += col;
+
+    // Bit-packed state column, four states per byte
+    col = ((size_t)n * 2 + 7) / 8;
+    memset(p, 0, col);
+    for (uint32_t i = 0; i < n; i++)
+        p[i >> 2] |= (unsigned char)((w->block[i].state & 3) << ((i & 3) * 2));
+    p += col;
+
+    // Prepend the payload length
+    size_t payload = (size_t)(p - start);
+    unsigned char len[10];
+    size_t len_bytes = put_varint(len, payload);
+    memcpy(start - len_bytes, len, len_bytes);
+
+    // Record the block in the sparse index
+    if (w->num_blocks == w->cap_blocks) {
+        uint32_t cap = w->cap_blocks ? w->cap_blocks * 2 : 64;
+        ArcBlockInfo *idx = realloc(w->index, cap * sizeof(ArcBlockInfo));
+        if (idx == NULL)
+            return -1;
+        w->index = idx;
+        w->cap_blocks = cap;
+    }
+    ArcBlockInfo *info = &w->index[w->num_blocks++];
+    memcpy(info->addr, w->block[0].addr, 16);
+    info->port = w->block[0].port;
+    info->offset = (uint64_t)_ftelli64(w->f);
+    info->count = n;
+
+    if (fwrite(start - len_bytes, 1, payload + len_bytes, w->f) != payload + len_bytes)
+        return -1;
+
+    w->count = 0;
+    return 0;
+}
+
+int arc_writer_put(ArcWriter *w, const ArcRecord *r) {
+    if (w->have_last && rec_cmp(&w->last, r->addr, r->port) >= 0) {
+        printf("Archive: records must be strictly sorted by address and port.\n");
+        return -1;
+    }
+    w->block[w->count++] = *r;
+    w->last = *r;
+    w->have_last = 1;
+    w->written++;
+    if (w->count == ARC_BLOCK_RECORDS)
+        return flush_block(w);
+    return 0;
+}
+
+int arc_writer_close(ArcWriter *w) {
+    int rc = flush_block(w);
+
+    uint64_t index_offset = (uint64_t)_ftelli64(w->f);
+    unsigned char entry[IDX_ENTRY];
+    for (uint32_t i = 0; i < w->num_blocks && rc == 0; i++) {
+        memcpy(entry, w->index[i].addr, 16);
+        put_le(entry + 16, w->index[i].port, 2);
+        put_le(entry + 18, w->index[i].offset, 8);
+        put_le(entry + 26, w->index[i].count, 4);
+        if (fwrite(entry, 1, IDX_ENTRY, w->f) != IDX_ENTRY)
+            rc = -1;
+    }
+
+    unsigned char footer[ARC_FOOTER];
+    put_le(footer, index_offset, 8);
+    put_le(footer + 8, w->num_blocks, 4);
+    memcpy(footer + 12, IDX_MAGIC, 8);
+    if (rc == 0 && fwrite(footer, 1, ARC_FOOTER, w->f) != ARC_FOOTER)
+        rc = -1;
+
+    if (fclose(w->f) != 0)
+        rc = -1;
+    free(w->block);
+    free(w->index);
+    free(w->buf);
+    return rc;
+}
+
+// ---- reader ----
+
+int arc_reader_open(ArcReader *r, const char *path) {
+    unsigned char header[ARC_HEADER], footer[ARC_FOOTER];
+
+    memset(r, 0, sizeof(*r));
+    r->f = fopen(path, "rb");
+    if (!r->f) {
+        printf("Archive: could not open %s\n", path);
+        return -1;
+    }
+
+    if (fread(header, 1, ARC_HEADER, r->f) != ARC_HEADER ||
+        memcmp(header, ARC_MAGIC, 8) != 0 ||
+        _fseeki64(r->f, -ARC_FOOTER, SEEK_END) != 0 ||
+        fread(footer, 1, ARC_FOOTER, r->f) != ARC_FOOTER ||
+        memcmp(footer + 12, IDX_MAGIC, 8) != 0 ||
+        get_le(header + 8, 4) == 0 || get_le(header + 8, 4) > ARC_BLOCK_RECORDS) {
+        // Blocks are decoded into buffers of ARC_BLOCK_RECORDS at most
+        printf("Archive: %s is not a result archive.\n", path);
+        arc_reader_close(r);
+        return -1;
+    }
+
+    uint64_t block_records = get_le(header + 8, 4);
+    uint64_t index_offset = get_le(footer, 8);
+    r->num_blocks = (uint32_t)get_le(footer + 8, 4);
+    r->index = calloc(r->num_blocks ? r->num_blocks : 1, sizeof(ArcBlockInfo));
+    r->block = malloc((block_records + 1) * sizeof(ArcRecord));
+    if (r->index == NULL || r->block == NULL ||
+        _fseeki64(r->f, (long long)index_offset, SEEK_SET) != 0) {
+        arc_reader_close(r);
+        return -1;
+    }
+
+    unsigned char entry[IDX_ENTRY];
+    for (uint32_t i = 0; i < r->num_blocks; i++) {
+        if (fread(entry, 1, IDX_ENTRY, r->f) != IDX_ENTRY) {
+            arc_reader_close(r);
+            return -1;
+        }
+        memcpy(r->index[i].addr, entry, 16);
+        r->index[i].port = (uint16_t)get_le(entry + 16, 2);
+        r->index[i].offset = get_le(entry + 18, 8);
+        r->index[i].count = (uint32_t)get_le(entry + 26, 4);
+        if (r->index[i].count == 0 || r->index[i].count > block_records) {
+            printf("Archive: %s has a corrupt index.\n", path);
+            arc_reader_close(r);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Decode block b into r->block
+static int decode_block(ArcReader *r, uint32_t b) {
+    unsigned char len[10];
+    uint64_t payload = 0;
+
+    if (_fseeki64(r->f, (long long)r->index[b].offset, SEEK_SET) != 0 ||
+        fread(len, 1, sizeof(len), r->f) == 0)
+        return -1;
+    size_t used = get_varint(len, len + sizeof(len), &payload);
+    if (used == 0 ||
+        ensure_buf(&r->buf, &r->buf_cap, payload) != 0 ||
+        _fseeki64(r->f, (long long)(r->index[b].offset + used), SEEK_SET) != 0 ||
+        fread(r->buf, 1, payload, r->f) != payload)
+        return -1;
+
+    const unsigned char *p = r->buf, *end = r->buf + payload;
+    uint64_t n, d, v;
+
+    if ((used = get_varint(p, end, &n)) == 0 || n != r->index[b].count || end - p < 16)
+        return -1;
+    p += used;
+
+    memcpy(r->block[0].addr, p, 16);
+    p += 16;
+    uint64_t hi, lo;
+    addr_split(r->block[0].addr, &hi, &lo);
+    for (uint64_t i = 1; i < n; i++) {
+        if ((used = get_varint(p, end, &v)) == 0)
+            return -1;
+        p += used;
+        if (v & 1) {
+            if (end - p < 16)
+                return -1;
+            memcpy(r->block[i].addr, p, 16);
+            p += 16;
+            addr_split(r->block[i].addr, &hi, &lo);
+        } else {
+            uint64_t delta = v >> 1;
+            hi += (lo + delta < lo);
+            lo += delta;
+            addr_join(r->block[i].addr, hi, lo);
+        }
+    }
+
+    if ((used = get_varint(p, end, &d)) == 0 || d == 0 || d > n ||
+        d > ARC_BLOCK_RECORDS)
+        return -1;
+    p += used;
+    uint16_t dict[ARC_BLOCK_RECORDS];
+    uint64_t port = 0;
+    for (uint64_t i = 0; i < d; i++) {
+        if ((used = get_varint(p, end, &v)) == 0)
+            return -1;
+        p += used;
+        port += v;
+        dict[i] = (uint16_t)port;
+    }
+
+    int bits = bits_for((uint32_t)d);
+    size_t col = ((size_t)n * bits + 7) / 8;
+    if ((size_t)(end - p) < col + ((size_t)n * 2 + 7) / 8)
+        return -1;
+    size_t bitpos = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        uint32_t idx = 0;
+        for (int k = 0; k < bits; k++, bitpos++)
+            if (p[bitpos >> 3] & (1u << (bitpos & 7)))
+                idx |= 1u << k;
+        if (idx >= d)
+            return -1;
+        r->block[i].port = dict[idx];
+    }
+    p += col;
+
+    for (uint64_t i = 0; i < n; i++)
+        r->block[i].state = (p[i >> 2] >> ((i & 3) * 2)) & 3;
+
+    r->count = (uint32_t)n;
+    r->pos = 0;
+    r->next_block = b + 1;
+    return 0;
+}
+
+int arc_reader_seek(ArcReader *r, const unsigned char addr[16], uint16_t port) {
+    // Last block whose first key is <= target
+    uint32_t lo = 0, hi = r->num_blocks;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        ArcRecord key;
+        memcpy(key.addr, r->index[mid].addr, 16);
+        key.port = r->index[mid].port;
+        if (rec_cmp(&key, addr, port) <= 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    r->count = 0;
+    r->pos = 0;
+    r->next_block = lo > 0 ? lo - 1 : 0;
+    if (r->next_block >= r->num_blocks)
+        return 0;
+    if (decode_block(r, r->next_block) != 0)
+        return -1;
+    while (r->pos < r->count && rec_cmp(&r->block[r->pos], addr, port) < 0)
+        r->pos++;
+    return 0;
+}
+
+int arc_reader_next(ArcReader *r, ArcRecord *out) {
+    while (r->pos >= r->count) {
+        if (r->next_block >= r->num_blocks)
+            return 0;
+        if (decode_block(r, r->next_block) != 0) {
+            printf("Archive: corrupt block %u\n", (unsigned)r->next_block);
+            return -1;
+        }
+    }
+    *out = r->block[r->pos++];
+    return 1;
+}
+
+void arc_reader_close(ArcReader *r) {
+    if (r->f)
+        fclose(r->f);
+    free(r->index);
+    free(r->block);
+    free(r->buf);
+    memset(r, 0, sizeof(*r));
+}
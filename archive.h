@@ -0,0 +1,77 @@
+/*
+ * Delta-encoded result archive
+ * Description:
+ *     Compact columnar encoding of sorted (address, port, state) results.
+ *     Records are grouped into blocks; within a block addresses are stored
+ *     as varint deltas, ports as indexes into a per-block dictionary and
+ *     states as a 2-bit packed column. A sparse index of block start keys
+ *     at the end of the file allows seeking without decoding earlier blocks.
+ *
+ * Layout:
+ *     header   "PSARC1\n\0", uint32 records per block, uint32 reserved
+ *     blocks   see flush_block() in archive.c
+ *     index    per block: first addr[16], first port, offset, count
+ *     footer   uint64 index offset, uint32 block count, "PSIDX1\n\0"
+ */
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define ARC_BLOCK_RECORDS 4096
+
+typedef struct {
+    unsigned char addr[16]; // IPv6 or IPv4-mapped address
+    uint16_t port;
+    uint8_t state;          // PortState
+} ArcRecord;
+
+// Sparse index entry (one per block)
+typedef struct {
+    unsigned char addr[16];
+    uint16_t port;
+    uint64_t offset;
+    uint32_t count;
+} ArcBlockInfo;
+
+typedef struct {
+    FILE *f;
+    ArcRecord *block;       // records buffered for the current block
+    uint32_t count;
+    ArcBlockInfo *index;
+    uint32_t num_blocks;
+    uint32_t cap_blocks;
+    unsigned char *buf;     // encode scratch
+    size_t buf_cap;
+    ArcRecord last;
+    int have_last;
+    uint64_t written;       // total records
+} ArcWriter;
+
+typedef struct {
+    FILE *f;
+    ArcBlockInfo *index;
+    uint32_t num_blocks;
+    uint32_t next_block;    // next block to decode
+    ArcRecord *block;       // decoded records of the current block
+    uint32_t count;
+    uint32_t pos;           // next record within block
+    unsigned char *buf;
+    size_t buf_cap;
+} ArcReader;
+
+// Writer: records must be put in ascending (address, port) order
+int arc_writer_open(ArcWriter *w, const char *path);
+int arc_writer_put(ArcWriter *w, const ArcRecord *r);
+int arc_writer_close(ArcWriter *w);   // flushes last block, index, footer
+
+// Reader: sequential decode, optionally after a seek
+int arc_reader_open(ArcReader *r, const char *path);
+int arc_reader_seek(ArcReader *r, const unsigned char addr[16], uint16_t port);
+int arc_reader_next(ArcReader *r, ArcRecord *out); // 1 = record, 0 = end, -1 = error
+void arc_reader_close(ArcReader *r);
+
+#endif
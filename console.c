@@ -0,0 +1,137 @@
+/*
+ * Console renderer (see console.h)
+ */
+
+#include <windows.h>
+#include <io.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "console.h"
+
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+
+// Ring of pending lines. Workers fill slots at head under the lock; the
+// renderer prints slots from tail without it (workers never touch slots
+// between tail and head) and then advances tail.
+static char LINES[CONSOLE_RING][CONSOLE_LINE_MAX];
+static uint16_t LENS[CONSOLE_RING];
+static uint64_t HEAD, TAIL;
+static int64_t DROPPED;             // lines lost to a full ring
+static int64_t PUSHED;              // lines queued in total
+static pthread_mutex_t LOCK = PTHREAD_MUTEX_INITIALIZER;
+
+static int COLOR = 0;
+static int RUNNING = 0;
+static volatile LONG STOP = 0;
+static pthread_t THREAD;
+
+static int64_t (*PROGRESS)(void *ctx);
+static void *PROGRESS_CTX;
+static int64_t TOTAL;
+
+int console_init(void) {
+    COLOR = 0;
+    if (!_isatty(_fileno(stdout)))
+        return 0;
+
+    // Windows consoles interpret ANSI codes only in virtual terminal mode
+    HANDLE h = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD mode;
+    if (GetConsoleMode(h, &mode) &&
+        SetConsoleMode(h, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING))
+        COLOR = 1;
+    return COLOR;
+}
+
+int console_color(void) {
+    return COLOR;
+}
+
+void console_push(const char *line, size_t len) {
+    if (len > CONSOLE_LINE_MAX)
+        len = CONSOLE_LINE_MAX;
+
+    pthread_mutex_lock(&LOCK);
+    if (!RUNNING) {
+        fwrite(line, 1, len, stdout);   // no renderer: print in place
+    } else if (HEAD - TAIL == CONSOLE_RING) {
+        DROPPED++;
+    } else {
+        size_t slot = (size_t)(HEAD % CONSOLE_RING);
+        memcpy(LINES[slot], line, len);
+        LENS[slot] = (uint16_t)len;
+        HEAD++;
+    }
+    PUSHED++;
+    pthread_mutex_unlock(&LOCK);
+}
+
+// Print up to one tick's worth of lines (the rest wait for the next tick,
+// or all of them on the final one), note lines the full ring dropped,
+// refresh progress
+static void render_tick(int final) {
+    pthread_mutex_lock(&LOCK);
+    uint64_t head = HEAD, tail = TAIL;
+    int64_t dropped = DROPPED, pushed = PUSHED;
+    DROPPED = 0;
+    pthread_mutex_unlock(&LOCK);
+
+    uint64_t shown = head - tail;
+    if (!final && shown > CONSOLE_LINES_PER_TICK)
+        shown = CONSOLE_LINES_PER_TICK;
+    int64_t folded = dropped;
+
+    if (COLOR)
+        fputs("\r\x1b[K", stdout);  // clear the progress line
+    for (uint64_t i = tail; i < tail + shown; i++) {
+        size_t slot = (size_t)(i % CONSOLE_RING);
+        fwrite(LINES[slot], 1, LENS[slot], stdout);
+    }
+    if (folded > 0)
+        printf("  ... %lld more results (see scan_results.txt)\n", (long long)folded);
+
+    if (COLOR && !final && PROGRESS != NULL && TOTAL > 0) {
+        int64_t done = PROGRESS(PROGRESS_CTX);
+        printf("Progress: %5.1f%%  %lld/%lld probes, %lld open",
+               100.0 * (double)done / (double)TOTAL, (long long)done,
+               (long long)TOTAL, (long long)pushed);
+    }
+    fflush(stdout);
+
+    pthread_mutex_lock(&LOCK);
+    TAIL = tail + shown;
+    pthread_mutex_unlock(&LOCK);
+}
+
+static void *renderer(void *arg) {
+    (void)arg;
+    while (!STOP) {
+        render_tick(0);
+        Sleep(CONSOLE_TICK_MS);
+    }
+    render_tick(1);
+    return NULL;
+}
+
+int console_start(int64_t (*progress)(void *ctx), void *ctx, int64_t total) {
+    PROGRESS = progress;
+    PROGRESS_CTX = ctx;
+    TOTAL = total;
+    InterlockedExchange(&STOP, 0);
+    if (pthread_create(&THREAD, NULL, renderer, NULL) != 0)
+        return -1;
+    RUNNING = 1;
+    return 0;
+}
+
+void console_stop(void) {
+    if (!RUNNING)
+        return;
+    InterlockedExchange(&STOP, 1);
+    pthread_join(THREAD, NULL);
+    RUNNING = 0;
+}
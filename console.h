@@ -0,0 +1,46 @@
+/*
+ * Console renderer
+ * Description:
+ *     Workers used to print every open port to stdout themselves, under
+ *     print_lock, so a slow terminal or SSH session throttled the whole
+ *     scan. Now a worker copies its rendered line into a bounded ring and
+ *     carries on; a single renderer thread does the printing:
+ *
+ *       - it wakes every CONSOLE_TICK_MS and prints at most
+ *         CONSOLE_LINES_PER_TICK lines; the rest wait in the ring for the
+ *         next tick, so a burst is only spread out, not cut
+ *       - on a terminal, a progress line is kept up to date in place
+ *       - a full ring drops the line from the console instead of waiting;
+ *         dropped lines are counted in one "... N more" line (every result
+ *         is still in scan_results.txt)
+ *
+ *     ANSI colors are used only when stdout is a console that accepts them.
+ */
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CONSOLE_RING 1024           // lines buffered for the renderer
+#define CONSOLE_LINE_MAX 1024       // longest line kept (longer ones are cut)
+#define CONSOLE_TICK_MS 100
+#define CONSOLE_LINES_PER_TICK 20   // i.e. 200 lines per second
+
+// Detect whether stdout takes ANSI colors (enabling them on Windows 10+
+// consoles). Returns the result, also available from console_color().
+int console_init(void);
+int console_color(void);
+
+// Start the renderer. progress(ctx) returns jobs handed out so far out of
+// total; it is polled once per tick for the progress line.
+int console_start(int64_t (*progress)(void *ctx), void *ctx, int64_t total);
+
+// Queue a line for the console; never blocks on console output
+void console_push(const char *line, size_t len);
+
+// Print what is left and stop the renderer (no-op if it isn't running)
+void console_stop(void);
+
+#endif
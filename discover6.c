@@ -0,0 +1,196 @@
+/*
+ * IPv6 on-link host discovery (see discover6.h)
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <iphlpapi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "scanner.h"
+#include "discover6.h"
+
+#define ICMP6_ECHO_REQUEST 128
+#define ICMP6_ECHO_REPLY 129
+#define ICMP6_NEIGHBOR_ADVERT 136
+
+typedef struct {
+    unsigned char (*addrs)[16];
+    size_t count;
+    size_t cap;
+} HostList;
+
+static int host_add(HostList *h, const unsigned char addr[16]) {
+    if (addr[0] == 0xff)
+        return 0;   // never a host
+    if (h->count == h->cap) {
+        size_t cap = h->cap ? h->cap * 2 : 64;
+        unsigned char (*addrs)[16] = realloc(h->addrs, cap * 16);
+        if (addrs == NULL)
+            return -1;
+        h->addrs = addrs;
+        h->cap = cap;
+    }
+    memcpy(h->addrs[h->count++], addr, 16);
+    return 0;
+}
+
+static int addr_cmp(const void *a, const void *b) {
+    return memcmp(a, b, 16);
+}
+
+unsigned int nd6_interface(const char *name) {
+    char *end;
+    unsigned long idx = strtoul(name, &end, 10);
+    if (*name == '\0' || *end != '\0')
+        idx = if_nametoindex(name);
+    return (unsigned int)idx;
+}
+
+int nd6_parse_spec(const char *spec, unsigned int *if_index) {
+    static const char prefix[] = "ff02::1%";
+    if (strncmp(spec, prefix, sizeof(prefix) - 1) != 0)
+        return 0;
+    *if_index = nd6_interface(spec + sizeof(prefix) - 1);
+    return 1;
+}
+
+// Send echo requests to ff02::1 and collect echo replies and neighbor
+// advertisements for wait_ms
+static int multicast_echo(SOCKET s, unsigned int if_index, int wait_ms, HostList *h) {
+    struct sockaddr_in6 group = {0};
+    group.sin6_family = AF_INET6;
+    inet_pton(AF_INET6, "ff02::1", &group.sin6_addr);
+    group.sin6_scope_id = if_index;
+
+    // Send on the chosen link only, without looping our own pings back
+    int off = 0, hops = 1;
+    setsockopt(s, IPPROTO_IPV6, IPV6_MULTICAST_IF, (char*)&if_index, sizeof(if_index));
+    setsockopt(s, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, (char*)&off, sizeof(off));
+    setsockopt(s, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, (char*)&hops, sizeof(hops));
+
+    // The stack fills in the ICMPv6 checksum for raw ICMPv6 sockets
+    uint16_t id = (uint16_t)(time(NULL) ^ 0x5053);
+    unsigned char echo[16] = { ICMP6_ECHO_REQUEST, 0, 0, 0,
+                               (unsigned char)(id >> 8), (unsigned char)id, 0, 0,
+                               'p', 'o', 'r', 't', 's', 'c', 'a', 'n' };
+
+    double start = now_ms();
+    double next_send = start;
+    int sent = 0, replies = 0;
+
+    while (1) {
+        double now = now_ms();
+        if (now - start >= wait_ms)
+            break;
+
+        if (sent < ND6_ROUNDS && now >= next_send) {
+            echo[7] = (unsigned char)sent;
+            if (sendto(s, (const char*)echo, sizeof(echo), 0,
+                       (struct sockaddr*)&group, sizeof(group)) < 0) {
+                printf("Discovery: multicast echo failed (error %d).\n", WSAGetLastError());
+                return -1;
+            }
+            sent++;
+            next_send = start + (double)wait_ms * sent / (ND6_ROUNDS + 1);
+        }
+
+        // Wait for a reply, the next send, or the end of the window
+        double until = sent < ND6_ROUNDS ? next_send : start + wait_ms;
+        double left = until - now_ms();
+        if (left < 0)
+            left = 0;
+        fd_set rd;
+        FD_ZERO(&rd);
+        FD_SET(s, &rd);
+        struct timeval tv = { (long)(left / 1000), (long)((int)left % 1000) * 1000 };
+        if (select((int)s + 1, &rd, NULL, NULL, &tv) <= 0)
+            continue;
+
+        unsigned char buf[1500];
+        struct sockaddr_in6 from;
+        socklen_t from_len = sizeof(from);
+        int n = recvfrom(s, (char*)buf, sizeof(buf), 0, (struct sockaddr*)&from, &from_len);
+        if (n < 8)
+            continue;
+
+        int is_reply = buf[0] == ICMP6_ECHO_REPLY && buf[4] == (unsigned char)(id >> 8) &&
+                       buf[5] == (unsigned char)id;
+        if (is_reply || buf[0] == ICMP6_NEIGHBOR_ADVERT) {
+            if (host_add(h, (const unsigned char*)&from.sin6_addr) != 0)
+                return -1;
+            replies++;
+        }
+    }
+
+    printf("Discovery: %d replies to multicast echo\n", replies);
+    return 0;
+}
+
+// Add reachable / recently reachable neighbors known to the system
+static int harvest_neighbors(unsigned int if_index, HostList *h) {
+    PMIB_IPNET_TABLE2 table = NULL;
+    if (GetIpNetTable2(AF_INET6, &table) != NO_ERROR)
+        return 0;
+
+    int added = 0;
+    for (ULONG i = 0; i < table->NumEntries; i++) {
+        MIB_IPNET_ROW2 *row = &table->Table[i];
+        if (row->InterfaceIndex != if_index ||
+            row->State == NlnsUnreachable || row->State == NlnsIncomplete)
+            continue;
+        if (host_add(h, (const unsigned char*)&row->Address.Ipv6.sin6_addr) != 0) {
+            FreeMibTable(table);
+            return -1;
+        }
+        added++;
+    }
+    FreeMibTable(table);
+
+    printf("Discovery: %d entries in the neighbor cache\n", added);
+    return 0;
+}
+
+int nd6_discover(unsigned int if_index, int wait_ms, unsigned char (**hosts)[16],
+                 size_t *count) {
+    HostList h = {0};
+
+    if (if_index == 0) {
+        printf("Discovery: unknown interface.\n");
+        return -1;
+    }
+
+    SOCKET s = socket(AF_INET6, SOCK_RAW, IPPROTO_ICMPV6);
+    if (s == INVALID_SOCKET) {
+        printf("Discovery: no raw ICMPv6 socket (run as administrator); "
+               "using the neighbor cache only.\n");
+    } else {
+        int rc = multicast_echo(s, if_index, wait_ms, &h);
+        closesocket(s);
+        if (rc != 0) {
+            free(h.addrs);
+            return -1;
+        }
+    }
+
+    // Read the cache after the echo: replies have populated it
+    if (harvest_neighbors(if_index, &h) != 0) {
+        free(h.addrs);
+        return -1;
+    }
+
+    // Sort (job order must be address order) and drop duplicates
+    qsort(h.addrs, h.count, 16, addr_cmp);
+    size_t unique = 0;
+    for (size_t i = 0; i < h.count; i++)
+        if (unique == 0 || memcmp(h.addrs[unique - 1], h.addrs[i], 16) != 0)
+            memcpy(h.addrs[unique++], h.addrs[i], 16);
+
+    *hosts = h.addrs;
+    *count = unique;
+    return 0;
+}
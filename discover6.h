@@ -0,0 +1,39 @@
+/*
+ * IPv6 on-link host discovery
+ * Description:
+ *     IPv6 subnets are far too large to sweep, so hosts on the local link
+ *     are found by asking instead: an ICMPv6 echo request to the all-nodes
+ *     multicast group ff02::1 is answered by every node that responds to
+ *     multicast pings, and the neighbor advertisements seen meanwhile plus
+ *     the system neighbor cache (hosts that answered neighbor solicitation)
+ *     add those that don't. The result is a sorted host list for the job
+ *     queue.
+ *
+ *     Target spec: ff02::1%<interface>, where interface is an index or name.
+ *     Sending the echo needs a raw socket (administrator); without one only
+ *     the neighbor cache is used.
+ */
+
+#ifndef DISCOVER6_H
+#define DISCOVER6_H
+
+#include <stddef.h>
+
+// How long to collect replies after the first echo request
+#define ND6_WAIT_MS 2000
+
+// Echo requests sent (spread over the wait) to ride out packet loss
+#define ND6_ROUNDS 3
+
+// Interface index from a number or an interface name; 0 if unknown
+unsigned int nd6_interface(const char *name);
+
+// Returns 1 if spec asks for on-link discovery; *if_index is its interface
+int nd6_parse_spec(const char *spec, unsigned int *if_index);
+
+// Discover hosts on interface if_index. *hosts receives a sorted list of
+// unique 16-byte addresses (caller frees). Returns 0, or -1 after printing why.
+int nd6_discover(unsigned int if_index, int wait_ms, unsigned char (**hosts)[16],
+                 size_t *count);
+
+#endif
@@ -0,0 +1,216 @@
+/*
+ * Built-in enrichment stages (see enrich.h)
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scanner.h"
+#include "pipeline.h"
+#include "enrich.h"
+
+// Socket address of an item's host and port; returns its length
+static int item_sockaddr(const PipeItem *item, struct sockaddr_storage *ss) {
+    memset(ss, 0, sizeof(*ss));
+    if (addr_is_ipv4(item->addr)) {
+        struct sockaddr_in *sin = (struct sockaddr_in*)ss;
+        sin->sin_family = AF_INET;
+        memcpy(&sin->sin_addr, item->addr + 12, 4);
+        sin->sin_port = htons(item->port);
+        return sizeof(*sin);
+    }
+    struct sockaddr_in6 *sin6 = (struct sockaddr_in6*)ss;
+    sin6->sin6_family = AF_INET6;
+    memcpy(&sin6->sin6_addr, item->addr, 16);
+    sin6->sin6_port = htons(item->port);
+    sin6->sin6_scope_id = item->scope_id;
+    return sizeof(*sin6);
+}
+
+// ---- rdns ----
+
+static int stage_rdns(const PipeItem *item, char *out, size_t cap) {
+    struct sockaddr_storage ss;
+    int len = item_sockaddr(item, &ss);
+    char host[NI_MAXHOST];
+    if (getnameinfo((struct sockaddr*)&ss, len, host, sizeof(host), NULL, 0, NI_NAMEREQD) != 0)
+        return 0;
+    snprintf(out, cap, "%s", host);
+    return 1;
+}
+
+// ---- tls ----
+
+static const struct { uint16_t id; const char *name; } TLS_CIPHERS[] = {
+    { 0x1301, "TLS_AES_128_GCM_SHA256" },
+    { 0x1302, "TLS_AES_256_GCM_SHA384" },
+    { 0x1303, "TLS_CHACHA20_POLY1305_SHA256" },
+    { 0xc02b, "ECDHE-ECDSA-AES128-GCM-SHA256" },
+    { 0xc02c, "ECDHE-ECDSA-AES256-GCM-SHA384" },
+    { 0xc02f, "ECDHE-RSA-AES128-GCM-SHA256" },
+    { 0xc030, "ECDHE-RSA-AES256-GCM-SHA384" },
+    { 0xcca8, "ECDHE-RSA-CHACHA20-POLY1305" },
+    { 0xcca9, "ECDHE-ECDSA-CHACHA20-POLY1305" },
+    { 0xc013, "ECDHE-RSA-AES128-SHA" },
+    { 0xc014, "ECDHE-RSA-AES256-SHA" },
+    { 0x009c, "AES128-GCM-SHA256" },
+    { 0x009d, "AES256-GCM-SHA384" },
+    { 0x002f, "AES128-SHA" },
+    { 0x0035, "AES256-SHA" },
+    { 0x000a, "DES-CBC3-SHA" }
+};
+#define NUM_TLS_CIPHERS (int)(sizeof(TLS_CIPHERS) / sizeof(TLS_CIPHERS[0]))
+
+static void put16(unsigned char *p, size_t v) {
+    p[0] = (unsigned char)(v >> 8);
+    p[1] = (unsigned char)v;
+}
+
+// ClientHello offering TLS 1.0-1.3 and every suite in TLS_CIPHERS. The
+// key_share is empty, so TLS 1.3 servers answer with a HelloRetryRequest,
+// which names the version and suite just as well.
+static size_t build_client_hello(unsigned char *buf) {
+    unsigned char *p = buf + 9;     // record (5) + handshake (4) headers
+
+    put16(p, 0x0303);                               // legacy version
+    p += 2;
+    for (int i = 0; i < 32; i++)
+        *p++ = (unsigned char)rand();               // random
+    *p++ = 0;                                       // session id
+    put16(p, NUM_TLS_CIPHERS * 2);
+    p += 2;
+    for (int i = 0; i < NUM_TLS_CIPHERS; i++, p += 2)
+        put16(p, TLS_CIPHERS[i].id);
+    *p++ = 1;                                       // compression: null
+    *p++ = 0;
+
+    static const unsigned char extensions[] = {
+        0x00, 0x0a, 0x00, 0x06, 0x00, 0x04, 0x00, 0x1d, 0x00, 0x17,  // groups: x25519, P-256
+        0x00, 0x0b, 0x00, 0x02, 0x01, 0x00,                          // point formats
+        0x00, 0x0d, 0x00, 0x0a, 0x00, 0x08, 0x04, 0x03, 0x08, 0x04,  // signature algorithms
+        0x04, 0x01, 0x02, 0x01,
+        0x00, 0x2b, 0x00, 0x09, 0x08, 0x03, 0x04, 0x03, 0x03,        // versions: 1.3-1.0
+        0x03, 0x02, 0x03, 0x01,
+        0x00, 0x33, 0x00, 0x02, 0x00, 0x00                           // key_share: empty
+    };
+    put16(p, sizeof(extensions));
+    p += 2;
+    memcpy(p, extensions, sizeof(extensions));
+    p += sizeof(extensions);
+
+    size_t body = (size_t)(p - buf) - 9;
+    buf[0] = 0x16;                                  // handshake record
+    put16(buf + 1, 0x0301);
+    put16(buf + 3, body + 4);
+    buf[5] = 1;                                     // ClientHello
+    buf[6] = 0;
+    put16(buf + 7, body);
+    return body + 9;
+}
+
+static const char *tls_version_name(unsigned v) {
+    switch (v) {
+        case 0x0301: return "TLSv1.0";
+        case 0x0302: return "TLSv1.1";
+        case 0x0303: return "TLSv1.2";
+        case 0x0304: return "TLSv1.3";
+        default: return NULL;
+    }
+}
+
+// Describe the ServerHello (or alert) in buf; returns 0 if it isn't TLS
+static int parse_server_hello(const unsigned char *b, int n, char *out, size_t cap) {
+    if (n >= 7 && b[0] == 0x15 && b[1] == 0x03) {
+        snprintf(out, cap, "alert %d", b[6]);
+        return 1;
+    }
+    if (n < 5 + 4 + 2 + 32 + 1 || b[0] != 0x16 || b[1] != 0x03 || b[5] != 2)
+        return 0;
+
+    const unsigned char *p = b + 9, *end = b + n;
+    unsigned version = (unsigned)(p[0] << 8 | p[1]);
+    p += 2 + 32;
+    p += 1 + p[0];                                  // session id
+    if (p + 3 > end)
+        return 0;
+    unsigned cipher = (unsigned)(p[0] << 8 | p[1]);
+    p += 3;
+
+    // TLS 1.3 reports its real version in supported_versions
+    if (p + 2 <= end) {
+        const unsigned char *ext_end = p + 2 + (p[0] << 8 | p[1]);
+        if (ext_end > end)
+            ext_end = end;
+        for (p += 2; p + 4 <= ext_end; p += 4 + (p[2] << 8 | p[3])) {
+            if ((p[0] << 8 | p[1]) == 0x002b && p + 6 <= ext_end)
+                version = (unsigned)(p[4] << 8 | p[5]);
+        }
+    }
+
+    const char *vname = tls_version_name(version);
+    const char *cname = NULL;
+    for (int i = 0; i < NUM_TLS_CIPHERS; i++)
+        if (TLS_CIPHERS[i].id == cipher)
+            cname = TLS_CIPHERS[i].name;
+    if (vname == NULL)
+        return 0;
+    if (cname != NULL)
+        snprintf(out, cap, "%s %s", vname, cname);
+    else
+        snprintf(out, cap, "%s 0x%04x", vname, cipher);
+    return 1;
+}
+
+static int stage_tls(const PipeItem *item, char *out, size_t cap) {
+    struct sockaddr_storage ss;
+    int len = item_sockaddr(item, &ss);
+    SOCKET s;
+    if (probe_port((struct sockaddr*)&ss, len, ENRICH_TIMEOUT_MS, &s) != PORT_OPEN)
+        return 0;
+
+    unsigned char hello[512];
+    size_t hello_len = build_client_hello(hello);
+    int found = 0;
+    if (send(s, (const char*)hello, (int)hello_len, 0) == (int)hello_len) {
+        // The ServerHello comes first; its start is all we need
+        unsigned char buf[2048];
+        int n = 0, r;
+        while (n < (int)sizeof(buf) &&
+               (r = recv(s, (char*)buf + n, (int)sizeof(buf) - n, 0)) > 0) {
+            n += r;
+            if (n >= 5 && n >= 5 + (buf[3] << 8 | buf[4]))
+                break;              // first record complete
+        }
+        found = parse_server_hello(buf, n, out, cap);
+    }
+    closesocket(s);
+    return found;
+}
+
+// ---- Registry ----
+
+static const PipeStageDef STAGE_DEFS[] = {
+    { "rdns", stage_rdns, 8, 1024 },
+    { "tls", stage_tls, 16, 1024 }
+};
+
+int enrich_add(const char *spec) {
+    char name[32];
+    int threads = 0, queue = 0;
+    size_t name_len = strcspn(spec, ":");
+    snprintf(name, sizeof(name), "%.*s", (int)name_len, spec);
+    if (spec[name_len] == ':' && sscanf(spec + name_len, ":%d:%d", &threads, &queue) < 1) {
+        printf("Enrichment: bad spec '%s' (name[:threads[:queue]]).\n", spec);
+        return -1;
+    }
+
+    for (size_t i = 0; i < sizeof(STAGE_DEFS) / sizeof(STAGE_DEFS[0]); i++)
+        if (strcmp(name, STAGE_DEFS[i].name) == 0)
+            return pipe_add_stage(&STAGE_DEFS[i], threads, queue);
+
+    printf("Enrichment: unknown stage '%s' (available: rdns, tls).\n", name);
+    return -1;
+}
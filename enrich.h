@@ -0,0 +1,23 @@
+/*
+ * Built-in enrichment stages for the pipeline (--enrich)
+ * Description:
+ *     rdns    reverse DNS name of the host
+ *     tls     negotiated TLS version and cipher suite, from the ServerHello
+ *             answering a ClientHello (no handshake is completed, so no
+ *             TLS library is needed)
+ *
+ *     Spec: name[:threads[:queue]], e.g. "rdns:16:4096". Stages run in the
+ *     order given.
+ */
+
+#ifndef ENRICH_H
+#define ENRICH_H
+
+// Connect / read timeout for stages that open their own connection
+#define ENRICH_TIMEOUT_MS 2000
+
+// Add the stage named by spec to the pipeline. Returns 0, or -1 after
+// printing why.
+int enrich_add(const char *spec);
+
+#endif
@@ -0,0 +1,224 @@
+/*
+ * Output format templates (see format.h)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scanner.h"
+#include "format.h"
+
+static const struct {
+    const char *name;
+    FmtKind kind;
+} FIELDS[] = {
+    { "ip", FMT_IP },
+    { "port", FMT_PORT },
+    { "service", FMT_SERVICE },
+    { "banner", FMT_BANNER },
+    { "thread", FMT_THREAD },
+    { "state", FMT_STATE },
+    { "probe", FMT_PROBE },
+    { "enrich", FMT_ENRICH },
+    { "rtt", FMT_RTT },
+    { "minrtt", FMT_MIN_RTT },
+    { "mss", FMT_MSS },
+    { "rwnd", FMT_RWND },
+    { "retrans", FMT_RETRANS },
+    { "color", FMT_COLOR },
+    { "reset", FMT_RESET },
+};
+
+// Append text to the pool; returns its offset
+static unsigned int pool_add(FormatTemplate *t, size_t *used, const char *s, size_t n) {
+    unsigned int off = (unsigned int)*used;
+    memcpy(t->pool + *used, s, n);
+    *used += n;
+    return off;
+}
+
+int fmt_compile(FormatTemplate *t, const char *spec, char *err, size_t err_len) {
+    size_t len = strlen(spec);
+    size_t pool_used = 0;
+
+    // Every op consumes at least one character of spec
+    memset(t, 0, sizeof(*t));
+    t->ops = malloc((len + 1) * sizeof(FmtOp));
+    t->pool = malloc(len + 1);
+    if (t->ops == NULL || t->pool == NULL) {
+        snprintf(err, err_len, "out of memory");
+        fmt_free(t);
+        return -1;
+    }
+
+    const char *p = spec;
+    while (*p) {
+        if (*p != '{' || p[1] == '{') {
+            // Literal run up to the next field, folding {{ and }}
+            FmtOp *op = &t->ops[t->num_ops++];
+            memset(op, 0, sizeof(*op));
+            op->kind = FMT_LITERAL;
+            op->prefix_off = (unsigned int)pool_used;
+            while (*p && !(*p == '{' && p[1] != '{')) {
+                if ((*p == '{' || *p == '}') && p[1] == *p)
+                    p++;
+                else if (*p == '}') {
+                    snprintf(err, err_len, "unmatched '}' at offset %d", (int)(p - spec));
+                    fmt_free(t);
+                    return -1;
+                }
+                t->pool[pool_used++] = *p++;
+            }
+            op->prefix_len = (unsigned short)(pool_used - op->prefix_off);
+            continue;
+        }
+
+        const char *close = strchr(p, '}');
+        if (close == NULL) {
+            snprintf(err, err_len, "unterminated field at offset %d", (int)(p - spec));
+            fmt_free(t);
+            return -1;
+        }
+
+        // {name} or {name|prefix|suffix}
+        const char *name = p + 1;
+        const char *bar1 = memchr(name, '|', close - name);
+        const char *bar2 = bar1 ? memchr(bar1 + 1, '|', close - bar1 - 1) : NULL;
+        size_t name_len = (size_t)((bar1 ? bar1 : close) - name);
+
+        FmtOp *op = &t->ops[t->num_ops];
+        memset(op, 0, sizeof(*op));
+        int found = 0;
+        for (size_t i = 0; i < sizeof(FIELDS) / sizeof(FIELDS[0]); i++) {
+            if (strlen(FIELDS[i].name) == name_len &&
+                strncmp(FIELDS[i].name, name, name_len) == 0) {
+                op->kind = (unsigned char)FIELDS[i].kind;
+                found = 1;
+                break;
+            }
+        }
+        if (!found) {
+            snprintf(err, err_len, "unknown field '%.*s'", (int)name_len, name);
+            fmt_free(t);
+            return -1;
+        }
+
+        if (bar1 != NULL) {
+            const char *pre_end = bar2 ? bar2 : close;
+            op->conditional = 1;
+            op->prefix_off = pool_add(t, &pool_used, bar1 + 1, pre_end - bar1 - 1);
+            op->prefix_len = (unsigned short)(pre_end - bar1 - 1);
+            if (bar2 != NULL) {
+                op->suffix_off = pool_add(t, &pool_used, bar2 + 1, close - bar2 - 1);
+                op->suffix_len = (unsigned short)(close - bar2 - 1);
+            }
+        }
+
+        t->num_ops++;
+        p = close + 1;
+    }
+    return 0;
+}
+
+// Bounded append; always leaves room for the final newline + NUL
+static size_t put(char *buf, size_t pos, size_t cap, const char *s, size_t n) {
+    if (pos + n > cap - 2)
+        n = pos < cap - 2 ? cap - 2 - pos : 0;
+    memcpy(buf + pos, s, n);
+    return pos + n;
+}
+
+size_t fmt_render(const FormatTemplate *t, const FmtRecord *r, int color,
+                  char *buf, size_t cap) {
+    size_t pos = 0;
+    char num[16];
+
+    for (int i = 0; i < t->num_ops; i++) {
+        const FmtOp *op = &t->ops[i];
+        const char *val = NULL;
+        size_t val_len = 0;
+
+        switch (op->kind) {
+            case FMT_LITERAL:
+                pos = put(buf, pos, cap, t->pool + op->prefix_off, op->prefix_len);
+                continue;
+            case FMT_IP:
+                val = r->ip;
+                val_len = strlen(val);
+                break;
+            case FMT_PORT:
+                val_len = (size_t)snprintf(num, sizeof(num), "%d", r->port);
+                val = num;
+                break;
+            case FMT_SERVICE:
+                val = r->service;
+                val_len = strlen(val);
+                break;
+            case FMT_BANNER:
+                val = r->banner;
+                val_len = (size_t)r->banner_len;
+                break;
+            case FMT_THREAD:
+                val_len = (size_t)snprintf(num, sizeof(num), "%d", r->thread_id);
+                val = num;
+                break;
+            case FMT_STATE:
+                val = state_name(r->state);
+                val_len = strlen(val);
+                break;
+            case FMT_PROBE:
+                val = r->probe;
+                val_len = strlen(val);
+                break;
+            case FMT_ENRICH:
+                val = r->enrich;
+                val_len = strlen(val);
+                break;
+            case FMT_RTT:
+            case FMT_MIN_RTT:
+                if (r->conn == NULL)
+                    break;
+                val_len = (size_t)snprintf(num, sizeof(num), "%.3f",
+                    (op->kind == FMT_RTT ? r->conn->rtt_us : r->conn->min_rtt_us) / 1000.0);
+                val = num;
+                break;
+            case FMT_MSS:
+            case FMT_RWND:
+            case FMT_RETRANS:
+                if (r->conn == NULL)
+                    break;
+                val_len = (size_t)snprintf(num, sizeof(num), "%u",
+                    (unsigned)(op->kind == FMT_MSS ? r->conn->mss :
+                               op->kind == FMT_RWND ? r->conn->rcv_wnd : r->conn->syn_retrans));
+                val = num;
+                break;
+            case FMT_COLOR:
+                val = color ? COLOR_GREEN : "";
+                val_len = strlen(val);
+                break;
+            case FMT_RESET:
+                val = color ? COLOR_RESET : "";
+                val_len = strlen(val);
+                break;
+        }
+
+        if (op->conditional && val_len == 0)
+            continue;
+        pos = put(buf, pos, cap, t->pool + op->prefix_off, op->prefix_len);
+        pos = put(buf, pos, cap, val, val_len);
+        pos = put(buf, pos, cap, t->pool + op->suffix_off, op->suffix_len);
+    }
+
+    buf[pos++] = '\n';
+    buf[pos] = '\0';
+    return pos;
+}
+
+void fmt_free(FormatTemplate *t) {
+    free(t->ops);
+    free(t->pool);
+    t->ops = NULL;
+    t->pool = NULL;
+    t->num_ops = 0;
+}
@@ -0,0 +1,86 @@
+/*
+ * Output format templates
+ * Description:
+ *     A --format string such as "{ip}:{port} {service} {banner}" is compiled
+ *     once at startup into a flat list of literal / field ops. Rendering a
+ *     result walks that list into a caller-provided buffer, so no format
+ *     string is interpreted per result.
+ *
+ * Syntax:
+ *     {ip} {port} {service} {banner} {thread} {state}   result fields
+ *     {probe}                   result of a --plugin probe
+ *     {enrich}                  --enrich stage results, "name=value; ..."
+ *     {rtt} {minrtt}            kernel RTT of an open port's connection (ms)
+ *     {mss} {rwnd} {retrans}    ... its MSS, receive window, SYN retransmits
+ *     {color} {reset}           ANSI color on/off (console only)
+ *     {field|prefix|suffix}     prefix + value + suffix, only if non-empty
+ *     {{ and }}                 literal braces
+ */
+
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <stddef.h>
+
+#include "scanner.h"
+
+typedef enum {
+    FMT_LITERAL,
+    FMT_IP,
+    FMT_PORT,
+    FMT_SERVICE,
+    FMT_BANNER,
+    FMT_THREAD,
+    FMT_STATE,
+    FMT_PROBE,
+    FMT_ENRICH,
+    FMT_RTT,
+    FMT_MIN_RTT,
+    FMT_MSS,
+    FMT_RWND,
+    FMT_RETRANS,
+    FMT_COLOR,
+    FMT_RESET
+} FmtKind;
+
+// One compiled op; text lives in the template's pool
+typedef struct {
+    unsigned char kind;         // FmtKind
+    unsigned char conditional;  // skip op entirely when the field is empty
+    unsigned short prefix_len;  // literal text (FMT_LITERAL) or prefix
+    unsigned short suffix_len;
+    unsigned int prefix_off;
+    unsigned int suffix_off;
+} FmtOp;
+
+typedef struct {
+    FmtOp *ops;
+    int num_ops;
+    char *pool;
+} FormatTemplate;
+
+// Values a template can reference
+typedef struct {
+    const char *ip;
+    int port;
+    const char *service;
+    const char *banner;
+    int banner_len;
+    int thread_id;
+    int state;                  // PortState
+    const char *probe;          // plugin result, "" if none
+    const char *enrich;         // enrichment results, "" if none
+    const ConnInfo *conn;       // kernel TCP metrics, NULL if unknown
+} FmtRecord;
+
+// Compile spec. On error returns -1 and describes the problem in err.
+int fmt_compile(FormatTemplate *t, const char *spec, char *err, size_t err_len);
+
+// Render one line (with trailing newline) into buf; color selects whether
+// {color}/{reset} emit ANSI codes. Returns the length written.
+size_t fmt_render(const FormatTemplate *t, const FmtRecord *r, int color,
+                  char *buf, size_t cap);
+
+void fmt_free(FormatTemplate *t);
+
+#endif
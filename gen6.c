@@ -0,0 +1,320 @@
+/*
+ * IPv6 target generation from seed addresses (see gen6.h)
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "scanner.h"
+#include "gen6.h"
+
+// Nybbles below the cluster prefix, modelled per cluster
+#define VAR_NYBBLES (32 - GEN6_CLUSTER_NYBBLES)
+
+typedef struct {
+    unsigned char prefix[16];       // first seed of the cluster (prefix nybbles used)
+    double log_weight;              // log(share of all seeds)
+    uint8_t nvals[VAR_NYBBLES];     // candidate values per nybble
+    uint8_t vals[VAR_NYBBLES][16];  // ... most likely first
+    float logp[VAR_NYBBLES][16];    // ... and their log probabilities
+} Cluster;
+
+// A candidate not yet emitted: one value index per nybble
+typedef struct {
+    double score;
+    uint32_t cluster;
+    uint8_t last;                   // last nybble advanced to reach this one
+    uint8_t idx[VAR_NYBBLES];
+} Pending;
+
+struct Gen6 {
+    unsigned char (*seeds)[16];     // sorted, unique
+    size_t num_seeds;
+    Cluster *clusters;
+    size_t num_clusters;
+    double entropy[32];             // normalized 0..1 per nybble
+    Pending *heap;                  // max-heap on score
+    size_t heap_len;
+    size_t heap_cap;
+};
+
+static inline int nybble(const unsigned char a[16], int i) {
+    return i & 1 ? a[i / 2] & 0x0f : a[i / 2] >> 4;
+}
+
+static inline void set_nybble(unsigned char a[16], int i, int v) {
+    if (i & 1)
+        a[i / 2] = (unsigned char)((a[i / 2] & 0xf0) | v);
+    else
+        a[i / 2] = (unsigned char)((a[i / 2] & 0x0f) | (v << 4));
+}
+
+static int addr_cmp(const void *a, const void *b) {
+    return memcmp(a, b, 16);
+}
+
+static int heap_push(Gen6 *g, const Pending *p) {
+    if (g->heap_len == g->heap_cap) {
+        if (g->heap_cap >= GEN6_MAX_PENDING)
+            return 0;   // drop: keeps memory bounded, order stays best-first
+        size_t cap = g->heap_cap ? g->heap_cap * 2 : 1024;
+        Pending *heap = realloc(g->heap, cap * sizeof(Pending));
+        if (heap == NULL)
+            return 0;
+        g->heap = heap;
+        g->heap_cap = cap;
+    }
+
+    size_t i = g->heap_len++;
+    while (i > 0 && g->heap[(i - 1) / 2].score < p->score) {
+        g->heap[i] = g->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    g->heap[i] = *p;
+    return 1;
+}
+
+static Pending heap_pop(Gen6 *g) {
+    Pending top = g->heap[0];
+    Pending last = g->heap[--g->heap_len];
+    size_t i = 0;
+    while (1) {
+        size_t child = 2 * i + 1;
+        if (child >= g->heap_len)
+            break;
+        if (child + 1 < g->heap_len && g->heap[child + 1].score > g->heap[child].score)
+            child++;
+        if (g->heap[child].score <= last.score)
+            break;
+        g->heap[i] = g->heap[child];
+        i = child;
+    }
+    if (g->heap_len > 0)
+        g->heap[i] = last;
+    return top;
+}
+
+// Read one address per line; returns the number of invalid lines skipped
+static int load_seeds(FILE *f, Gen6 *g) {
+    size_t cap = 0;
+    int invalid = 0;
+    char line[256];
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char *p = line;
+        while (isspace((unsigned char)*p))
+            p++;
+        p[strcspn(p, "# \t\r\n")] = '\0';
+        if (*p == '\0')
+            continue;
+
+        unsigned char a[16];
+        if (inet_pton(AF_INET6, p, a) != 1) {
+            invalid++;
+            continue;
+        }
+        if (g->num_seeds == cap) {
+            cap = cap ? cap * 2 : 1024;
+            unsigned char (*seeds)[16] = realloc(g->seeds, cap * 16);
+            if (seeds == NULL)
+                return -1;
+            g->seeds = seeds;
+        }
+        memcpy(g->seeds[g->num_seeds++], a, 16);
+    }
+
+    // Sorted and unique: clusters are contiguous runs, and the dedup
+    // against seeds is a binary search
+    qsort(g->seeds, g->num_seeds, 16, addr_cmp);
+    size_t unique = 0;
+    for (size_t i = 0; i < g->num_seeds; i++)
+        if (unique == 0 || memcmp(g->seeds[unique - 1], g->seeds[i], 16) != 0)
+            memcpy(g->seeds[unique++], g->seeds[i], 16);
+    g->num_seeds = unique;
+    return invalid;
+}
+
+// Value distribution of nybble i within a cluster of n seeds
+static void build_nybble(const Gen6 *g, Cluster *c, int j, const uint32_t *cluster_count,
+                         size_t n, const uint32_t global_count[32][16]) {
+    int i = GEN6_CLUSTER_NYBBLES + j;
+    int lo = 15, hi = 0;
+    for (int v = 0; v < 16; v++) {
+        if (global_count[i][v] > 0) {
+            if (v < lo) lo = v;
+            if (v > hi) hi = v;
+        }
+    }
+
+    double p[16];
+    for (int v = 0; v < 16; v++) {
+        double pc = (double)cluster_count[v] / (double)n;
+        if (g->entropy[i] >= GEN6_RANDOM_ENTROPY) {
+            p[v] = pc;  // random-looking: don't invent values
+        } else {
+            double pg = (double)global_count[i][v] / (double)g->num_seeds;
+            double pf = v >= lo && v <= hi ? 1.0 / (hi - lo + 1) : 0.0;
+            p[v] = GEN6_MIX_CLUSTER * pc + GEN6_MIX_GLOBAL * pg + GEN6_MIX_FILL * pf;
+        }
+    }
+
+    // Keep possible values, most likely first
+    c->nvals[j] = 0;
+    for (int v = 0; v < 16; v++) {
+        if (p[v] <= 0.0)
+            continue;
+        int k = c->nvals[j]++;
+        while (k > 0 && p[c->vals[j][k - 1]] < p[v]) {
+            c->vals[j][k] = c->vals[j][k - 1];
+            k--;
+        }
+        c->vals[j][k] = (uint8_t)v;
+    }
+    for (int k = 0; k < c->nvals[j]; k++)
+        c->logp[j][k] = (float)log(p[c->vals[j][k]]);
+}
+
+static int build_model(Gen6 *g) {
+    static uint32_t global_count[32][16];
+    memset(global_count, 0, sizeof(global_count));
+
+    for (size_t s = 0; s < g->num_seeds; s++)
+        for (int i = 0; i < 32; i++)
+            global_count[i][nybble(g->seeds[s], i)]++;
+
+    for (int i = 0; i < 32; i++) {
+        double h = 0.0;
+        for (int v = 0; v < 16; v++) {
+            if (global_count[i][v] == 0)
+                continue;
+            double p = (double)global_count[i][v] / (double)g->num_seeds;
+            h -= p * log2(p);
+        }
+        g->entropy[i] = h / 4.0;
+    }
+
+    g->clusters = malloc(g->num_seeds * sizeof(Cluster));
+    if (g->clusters == NULL)
+        return -1;
+
+    for (size_t a = 0; a < g->num_seeds; ) {
+        size_t b = a + 1;
+        while (b < g->num_seeds && memcmp(g->seeds[a], g->seeds[b], GEN6_CLUSTER_NYBBLES / 2) == 0)
+            b++;
+
+        Cluster *c = &g->clusters[g->num_clusters];
+        memcpy(c->prefix, g->seeds[a], 16);
+        c->log_weight = log((double)(b - a) / (double)g->num_seeds);
+
+        for (int j = 0; j < VAR_NYBBLES; j++) {
+            uint32_t count[16] = {0};
+            for (size_t s = a; s < b; s++)
+                count[nybble(g->seeds[s], GEN6_CLUSTER_NYBBLES + j)]++;
+            build_nybble(g, c, j, count, b - a, global_count);
+        }
+
+        // Start from the cluster's most likely candidate
+        Pending root = {0};
+        root.cluster = (uint32_t)g->num_clusters;
+        root.score = c->log_weight;
+        for (int j = 0; j < VAR_NYBBLES; j++)
+            root.score += c->logp[j][0];
+        if (!heap_push(g, &root))
+            return -1;
+
+        g->num_clusters++;
+        a = b;
+    }
+    return 0;
+}
+
+Gen6 *gen6_open(const char *seed_path) {
+    FILE *f = fopen(seed_path, "r");
+    if (f == NULL) {
+        printf("Seeds: cannot open %s\n", seed_path);
+        return NULL;
+    }
+
+    Gen6 *g = calloc(1, sizeof(Gen6));
+    if (g == NULL) {
+        fclose(f);
+        printf("Seeds: out of memory.\n");
+        return NULL;
+    }
+
+    int invalid = load_seeds(f, g);
+    fclose(f);
+    if (invalid < 0 || (g->num_seeds > 0 && build_model(g) != 0)) {
+        printf("Seeds: out of memory.\n");
+        gen6_free(g);
+        return NULL;
+    }
+    if (invalid > 0)
+        printf("Seeds: skipped %d lines that are not IPv6 addresses\n", invalid);
+    if (g->num_seeds == 0) {
+        printf("Seeds: no IPv6 addresses in %s\n", seed_path);
+        gen6_free(g);
+        return NULL;
+    }
+    return g;
+}
+
+void gen6_report(const Gen6 *g) {
+    printf("Seeds: %zu addresses in %zu /%d clusters\n",
+           g->num_seeds, g->num_clusters, GEN6_CLUSTER_NYBBLES * 4);
+
+    // One hex digit per nybble, 0 = fixed .. f = random, grouped like an address
+    char profile[40];
+    int n = 0;
+    for (int i = 0; i < 32; i++) {
+        if (i > 0 && i % 4 == 0)
+            profile[n++] = ':';
+        profile[n++] = "0123456789abcdef"[(int)(g->entropy[i] * 15.0 + 0.5)];
+    }
+    profile[n] = '\0';
+    printf("Seeds: nybble entropy %s\n", profile);
+}
+
+int gen6_next(Gen6 *g, unsigned char out[16]) {
+    while (g->heap_len > 0) {
+        Pending p = heap_pop(g);
+        const Cluster *c = &g->clusters[p.cluster];
+
+        // Successors advance one nybble at or after the last one advanced,
+        // so every combination has exactly one predecessor. Values are
+        // sorted by probability, so successors never score higher and the
+        // heap yields candidates in decreasing score.
+        for (int j = p.last; j < VAR_NYBBLES; j++) {
+            if (p.idx[j] + 1 >= c->nvals[j])
+                continue;
+            Pending next = p;
+            next.idx[j]++;
+            next.last = (uint8_t)j;
+            next.score += c->logp[j][next.idx[j]] - c->logp[j][p.idx[j]];
+            heap_push(g, &next);
+        }
+
+        memcpy(out, c->prefix, 16);
+        for (int j = 0; j < VAR_NYBBLES; j++)
+            set_nybble(out, GEN6_CLUSTER_NYBBLES + j, c->vals[j][p.idx[j]]);
+
+        // Clusters have distinct prefixes, so only seeds can repeat
+        if (bsearch(out, g->seeds, g->num_seeds, 16, addr_cmp) == NULL)
+            return 1;
+    }
+    return 0;
+}
+
+void gen6_free(Gen6 *g) {
+    if (g == NULL)
+        return;
+    free(g->seeds);
+    free(g->clusters);
+    free(g->heap);
+    free(g);
+}
@@ -0,0 +1,61 @@
+/*
+ * IPv6 target generation from seed addresses
+ * Description:
+ *     Internet-facing IPv6 space can't be swept, but addresses in use are
+ *     far from random: operators number hosts ::1, ::2, ..., embed ports or
+ *     IPv4 addresses, and reuse a handful of subnet ids. Given a list of
+ *     known (seed) addresses, the generator learns that structure and
+ *     emits new candidates most likely to be in use first.
+ *
+ *     Model (Entropy-IP / 6Gen style):
+ *       - the entropy of each of the 32 nybbles across all seeds tells
+ *         fixed, structured and random parts of the address apart
+ *       - seeds are clustered by their /48; within a cluster, every later
+ *         nybble gets a value distribution mixing the cluster's own values,
+ *         the values seen at that position across all seeds, and the gaps
+ *         between them (so ::1, ::2, ::5 suggest ::3 and ::4). Random-looking
+ *         nybbles only reuse the cluster's own values.
+ *       - a candidate's score is its cluster's share of the seeds times the
+ *         probability of each of its nybbles
+ *
+ *     Candidates come out lazily in decreasing score across all clusters,
+ *     never repeating one and never emitting a seed.
+ */
+
+#ifndef GEN6_H
+#define GEN6_H
+
+#include <stddef.h>
+
+// Candidates scanned when --budget isn't given
+#define GEN6_DEFAULT_BUDGET 10000
+
+// Seeds sharing this many leading nybbles (a /48) form one cluster
+#define GEN6_CLUSTER_NYBBLES 12
+
+// Nybbles with at least this normalized entropy (0..1) count as random
+#define GEN6_RANDOM_ENTROPY 0.9
+
+// Mix of cluster values, global values and gap filling per nybble
+#define GEN6_MIX_CLUSTER 0.80
+#define GEN6_MIX_GLOBAL  0.15
+#define GEN6_MIX_FILL    0.05
+
+// Bound on partially explored candidates kept for later (memory cap)
+#define GEN6_MAX_PENDING (1 << 20)
+
+typedef struct Gen6 Gen6;
+
+// Load seeds (one IPv6 address per line, '#' comments) and build the
+// model. Returns NULL after printing why.
+Gen6 *gen6_open(const char *seed_path);
+
+// Print the seed count, clusters and per-nybble entropy profile
+void gen6_report(const Gen6 *g);
+
+// Next candidate in decreasing score. Returns 1, or 0 when exhausted.
+int gen6_next(Gen6 *g, unsigned char out[16]);
+
+void gen6_free(Gen6 *g);
+
+#endif
@@ -0,0 +1,500 @@
+/*
+ * Historical port-state store (see history.h)
+ *
+ * Segment layout:
+ *     8 bytes   magic "PSSEG1\n\0"
+ *     8 bytes   record count (little endian)
+ *     N * 27    records: addr[16], port (BE), state, time (LE int64)
+ *
+ * Records are fixed size so lookups can binary search with fseek.
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "history.h"
+
+#define SEG_MAGIC "PSSEG1\n"
+#define SEG_HEADER 16
+#define SEG_RECORD 27
+
+// ---- record encoding ----
+
+static void encode_record(unsigned char *p, const HistRecord *r) {
+    memcpy(p, r->addr, 16);
+    p[16] = (unsigned char)(r->port >> 8);
+    p[17] = (unsigned char)(r->port & 0xff);
+    p[18] = r->state;
+    uint64_t t = (uint64_t)r->time;
+    for (int i = 0; i < 8; i++)
+        p[19 + i] = (unsigned char)(t >> (8 * i));
+}
+
+static void decode_record(const unsigned char *p, HistRecord *r) {
+    memcpy(r->addr, p, 16);
+    r->port = (uint16_t)((p[16] << 8) | p[17]);
+    r->state = p[18];
+    uint64_t t = 0;
+    for (int i = 0; i < 8; i++)
+        t |= (uint64_t)p[19 + i] << (8 * i);
+    r->time = (int64_t)t;
+}
+
+// Order by key only
+static int key_cmp(const unsigned char *addr_a, uint16_t port_a,
+                   const unsigned char *addr_b, uint16_t port_b) {
+    int c = memcmp(addr_a, addr_b, 16);
+    if (c != 0) return c;
+    return (port_a > port_b) - (port_a < port_b);
+}
+
+// Order by key, then time
+static int record_cmp(const void *a, const void *b) {
+    const HistRecord *x = a, *y = b;
+    int c = key_cmp(x->addr, x->port, y->addr, y->port);
+    if (c != 0) return c;
+    return (x->time > y->time) - (x->time < y->time);
+}
+
+static void segment_path(const HistStore *h, uint32_t id, char *buf, size_t len) {
+    snprintf(buf, len, "%s.%08u.seg", h->prefix, (unsigned)id);
+}
+
+// ---- manifest ----
+
+// Rewrite the manifest via temp file + atomic replace. Caller holds lock.
+static int write_manifest(HistStore *h) {
+    char path[300], tmp_path[310];
+    snprintf(path, sizeof(path), "%s.manifest", h->prefix);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.manifest.tmp", h->prefix);
+
+    FILE *f = fopen(tmp_path, "w");
+    if (!f) {
+        printf("History: could not write %s\n", tmp_path);
+        return -1;
+    }
+    fprintf(f, "PSHIST 1\nnext %u\n", (unsigned)h->next_id);
+    for (int i = 0; i < h->num_segments; i++)
+        fprintf(f, "%u\n", (unsigned)h->segments[i]);
+    if (fclose(f) != 0)
+        return -1;
+
+    if (!MoveFileExA(tmp_path, path, MOVEFILE_REPLACE_EXISTING)) {
+        printf("History: could not replace %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+static int push_segment(HistStore *h, uint32_t id) {
+    if (h->num_segments == h->cap_segments) {
+        int cap = h->cap_segments ? h->cap_segments * 2 : 16;
+        uint32_t *s = realloc(h->segments, cap * sizeof(uint32_t));
+        if (s == NULL)
+            return -1;
+        h->segments = s;
+        h->cap_segments = cap;
+    }
+    h->segments[h->num_segments++] = id;
+    return 0;
+}
+
+int hist_open(HistStore *h, const char *prefix) {
+    memset(h, 0, sizeof(*h));
+    snprintf(h->prefix, sizeof(h->prefix), "%s", prefix);
+    pthread_mutex_init(&h->lock, NULL);
+
+    char path[300];
+    snprintf(path, sizeof(path), "%s.manifest", h->prefix);
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return 0; // fresh store; manifest is created on first ingest
+
+    unsigned next = 0, id;
+    if (fscanf(f, "PSHIST 1 next %u", &next) != 1) {
+        printf("History: %s is not a store manifest.\n", path);
+        fclose(f);
+        pthread_mutex_destroy(&h->lock);
+        return -1;
+    }
+    h->next_id = next;
+    while (fscanf(f, "%u", &id) == 1) {
+        if (push_segment(h, id) != 0) {
+            fclose(f);
+            hist_close(h);
+            return -1;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+void hist_close(HistStore *h) {
+    if (h->compacting)
+        pthread_join(h->compactor, NULL);
+    h->compacting = 0;
+    free(h->segments);
+    h->segments = NULL;
+    pthread_mutex_destroy(&h->lock);
+}
+
+// ---- segment writer ----
+
+typedef struct {
+    FILE *f;
+    uint64_t count;
+    unsigned char buf[SEG_RECORD];
+} SegWriter;
+
+static int seg_writer_open(SegWriter *w, const char *path) {
+    w->count = 0;
+    w->f = fopen(path, "wb");
+    if (!w->f)
+        return -1;
+    setvbuf(w->f, NULL, _IOFBF, 1 << 16);
+    unsigned char header[SEG_HEADER] = {0};
+    memcpy(header, SEG_MAGIC, 8);
+    return fwrite(header, 1, SEG_HEADER, w->f) == SEG_HEADER ? 0 : -1;
+}
+
+static int seg_writer_put(SegWriter *w, const HistRecord *r) {
+    encode_record(w->buf, r);
+    if (fwrite(w->buf, 1, SEG_RECORD, w->f) != SEG_RECORD)
+        return -1;
+    w->count++;
+    return 0;
+}
+
+// Patch the record count into the header and close
+static int seg_writer_close(SegWriter *w) {
+    unsigned char cnt[8];
+    for (int i = 0; i < 8; i++)
+        cnt[i] = (unsigned char)(w->count >> (8 * i));
+    int ok = fseek(w->f, 8, SEEK_SET) == 0 &&
+             fwrite(cnt, 1, 8, w->f) == 8;
+    if (fclose(w->f) != 0)
+        ok = 0;
+    return ok ? 0 : -1;
+}
+
+// ---- segment reader ----
+
+typedef struct {
+    FILE *f;
+    uint64_t count;
+    uint64_t pos;      // index of the record in cur
+    HistRecord cur;
+    int valid;         // cur holds a record
+} SegReader;
+
+static int seg_reader_open(SegReader *r, const char *path) {
+    unsigned char header[SEG_HEADER];
+    memset(r, 0, sizeof(*r));
+    r->f = fopen(path, "rb");
+    if (!r->f)
+        return -1;
+    setvbuf(r->f, NULL, _IOFBF, 1 << 16);
+    if (fread(header, 1, SEG_HEADER, r->f) != SEG_HEADER ||
+        memcmp(header, SEG_MAGIC, 8) != 0) {
+        fclose(r->f);
+        r->f = NULL;
+        return -1;
+    }
+    for (int i = 0; i < 8; i++)
+        r->count |= (uint64_t)header[8 + i] << (8 * i);
+    return 0;
+}
+
+static int seg_reader_at(SegReader *r, uint64_t idx) {
+    unsigned char buf[SEG_RECORD];
+    r->valid = 0;
+    if (idx >= r->count)
+        return 0;
+    if (_fseeki64(r->f, SEG_HEADER + (long long)idx * SEG_RECORD, SEEK_SET) != 0 ||
+        fread(buf, 1, SEG_RECORD, r->f) != SEG_RECORD)
+        return -1;
+    decode_record(buf, &r->cur);
+    r->pos = idx;
+    r->valid = 1;
+    return 0;
+}
+
+// Sequential advance (no seek)
+static int seg_reader_next(SegReader *r) {
+    unsigned char buf[SEG_RECORD];
+    r->valid = 0;
+    if (r->pos + 1 >= r->count)
+        return 0;
+    if (fread(buf, 1, SEG_RECORD, r->f) != SEG_RECORD)
+        return -1;
+    decode_record(buf, &r->cur);
+    r->pos++;
+    r->valid = 1;
+    return 0;
+}
+
+static void seg_reader_close(SegReader *r) {
+    if (r->f)
+        fclose(r->f);
+    r->f = NULL;
+}
+
+// ---- ingestion ----
+
+int hist_ingest(HistStore *h, HistRecord *recs, size_t n) {
+    if (n == 0)
+        return 0;
+
+    qsort(recs, n, sizeof(HistRecord), record_cmp);
+
+    pthread_mutex_lock(&h->lock);
+    uint32_t id = h->next_id++;
+    pthread_mutex_unlock(&h->lock);
+
+    char path[300];
+    segment_path(h, id, path, sizeof(path));
+
+    SegWriter w;
+    if (seg_writer_open(&w, path) != 0) {
+        printf("History: could not create %s\n", path);
+        if (w.f) fclose(w.f);
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (seg_writer_put(&w, &recs[i]) != 0) {
+            printf("History: write to %s failed.\n", path);
+            fclose(w.f);
+            remove(path);
+            return -1;
+        }
+    }
+    if (seg_writer_close(&w) != 0) {
+        printf("History: write to %s failed.\n", path);
+        remove(path);
+        return -1;
+    }
+
+    // Publish: the segment only becomes visible once listed in the manifest
+    pthread_mutex_lock(&h->lock);
+    int rc = push_segment(h, id);
+    if (rc == 0)
+        rc = write_manifest(h);
+    pthread_mutex_unlock(&h->lock);
+    return rc;
+}
+
+// ---- compaction ----
+
+// K-way merge of the given segments into a new one, keeping only records
+// that change the state of their key. Returns 0 on success.
+static int merge_segments(HistStore *h, const uint32_t *ids, int count, uint32_t out_id) {
+    char path[300];
+    SegReader *readers = calloc(count, sizeof(SegReader));
+    if (readers == NULL)
+        return -1;
+
+    int rc = 0;
+    for (int i = 0; i < count; i++) {
+        segment_path(h, ids[i], path, sizeof(path));
+        if (seg_reader_open(&readers[i], path) != 0 ||
+            seg_reader_at(&readers[i], 0) != 0) {
+            printf("History: could not read %s\n", path);
+            rc = -1;
+            break;
+        }
+    }
+
+    SegWriter w = {0};
+    segment_path(h, out_id, path, sizeof(path));
+    if (rc == 0 && seg_writer_open(&w, path) != 0) {
+        printf("History: could not create %s\n", path);
+        rc = -1;
+    }
+
+    HistRecord last;
+    int have_last = 0;
+
+    while (rc == 0) {
+        // Segment count is small, so a linear minimum scan is enough
+        int best = -1;
+        for (int i = 0; i < count; i++) {
+            if (!readers[i].valid)
+                continue;
+            if (best < 0 || record_cmp(&readers[i].cur, &readers[best].cur) < 0)
+                best = i;
+        }
+        if (best < 0)
+            break;
+
+        HistRecord *r = &readers[best].cur;
+        int same_key = have_last &&
+                       key_cmp(r->addr, r->port, last.addr, last.port) == 0;
+        if (!same_key || r->state != last.state) {
+            if (seg_writer_put(&w, r) != 0) {
+                rc = -1;
+                break;
+            }
+            last = *r;
+            have_last = 1;
+        }
+        if (seg_reader_next(&readers[best]) != 0)
+            rc = -1;
+    }
+
+    for (int i = 0; i < count; i++)
+        seg_reader_close(&readers[i]);
+    free(readers);
+
+    if (w.f) {
+        if (rc == 0)
+            rc = seg_writer_close(&w);
+        else
+            fclose(w.f);
+        if (rc != 0)
+            remove(path);
+    }
+    return rc;
+}
+
+static void *compactor_main(void *arg) {
+    HistStore *h = (HistStore*)arg;
+
+    // Snapshot the segments to merge; ingestion may append more meanwhile
+    pthread_mutex_lock(&h->lock);
+    int count = h->num_segments;
+    uint32_t *ids = malloc(count * sizeof(uint32_t));
+    uint32_t out_id = h->next_id++;
+    if (ids)
+        memcpy(ids, h->segments, count * sizeof(uint32_t));
+    pthread_mutex_unlock(&h->lock);
+
+    if (ids == NULL)
+        return NULL;
+
+    if (merge_segments(h, ids, count, out_id) != 0) {
+        printf("History: compaction failed; store left unchanged.\n");
+        free(ids);
+        return NULL;
+    }
+
+    // Swap the merged prefix for the new segment, keeping later arrivals
+    pthread_mutex_lock(&h->lock);
+    h->segments[0] = out_id;
+    memmove(h->segments + 1, h->segments + count,
+            (h->num_segments - count) * sizeof(uint32_t));
+    h->num_segments -= count - 1;
+    int rc = write_manifest(h);
+    pthread_mutex_unlock(&h->lock);
+
+    // Old segments are unreachable once the manifest is replaced
+    if (rc == 0) {
+        char path[300];
+        for (int i = 0; i < count; i++) {
+            segment_path(h, ids[i], path, sizeof(path));
+            remove(path);
+        }
+    }
+
+    free(ids);
+    return NULL;
+}
+
+int hist_start_compaction(HistStore *h, int min_segments) {
+    if (h->compacting || h->num_segments < min_segments || h->num_segments < 2)
+        return 0;
+    if (pthread_create(&h->compactor, NULL, compactor_main, h) != 0)
+        return 0;
+    h->compacting = 1;
+    return 1;
+}
+
+// ---- queries ----
+
+static int time_cmp(const void *a, const void *b) {
+    const HistRecord *x = a, *y = b;
+    return (x->time > y->time) - (x->time < y->time);
+}
+
+int hist_query(HistStore *h, const unsigned char addr[16], uint16_t port,
+               HistRecord **out, size_t *n) {
+    HistRecord *res = NULL;
+    size_t len = 0, cap = 0;
+    char path[300];
+
+    pthread_mutex_lock(&h->lock);
+    int count = h->num_segments;
+    uint32_t *ids = malloc((count ? count : 1) * sizeof(uint32_t));
+    if (ids)
+        memcpy(ids, h->segments, count * sizeof(uint32_t));
+    pthread_mutex_unlock(&h->lock);
+    if (ids == NULL)
+        return -1;
+
+    int rc = 0;
+    for (int i = 0; i < count && rc == 0; i++) {
+        SegReader r;
+        segment_path(h, ids[i], path, sizeof(path));
+        if (seg_reader_open(&r, path) != 0) {
+            printf("History: could not read %s\n", path);
+            rc = -1;
+            break;
+        }
+
+        // Lower bound on (addr, port)
+        uint64_t lo = 0, hi = r.count;
+        while (lo < hi && rc == 0) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            if (seg_reader_at(&r, mid) != 0) {
+                rc = -1;
+                break;
+            }
+            if (key_cmp(r.cur.addr, r.cur.port, addr, port) < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        if (rc == 0 && seg_reader_at(&r, lo) != 0)
+            rc = -1;
+        while (rc == 0 && r.valid &&
+               key_cmp(r.cur.addr, r.cur.port, addr, port) == 0) {
+            if (len == cap) {
+                cap = cap ? cap * 2 : 16;
+                HistRecord *p = realloc(res, cap * sizeof(HistRecord));
+                if (p == NULL) {
+                    rc = -1;
+                    break;
+                }
+                res = p;
+            }
+            res[len++] = r.cur;
+            if (seg_reader_next(&r) != 0)
+                rc = -1;
+        }
+        seg_reader_close(&r);
+    }
+    free(ids);
+
+    if (rc != 0) {
+        free(res);
+        return -1;
+    }
+
+    // Segments may overlap in time if scans were ingested out of order
+    if (len > 1)
+        qsort(res, len, sizeof(HistRecord), time_cmp);
+
+    // Drop observations that repeat the previous state
+    size_t kept = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (kept == 0 || res[i].state != res[kept - 1].state)
+            res[kept++] = res[i];
+    }
+
+    *out = res;
+    *n = kept;
+    return 0;
+}
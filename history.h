@@ -0,0 +1,63 @@
+/*
+ * Historical port-state store
+ * Description:
+ *     Append-only, log-structured store of (address, port) observations.
+ *     Each ingested scan becomes one immutable segment sorted by
+ *     (address, port, time). A background compactor merges segments and
+ *     drops observations that did not change the state of their key, so
+ *     the store converges to a list of state transitions.
+ *
+ * On disk (for a store at <prefix>):
+ *     <prefix>.manifest        text list of live segment ids, oldest first
+ *     <prefix>.<id>.seg        fixed-size sorted records
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// Compaction kicks in once this many segments are live
+#define HIST_COMPACT_SEGMENTS 8
+
+// One observation of an (address, port) key
+typedef struct {
+    unsigned char addr[16]; // IPv6 or IPv4-mapped address
+    uint16_t port;
+    uint8_t state;          // PortState
+    int64_t time;           // unix time of the observation
+} HistRecord;
+
+// Open handle on a store
+typedef struct {
+    char prefix[260];
+    uint32_t *segments;     // live segment ids, oldest first
+    int num_segments;
+    int cap_segments;
+    uint32_t next_id;
+    pthread_mutex_t lock;   // protects segment list, next_id and manifest
+    pthread_t compactor;
+    int compacting;         // 1 while the compactor thread is joinable
+} HistStore;
+
+// Open (or create) the store at prefix. Returns 0 on success.
+int hist_open(HistStore *h, const char *prefix);
+
+// Wait for background compaction and release the handle
+void hist_close(HistStore *h);
+
+// Write records as a new segment. Sorts recs in place. Returns 0 on success.
+int hist_ingest(HistStore *h, HistRecord *recs, size_t n);
+
+// Start background compaction if at least min_segments are live.
+// Returns 1 if a compactor was started, 0 otherwise.
+int hist_start_compaction(HistStore *h, int min_segments);
+
+// Collect the state transitions of one key, oldest first. The caller frees
+// *out. Returns 0 on success.
+int hist_query(HistStore *h, const unsigned char addr[16], uint16_t port,
+               HistRecord **out, size_t *n);
+
+#endif
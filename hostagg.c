@@ -0,0 +1,233 @@
+/*
+ * Per-host result records (see hostagg.h)
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hostagg.h"
+
+typedef struct {
+    int64_t key;                // host index + 1, 0 = empty slot
+    int settled;                // probes of the host with their final result
+    int num_open;
+    int32_t chunk;              // arena chunk with the latest ports, -1 = none
+    uint16_t ports[AGG_INLINE_PORTS];
+} AggEntry;
+
+typedef struct {
+    uint16_t ports[AGG_CHUNK_PORTS];
+    int32_t prev;               // the host's previous chunk / next free one
+} AggChunk;
+
+static pthread_mutex_t LOCK = PTHREAD_MUTEX_INITIALIZER;
+static int PORTS_PER_HOST;
+
+static AggEntry *SLOTS;
+static size_t NUM_SLOTS;        // a power of two
+static int SLOT_BITS;
+static size_t USED;
+
+static AggChunk *CHUNKS;
+static int32_t NUM_CHUNKS, CAP_CHUNKS;
+static int32_t FREE_CHUNK = -1;
+
+// Fibonacci hashing: host indexes are sequential, so spread them out
+static size_t home_slot(int64_t key, int bits) {
+    return (size_t)(((uint64_t)key * 0x9e3779b97f4a7c15ULL) >> (64 - bits));
+}
+
+int agg_init(int ports_per_host) {
+    PORTS_PER_HOST = ports_per_host;
+    SLOTS = calloc(AGG_MIN_SLOTS, sizeof(AggEntry));
+    if (SLOTS == NULL) {
+        printf("Memory allocation failed.\n");
+        return -1;
+    }
+    NUM_SLOTS = AGG_MIN_SLOTS;
+    for (SLOT_BITS = 0; ((size_t)1 << SLOT_BITS) < NUM_SLOTS; SLOT_BITS++)
+        ;
+    USED = 0;
+    CHUNKS = NULL;
+    NUM_CHUNKS = CAP_CHUNKS = 0;
+    FREE_CHUNK = -1;
+    return 0;
+}
+
+static int grow_table(void) {
+    size_t n = NUM_SLOTS * 2;
+    AggEntry *slots = calloc(n, sizeof(AggEntry));
+    if (slots == NULL)
+        return -1;
+    for (size_t i = 0; i < NUM_SLOTS; i++) {
+        if (SLOTS[i].key == 0)
+            continue;
+        size_t j = home_slot(SLOTS[i].key, SLOT_BITS + 1);
+        while (slots[j].key != 0)
+            j = (j + 1) & (n - 1);
+        slots[j] = SLOTS[i];
+    }
+    free(SLOTS);
+    SLOTS = slots;
+    NUM_SLOTS = n;
+    SLOT_BITS++;
+    return 0;
+}
+
+// The host's entry, added if it has none. NULL on allocation failure.
+static AggEntry *lookup(int64_t host, int add) {
+    int64_t key = host + 1;
+    size_t i = home_slot(key, SLOT_BITS);
+    while (SLOTS[i].key != 0) {
+        if (SLOTS[i].key == key)
+            return &SLOTS[i];
+        i = (i + 1) & (NUM_SLOTS - 1);
+    }
+    if (!add)
+        return NULL;
+
+    // Keep probe runs short: at most half full
+    if ((USED + 1) * 2 > NUM_SLOTS) {
+        if (grow_table() != 0)
+            return NULL;
+        return lookup(host, add);
+    }
+    AggEntry *e = &SLOTS[i];
+    memset(e, 0, sizeof(*e));
+    e->key = key;
+    e->chunk = -1;
+    USED++;
+    return e;
+}
+
+// Empty slot i, moving later entries of its probe run back into the hole
+static void remove_slot(size_t i) {
+    size_t mask = NUM_SLOTS - 1;
+    for (size_t j = (i + 1) & mask; SLOTS[j].key != 0; j = (j + 1) & mask) {
+        size_t home = home_slot(SLOTS[j].key, SLOT_BITS);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            SLOTS[i] = SLOTS[j];
+            i = j;
+        }
+    }
+    SLOTS[i].key = 0;
+    USED--;
+}
+
+static int32_t new_chunk(void) {
+    if (FREE_CHUNK >= 0) {
+        int32_t c = FREE_CHUNK;
+        FREE_CHUNK = CHUNKS[c].prev;
+        return c;
+    }
+    if (NUM_CHUNKS == CAP_CHUNKS) {
+        int32_t cap = CAP_CHUNKS > 0 ? CAP_CHUNKS * 2 : 64;
+        AggChunk *chunks = realloc(CHUNKS, (size_t)cap * sizeof(AggChunk));
+        if (chunks == NULL)
+            return -1;
+        CHUNKS = chunks;
+        CAP_CHUNKS = cap;
+    }
+    return NUM_CHUNKS++;
+}
+
+int agg_open(int64_t host, int port) {
+    pthread_mutex_lock(&LOCK);
+    AggEntry *e = lookup(host, 1);
+    if (e == NULL) {
+        pthread_mutex_unlock(&LOCK);
+        return -1;
+    }
+    if (e->num_open < AGG_INLINE_PORTS) {
+        e->ports[e->num_open++] = (uint16_t)port;
+        pthread_mutex_unlock(&LOCK);
+        return 0;
+    }
+    int at = (e->num_open - AGG_INLINE_PORTS) % AGG_CHUNK_PORTS;
+    if (at == 0) {
+        int32_t c = new_chunk();
+        if (c < 0) {
+            pthread_mutex_unlock(&LOCK);
+            return -1;
+        }
+        CHUNKS[c].prev = e->chunk;
+        e->chunk = c;
+    }
+    CHUNKS[e->chunk].ports[at] = (uint16_t)port;
+    e->num_open++;
+    pthread_mutex_unlock(&LOCK);
+    return 0;
+}
+
+static int cmp_port(const void *a, const void *b) {
+    return (int)*(const uint16_t*)a - (int)*(const uint16_t*)b;
+}
+
+// Copy out e's ports, sorted, and hand its chunks back. Returns 0, or -1
+// (e unchanged) on allocation failure.
+static int take_ports(AggEntry *e, uint16_t **ports) {
+    *ports = NULL;
+    if (e->num_open == 0)
+        return 0;
+    uint16_t *out = malloc((size_t)e->num_open * sizeof(uint16_t));
+    if (out == NULL)
+        return -1;
+
+    int inline_ports = e->num_open < AGG_INLINE_PORTS ? e->num_open : AGG_INLINE_PORTS;
+    memcpy(out, e->ports, (size_t)inline_ports * sizeof(uint16_t));
+    int left = e->num_open - inline_ports;
+    int in_last = left > 0 ? (left - 1) % AGG_CHUNK_PORTS + 1 : 0;
+    for (int32_t c = e->chunk; c >= 0; ) {
+        left -= in_last;
+        memcpy(out + inline_ports + left, CHUNKS[c].ports, (size_t)in_last * sizeof(uint16_t));
+        in_last = AGG_CHUNK_PORTS;
+        int32_t prev = CHUNKS[c].prev;
+        CHUNKS[c].prev = FREE_CHUNK;
+        FREE_CHUNK = c;
+        c = prev;
+    }
+    e->chunk = -1;
+    qsort(out, (size_t)e->num_open, sizeof(uint16_t), cmp_port);
+    *ports = out;
+    return 0;
+}
+
+int agg_settle(int64_t host, uint16_t **ports) {
+    pthread_mutex_lock(&LOCK);
+    AggEntry *e = lookup(host, 1);
+    if (e == NULL || ++e->settled < PORTS_PER_HOST || take_ports(e, ports) != 0) {
+        // Not done yet; out of memory, the entry waits for agg_flush()
+        pthread_mutex_unlock(&LOCK);
+        return -1;
+    }
+    int n = e->num_open;
+    remove_slot((size_t)(e - SLOTS));
+    pthread_mutex_unlock(&LOCK);
+    return n;
+}
+
+void agg_flush(void (*emit)(void *ctx, int64_t host, const uint16_t *ports, int n), void *ctx) {
+    pthread_mutex_lock(&LOCK);
+    for (size_t i = 0; i < NUM_SLOTS; i++) {
+        uint16_t *ports;
+        AggEntry *e = &SLOTS[i];
+        if (e->key == 0 || e->num_open == 0)
+            continue;
+        if (take_ports(e, &ports) != 0) {
+            printf("Memory allocation failed.\n");
+            break;
+        }
+        emit(ctx, e->key - 1, ports, e->num_open);
+        free(ports);
+    }
+    free(SLOTS);
+    free(CHUNKS);
+    SLOTS = NULL;
+    CHUNKS = NULL;
+    NUM_SLOTS = USED = 0;
+    NUM_CHUNKS = CAP_CHUNKS = 0;
+    FREE_CHUNK = -1;
+    pthread_mutex_unlock(&LOCK);
+}
@@ -0,0 +1,44 @@
+/*
+ * Per-host result records (--by-host)
+ * Description:
+ *     Open ports are normally printed one line each, in completion order,
+ *     so a host's port list has to be put back together downstream. With
+ *     --by-host, workers add each open port to its host's entry instead,
+ *     count every settled probe toward it, and the worker that settles a
+ *     host's last probe prints one record with all its open ports.
+ *
+ *     Only hosts with probes still outstanding have an entry, which is
+ *     about one per worker, so the table stays small on any scan size. It
+ *     is an open-addressing hash table (linear probing, entries moved back
+ *     on removal instead of tombstones) keyed by host index. The first
+ *     AGG_INLINE_PORTS ports live in the entry; further ones go in chunks
+ *     of an arena that completed hosts hand back for reuse.
+ */
+
+#ifndef HOSTAGG_H
+#define HOSTAGG_H
+
+#include <stdint.h>
+
+#define AGG_MIN_SLOTS 64            // grows by doubling past half full
+#define AGG_INLINE_PORTS 6          // open ports kept in the entry itself
+#define AGG_CHUNK_PORTS 14          // ... and per arena chunk after that
+
+// Start a scan with ports_per_host probes per host. Returns 0, or -1 on
+// allocation failure.
+int agg_init(int ports_per_host);
+
+// An open port of host (by host index). Call before the job is settled.
+// Returns 0, or -1 on allocation failure (the caller prints it alone).
+int agg_open(int64_t host, int port);
+
+// One probe of host has its final result. Once the host's last one is in,
+// returns its number of open ports (0 = none, nothing to print) with
+// *ports set to them sorted (malloc'd, the caller frees); otherwise -1.
+int agg_settle(int64_t host, uint16_t **ports);
+
+// Entries left after the scan (re-probes that answered after their host
+// was printed), one call each, then free the table
+void agg_flush(void (*emit)(void *ctx, int64_t host, const uint16_t *ports, int n), void *ctx);
+
+#endif
@@ -0,0 +1,188 @@
+/*
+ * Local listener inventory (see listeners.h)
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <iphlpapi.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "scanner.h"
+#include "listeners.h"
+
+// Fetch one family's owner-PID listener table; the caller frees *out.
+// Returns 0, or -1 on failure.
+static int read_table(ULONG family, void **out) {
+    DWORD size = 0;
+    void *buf = NULL;
+    DWORD rc = ERROR_INSUFFICIENT_BUFFER;
+
+    // The table can grow between the size query and the read
+    for (int attempt = 0; attempt < 4 && rc == ERROR_INSUFFICIENT_BUFFER; attempt++) {
+        free(buf);
+        buf = size > 0 ? malloc(size) : NULL;
+        if (size > 0 && buf == NULL)
+            return -1;
+        rc = GetExtendedTcpTable(buf, &size, FALSE, family, TCP_TABLE_OWNER_PID_LISTENER, 0);
+    }
+    if (rc != NO_ERROR) {
+        free(buf);
+        return -1;
+    }
+    *out = buf;
+    return 0;
+}
+
+static int listener_cmp(const void *a, const void *b) {
+    const Listener *x = a, *y = b;
+    if (x->port != y->port)
+        return x->port < y->port ? -1 : 1;
+    return memcmp(x->addr, y->addr, 16);
+}
+
+int listeners_read(ListenerTable *t) {
+    t->items = NULL;
+    t->count = 0;
+
+    MIB_TCPTABLE_OWNER_PID *v4 = NULL;
+    MIB_TCP6TABLE_OWNER_PID *v6 = NULL;
+    if (read_table(AF_INET, (void**)&v4) != 0) {
+        printf("Local: cannot read the TCP listener table.\n");
+        return -1;
+    }
+    if (read_table(AF_INET6, (void**)&v6) != 0)
+        v6 = NULL;      // no IPv6 stack
+
+    int64_t n = v4->dwNumEntries + (v6 != NULL ? v6->dwNumEntries : 0);
+    t->items = malloc((size_t)(n > 0 ? n : 1) * sizeof(Listener));
+    if (t->items == NULL) {
+        printf("Local: out of memory.\n");
+        free(v4);
+        free(v6);
+        return -1;
+    }
+
+    for (DWORD i = 0; i < v4->dwNumEntries; i++) {
+        Listener *l = &t->items[t->count++];
+        struct in_addr a;
+        a.s_addr = v4->table[i].dwLocalAddr;
+        addr_from_ipv4(l->addr, &a);
+        l->port = ntohs((u_short)v4->table[i].dwLocalPort);
+        l->pid = v4->table[i].dwOwningPid;
+        l->accepts_ipv4 = 1;
+    }
+    for (DWORD i = 0; v6 != NULL && i < v6->dwNumEntries; i++) {
+        Listener *l = &t->items[t->count++];
+        memcpy(l->addr, v6->table[i].ucLocalAddr, 16);
+        l->port = ntohs((u_short)v6->table[i].dwLocalPort);
+        l->pid = v6->table[i].dwOwningPid;
+        l->accepts_ipv4 = -1;
+    }
+    free(v4);
+    free(v6);
+
+    qsort(t->items, (size_t)t->count, sizeof(Listener), listener_cmp);
+    return 0;
+}
+
+void listeners_free(ListenerTable *t) {
+    free(t->items);
+    t->items = NULL;
+    t->count = 0;
+}
+
+static int addr_is_any(const unsigned char a[16]) {
+    static const unsigned char zero[16];
+    if (addr_is_ipv4(a))
+        return memcmp(a + 12, zero, 4) == 0;
+    return memcmp(a, zero, 16) == 0;
+}
+
+// Whether the IPv6 wildcard listener l (one of items[first ..], all on its
+// port) takes IPv4 connections: connect to an IPv4 loopback address that no
+// IPv4 listener on the port holds, so only l can answer
+static int accepts_ipv4(const ListenerTable *t, int64_t first, const Listener *l) {
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(l->port);
+    for (uint32_t host = 1; host < 255; host++) {
+        unsigned char a[16];
+        struct in_addr v4;
+        v4.s_addr = htonl(0x7f000000u | host);
+        addr_from_ipv4(a, &v4);
+        int held = 0;
+        for (int64_t i = first; i < t->count && t->items[i].port == l->port && !held; i++)
+            held = memcmp(t->items[i].addr, a, 16) == 0;
+        if (!held) {
+            sin.sin_addr = v4;
+            break;
+        }
+    }
+    if (sin.sin_addr.s_addr == 0)
+        return 0;
+
+    SOCKET s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == INVALID_SOCKET)
+        return 0;
+    int ok = connect(s, (struct sockaddr*)&sin, sizeof(sin)) == 0;
+    closesocket(s);
+    return ok;
+}
+
+const Listener *listener_find(ListenerTable *t, const unsigned char addr[16], int port) {
+    // First listener on the port
+    int64_t lo = 0, hi = t->count;
+    while (lo < hi) {
+        int64_t mid = (lo + hi) / 2;
+        if (t->items[mid].port < port)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    int v4 = addr_is_ipv4(addr);
+    Listener *dual = NULL;
+    for (int64_t i = lo; i < t->count && t->items[i].port == port; i++) {
+        Listener *l = &t->items[i];
+        if (addr_is_ipv4(l->addr) != v4) {
+            if (v4 && addr_is_any(l->addr))
+                dual = l;
+            continue;
+        }
+        if (addr_is_any(l->addr) || memcmp(l->addr, addr, 16) == 0)
+            return l;
+    }
+
+    // IPv4 to an IPv6 wildcard listener, unless it is IPV6_V6ONLY
+    if (dual != NULL && dual->accepts_ipv4 < 0)
+        dual->accepts_ipv4 = (int8_t)accepts_ipv4(t, lo, dual);
+    return dual != NULL && dual->accepts_ipv4 ? dual : NULL;
+}
+
+int addr_is_local(const unsigned char addr[16], unsigned int scope_id) {
+    struct sockaddr_storage ss;
+    int len;
+    memset(&ss, 0, sizeof(ss));
+    if (addr_is_ipv4(addr)) {
+        struct sockaddr_in *sin = (struct sockaddr_in*)&ss;
+        sin->sin_family = AF_INET;
+        memcpy(&sin->sin_addr, addr + 12, 4);
+        len = sizeof(*sin);
+    } else {
+        struct sockaddr_in6 *sin6 = (struct sockaddr_in6*)&ss;
+        sin6->sin6_family = AF_INET6;
+        memcpy(&sin6->sin6_addr, addr, 16);
+        sin6->sin6_scope_id = scope_id;
+        len = sizeof(*sin6);
+    }
+
+    SOCKET s = socket(ss.ss_family, SOCK_STREAM, 0);
+    if (s == INVALID_SOCKET)
+        return 0;
+    int local = bind(s, (struct sockaddr*)&ss, len) == 0;
+    closesocket(s);
+    return local;
+}
@@ -0,0 +1,47 @@
+/*
+ * Local listener inventory (--local)
+ * Description:
+ *     When the targets are the scanning host's own addresses, the kernel
+ *     already knows every listening socket: reading its TCP tables
+ *     (GetExtendedTcpTable, IPv4 and IPv6) takes milliseconds, where
+ *     connecting to 65535 ports per address takes a full scan. A port is
+ *     open for a local address if a socket listens on that address or on
+ *     the wildcard address of its family; every other port is closed.
+ *     An IPv6 wildcard socket is only in the IPv6 table but also accepts
+ *     IPv4 unless it is IPV6_V6ONLY, which the table doesn't show, so for
+ *     IPv4 targets one loopback connect per such socket settles it.
+ *
+ *     Only the current network compartment is read. Containers with their
+ *     own network stack show up through the ports they publish on the host.
+ */
+
+#ifndef LISTENERS_H
+#define LISTENERS_H
+
+#include <stdint.h>
+
+typedef struct {
+    unsigned char addr[16];     // bound address (IPv4-mapped); any = wildcard
+    uint16_t port;
+    uint32_t pid;               // owning process
+    int8_t accepts_ipv4;        // IPv6 wildcard: -1 = not checked yet
+} Listener;
+
+// Listening sockets, sorted by port
+typedef struct {
+    Listener *items;
+    int64_t count;
+} ListenerTable;
+
+// Read every TCP listening socket. Returns 0, or -1 after printing why.
+int listeners_read(ListenerTable *t);
+void listeners_free(ListenerTable *t);
+
+// The listener accepting connections to addr:port, or NULL (closed). May
+// connect over loopback once per IPv6 wildcard listener (see above).
+const Listener *listener_find(ListenerTable *t, const unsigned char addr[16], int port);
+
+// 1 if addr is one of this host's addresses (something can bind to it)
+int addr_is_local(const unsigned char addr[16], unsigned int scope_id);
+
+#endif
@@ -0,0 +1,229 @@
+/*
+ * Persistent liveness cache (see liveness.h)
+ */
+
+#include <winsock2.h>
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scanner.h"
+#include "liveness.h"
+
+#define LIVE_MAGIC "PSLV"
+#define LIVE_VERSION 1
+#define LIVE_PAGES 65536            // one per /16
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t runs;                  // runs recorded so far
+    uint32_t last_full;             // run number of the last re-validation
+    uint32_t num_pages;
+    uint32_t reserved[3];
+    uint32_t page_of[LIVE_PAGES];   // /16 -> page number + 1, 0 = none
+} LiveHeader;
+
+typedef struct {
+    uint8_t alive[65536 / 8];
+    uint32_t last_seen[65536];
+    uint8_t dead_runs[65536];
+    uint8_t last_type[65536];
+} LivePage;
+
+// An open, mapped cache file
+typedef struct {
+    HANDLE file;
+    HANDLE mapping;
+    unsigned char *base;
+    LiveHeader *hdr;
+} LiveMap;
+
+static LivePage *page_at(const LiveMap *m, uint32_t number) {
+    return (LivePage*)(m->base + sizeof(LiveHeader) + (size_t)(number - 1) * sizeof(LivePage));
+}
+
+// Every /16's page number must be one of the pages the file holds
+static int pages_valid(const LiveHeader *hdr) {
+    for (uint32_t i = 0; i < LIVE_PAGES; i++)
+        if (hdr->page_of[i] > hdr->num_pages)
+            return 0;
+    return 1;
+}
+
+static void live_unmap(LiveMap *m) {
+    if (m->base != NULL) {
+        FlushViewOfFile(m->base, 0);
+        UnmapViewOfFile(m->base);
+    }
+    if (m->mapping != NULL)
+        CloseHandle(m->mapping);
+    if (m->file != INVALID_HANDLE_VALUE)
+        CloseHandle(m->file);
+}
+
+// Map path with room for extra_pages more pages (growing the file), or
+// read-only when writable is 0. Returns 1 if mapped, 0 if the file doesn't
+// exist (read-only only), -1 after printing why.
+static int live_map(LiveMap *m, const char *path, int writable, uint32_t extra_pages) {
+    memset(m, 0, sizeof(*m));
+    m->file = CreateFileA(path, writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, 0, NULL,
+                          writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m->file == INVALID_HANDLE_VALUE) {
+        if (!writable)
+            return 0;
+        printf("Liveness: cannot open %s.\n", path);
+        return -1;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m->file, &size)) {
+        printf("Liveness: cannot read %s.\n", path);
+        live_unmap(m);
+        return -1;
+    }
+    int fresh = size.QuadPart == 0;
+    if (fresh && !writable) {
+        live_unmap(m);
+        return 0;
+    }
+
+    // Existing files hold the header and num_pages pages; new pages go on
+    // the end
+    uint64_t bytes = (fresh ? sizeof(LiveHeader) : (uint64_t)size.QuadPart) +
+                     (uint64_t)extra_pages * sizeof(LivePage);
+    if (!fresh && (uint64_t)size.QuadPart < sizeof(LiveHeader)) {
+        printf("Liveness: %s is not a liveness cache.\n", path);
+        live_unmap(m);
+        return -1;
+    }
+    m->mapping = CreateFileMappingA(m->file, NULL, writable ? PAGE_READWRITE : PAGE_READONLY,
+                                    (DWORD)(bytes >> 32), (DWORD)bytes, NULL);
+    if (m->mapping != NULL)
+        m->base = MapViewOfFile(m->mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ,
+                                0, 0, (SIZE_T)bytes);
+    if (m->base == NULL) {
+        printf("Liveness: cannot map %s.\n", path);
+        live_unmap(m);
+        return -1;
+    }
+    m->hdr = (LiveHeader*)m->base;
+    if (fresh) {
+        memcpy(m->hdr->magic, LIVE_MAGIC, 4);
+        m->hdr->version = LIVE_VERSION;
+    } else if (memcmp(m->hdr->magic, LIVE_MAGIC, 4) != 0 || m->hdr->version != LIVE_VERSION ||
+               (uint64_t)size.QuadPart != sizeof(LiveHeader) + (uint64_t)m->hdr->num_pages * sizeof(LivePage) ||
+               !pages_valid(m->hdr)) {
+        printf("Liveness: %s is not a liveness cache.\n", path);
+        live_unmap(m);
+        return -1;
+    }
+    return 1;
+}
+
+static int revalidation_due(const LiveHeader *hdr) {
+    return hdr->runs - hdr->last_full + 1 >= LIVE_REVALIDATE_RUNS;
+}
+
+int live_dead_hosts(const char *path, const TargetSet *targets, int dead_runs,
+                    TargetSet *dead, int *full) {
+    tset_init(dead);
+    *full = 1;
+
+    LiveMap m;
+    int rc = live_map(&m, path, 0, 0);
+    if (rc <= 0)
+        return rc;          // a new cache starts with a full run
+
+    *full = revalidation_due(m.hdr);
+    if (*full || dead_runs <= 0) {
+        live_unmap(&m);
+        return 0;
+    }
+
+    for (int64_t i = 0; i < targets->count; i++) {
+        uint32_t a = targets->ranges[i].lo;
+        for (;;) {
+            uint32_t number = m.hdr->page_of[a >> 16];
+            uint32_t page_end = a | 0xffff;
+            uint32_t hi = targets->ranges[i].hi < page_end ? targets->ranges[i].hi : page_end;
+            if (number != 0) {
+                const LivePage *p = page_at(&m, number);
+                for (uint32_t x = a; ; x++) {
+                    if (p->dead_runs[x & 0xffff] >= dead_runs && tset_append(dead, x, x) != 0) {
+                        printf("Liveness: out of memory.\n");
+                        tset_free(dead);
+                        live_unmap(&m);
+                        return -1;
+                    }
+                    if (x == hi)
+                        break;
+                }
+            }
+            if (hi == targets->ranges[i].hi)
+                break;
+            a = hi + 1;
+        }
+    }
+    live_unmap(&m);
+    return 0;
+}
+
+int live_record(const char *path, const uint32_t *addrs, const unsigned char *states,
+                int64_t n, time_t now, int full) {
+    // Pages to add for /16s seen for the first time
+    LiveMap m;
+    int rc = live_map(&m, path, 0, 0);
+    if (rc < 0)
+        return -1;
+    unsigned char *added = calloc(LIVE_PAGES, 1);
+    if (added == NULL) {
+        printf("Liveness: out of memory.\n");
+        if (rc > 0)
+            live_unmap(&m);
+        return -1;
+    }
+    uint32_t extra = 0;
+    for (int64_t i = 0; i < n; i++) {
+        uint32_t block = addrs[i] >> 16;
+        if ((rc == 0 || m.hdr->page_of[block] == 0) && !added[block]) {
+            added[block] = 1;
+            extra++;
+        }
+    }
+    if (rc > 0)
+        live_unmap(&m);
+
+    if (live_map(&m, path, 1, extra) < 0) {
+        free(added);
+        return -1;
+    }
+    LiveHeader *hdr = m.hdr;
+    for (uint32_t block = 0; block < LIVE_PAGES; block++)
+        if (added[block])
+            hdr->page_of[block] = ++hdr->num_pages;
+    free(added);
+
+    for (int64_t i = 0; i < n; i++) {
+        LivePage *p = page_at(&m, hdr->page_of[addrs[i] >> 16]);
+        uint32_t x = addrs[i] & 0xffff;
+        uint8_t bit = (uint8_t)(1u << (x & 7));
+        if (states[i] != PORT_FILTERED) {
+            p->alive[x >> 3] |= bit;
+            p->last_seen[x] = (uint32_t)now;
+            p->last_type[x] = states[i];
+            p->dead_runs[x] = 0;
+        } else {
+            p->alive[x >> 3] &= (uint8_t)~bit;
+            if (p->dead_runs[x] < UINT8_MAX)
+                p->dead_runs[x]++;
+        }
+    }
+
+    hdr->runs++;
+    if (full)
+        hdr->last_full = hdr->runs;
+    live_unmap(&m);
+    return 0;
+}
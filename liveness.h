@@ -0,0 +1,51 @@
+/*
+ * Persistent liveness cache (--liveness)
+ * Description:
+ *     Repeated scans of the same space keep probing addresses that have not
+ *     answered for weeks. The cache remembers, per IPv4 address, whether it
+ *     answered on its last scan, when it last answered, how it answered and
+ *     for how many consecutive runs it has been silent. Hosts silent for
+ *     --dead-runs runs in a row are left out of later scans, except on every
+ *     LIVE_REVALIDATE_RUNS'th run, which probes everything again so hosts
+ *     that come back are noticed.
+ *
+ *     A host counts as alive if any of its ports answered at all (open,
+ *     closed or unfiltered); only all-filtered hosts are silent.
+ *
+ * On disk (memory-mapped, one file):
+ *     header      magic, run counters, page directory (one entry per /16)
+ *     pages       one per /16 that was ever scanned:
+ *                   alive bitmap        1 bit per address
+ *                   last_seen[65536]    unix time of the last answer, 0 = never
+ *                   dead_runs[65536]    consecutive silent runs (saturating)
+ *                   last_type[65536]    PortState of the last answer
+ */
+
+#ifndef LIVENESS_H
+#define LIVENESS_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "targetset.h"
+
+// Skip hosts silent for this many runs in a row (--dead-runs)
+#define LIVE_DEFAULT_DEAD_RUNS 3
+
+// Every this many runs, nothing is skipped
+#define LIVE_REVALIDATE_RUNS 10
+
+// Hosts of targets that were silent for at least dead_runs runs, as a
+// range set in *dead (empty on a re-validation run, for a new cache or if
+// dead_runs is 0). *full is set to 1 on a re-validation run. Returns 0, or
+// -1 after printing why.
+int live_dead_hosts(const char *path, const TargetSet *targets, int dead_runs,
+                    TargetSet *dead, int *full);
+
+// Record one run: addrs[i] answered with states[i] (PORT_FILTERED = no
+// answer). full marks a re-validation run. Creates the cache if needed.
+// Returns 0, or -1 after printing why.
+int live_record(const char *path, const uint32_t *addrs, const unsigned char *states,
+                int64_t n, time_t now, int full);
+
+#endif
@@ -0,0 +1,368 @@
+/*
+ * Embedded Lua probe scripts (see lua_engine.h)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <lualib.h>
+
+#include "lua_engine.h"
+
+// CPU limit is checked every LUA_HOOK_INTERVAL instructions
+#define LUA_HOOK_INTERVAL 1000
+
+// One preloaded Lua state; used by one probe at a time
+typedef struct LuaVM {
+    lua_State *L;
+    int action_ref[LUA_MAX_SCRIPTS];    // registry refs of each script's action()
+    int sock_ref;                       // shared socket object
+    size_t used;                        // bytes currently allocated
+    size_t base;                        // used when the current invocation began
+    int active;                         // an invocation is running
+    struct LuaVM *next;                 // free list / all-VMs list
+} LuaVM;
+
+// Per-probe state (PsPlugin.state_size)
+typedef struct {
+    LuaVM *vm;
+    lua_State *co;          // coroutine running action()
+    int co_ref;             // keeps co alive while suspended
+    int pending;            // PsProbeAction requested by the last yield
+    long instructions;
+    PsProbeIO *io;
+} LuaProbe;
+
+static const char *SCRIPT_PATHS[LUA_MAX_SCRIPTS];
+static int NUM_SCRIPTS = 0;
+
+// port -> script index + 1 (0 = no script)
+static unsigned char PORT_SCRIPT[65536];
+
+// VM pool: idle VMs, plus every VM ever created for shutdown
+static pthread_mutex_t POOL_LOCK = PTHREAD_MUTEX_INITIALIZER;
+static LuaVM *FREE_VMS = NULL;
+static LuaVM *ALL_VMS[1024];
+static int NUM_VMS = 0;
+
+// Allocator that enforces LUA_MEM_LIMIT on growth during an invocation.
+// Lua runs an emergency collection and retries before raising an error.
+static void *vm_alloc(void *ud, void *ptr, size_t osize, size_t nsize) {
+    LuaVM *vm = (LuaVM*)ud;
+    if (ptr == NULL)
+        osize = 0;  // osize encodes the object type for new blocks
+
+    if (nsize == 0) {
+        free(ptr);
+        vm->used -= osize;
+        return NULL;
+    }
+
+    size_t after = vm->used - osize + nsize;
+    if (vm->active && nsize > osize && after > vm->base &&
+        after - vm->base > LUA_MEM_LIMIT)
+        return NULL;
+
+    void *p = realloc(ptr, nsize);
+    if (p != NULL)
+        vm->used = after;
+    return p;
+}
+
+static LuaProbe *probe_of(lua_State *L) {
+    return *(LuaProbe**)lua_getextraspace(L);
+}
+
+static void cpu_hook(lua_State *L, lua_Debug *ar) {
+    (void)ar;
+    LuaProbe *pr = probe_of(L);
+    if (pr == NULL)
+        return;
+    pr->instructions += LUA_HOOK_INTERVAL;
+    if (pr->instructions > LUA_CPU_LIMIT)
+        luaL_error(L, "CPU limit exceeded");
+}
+
+// sock:send(data) -> true | nil, err
+static int sock_send(lua_State *L) {
+    LuaProbe *pr = probe_of(L);
+    size_t len;
+    const char *data = luaL_checklstring(L, 2, &len);
+    if (pr == NULL)
+        return luaL_error(L, "sock used outside a probe");
+
+    if (len > (size_t)pr->io->cap)
+        len = (size_t)pr->io->cap;
+    memcpy(pr->io->buf, data, len);
+    pr->io->len = (int)len;
+    pr->pending = PS_PROBE_SEND;
+    return lua_yield(L, 0);
+}
+
+// sock:recv() -> data | nil, "closed" / "timeout" / "error"
+static int sock_recv(lua_State *L) {
+    LuaProbe *pr = probe_of(L);
+    if (pr == NULL)
+        return luaL_error(L, "sock used outside a probe");
+
+    pr->pending = PS_PROBE_RECV;
+    return lua_yield(L, 0);
+}
+
+// Create a state and run every script in its own environment. With
+// read_ports, each script's ports table is merged into PORT_SCRIPT.
+static LuaVM *vm_create(int read_ports) {
+    LuaVM *vm = calloc(1, sizeof(LuaVM));
+    if (vm == NULL)
+        return NULL;
+    lua_State *L = lua_newstate(vm_alloc, vm);
+    if (L == NULL) {
+        free(vm);
+        return NULL;
+    }
+    vm->L = L;
+    *(LuaProbe**)lua_getextraspace(L) = NULL;  // copied into new coroutines
+    luaL_openlibs(L);
+
+    lua_createtable(L, 0, 2);
+    lua_pushcfunction(L, sock_send);
+    lua_setfield(L, -2, "send");
+    lua_pushcfunction(L, sock_recv);
+    lua_setfield(L, -2, "recv");
+    vm->sock_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    for (int i = 0; i < NUM_SCRIPTS; i++) {
+        if (luaL_loadfile(L, SCRIPT_PATHS[i]) != LUA_OK) {
+            printf("Script %s: %s\n", SCRIPT_PATHS[i], lua_tostring(L, -1));
+            lua_close(L);
+            free(vm);
+            return NULL;
+        }
+
+        // Private _ENV falling back to the standard globals
+        lua_newtable(L);
+        lua_newtable(L);
+        lua_pushglobaltable(L);
+        lua_setfield(L, -2, "__index");
+        lua_setmetatable(L, -2);
+        lua_pushvalue(L, -1);
+        lua_setupvalue(L, -3, 1);
+        lua_insert(L, -2);                      // env, chunk
+
+        const char *err = NULL;
+        if (lua_pcall(L, 0, 0, 0) != LUA_OK)
+            err = lua_tostring(L, -1);
+        else if (lua_getfield(L, -1, "action") != LUA_TFUNCTION)
+            err = "does not define action(target, sock)";
+        if (err != NULL) {
+            printf("Script %s: %s\n", SCRIPT_PATHS[i], err);
+            lua_close(L);
+            free(vm);
+            return NULL;
+        }
+        vm->action_ref[i] = luaL_ref(L, LUA_REGISTRYINDEX);
+
+        if (read_ports) {
+            if (lua_getfield(L, -1, "ports") == LUA_TTABLE) {
+                lua_Integer n = (lua_Integer)lua_rawlen(L, -1);
+                for (lua_Integer j = 1; j <= n; j++) {
+                    lua_rawgeti(L, -1, j);
+                    lua_Integer port = lua_tointeger(L, -1);
+                    if (port >= 1 && port <= 65535 && PORT_SCRIPT[port] == 0)
+                        PORT_SCRIPT[port] = (unsigned char)(i + 1);
+                    lua_pop(L, 1);
+                }
+            } else {
+                printf("Script %s: no ports table, script never runs.\n", SCRIPT_PATHS[i]);
+            }
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 1);                          // env
+    }
+    return vm;
+}
+
+static void pool_put(LuaVM *vm) {
+    pthread_mutex_lock(&POOL_LOCK);
+    vm->next = FREE_VMS;
+    FREE_VMS = vm;
+    pthread_mutex_unlock(&POOL_LOCK);
+}
+
+static LuaVM *pool_get(void) {
+    pthread_mutex_lock(&POOL_LOCK);
+    LuaVM *vm = FREE_VMS;
+    if (vm != NULL)
+        FREE_VMS = vm->next;
+    int room = NUM_VMS < (int)(sizeof(ALL_VMS) / sizeof(ALL_VMS[0]));
+    pthread_mutex_unlock(&POOL_LOCK);
+    if (vm != NULL || !room)
+        return vm;
+
+    // Pool empty: preload another state (outside the lock, it runs scripts)
+    vm = vm_create(0);
+    if (vm == NULL)
+        return NULL;
+    pthread_mutex_lock(&POOL_LOCK);
+    if (NUM_VMS < (int)(sizeof(ALL_VMS) / sizeof(ALL_VMS[0]))) {
+        ALL_VMS[NUM_VMS++] = vm;
+    } else {
+        pthread_mutex_unlock(&POOL_LOCK);
+        lua_close(vm->L);
+        free(vm);
+        return NULL;
+    }
+    pthread_mutex_unlock(&POOL_LOCK);
+    return vm;
+}
+
+// Resume the coroutine with nargs values on its stack and translate the
+// outcome into the next plugin action
+static int lua_continue(LuaProbe *pr, int nargs) {
+    lua_State *co = pr->co;
+    PsProbeIO *io = pr->io;
+    int nres = 0;
+
+    pr->pending = PS_PROBE_DONE;
+    int status = lua_resume(co, pr->vm->L, nargs, &nres);
+
+    if (status == LUA_YIELD) {
+        lua_pop(co, nres);
+        if (pr->pending != PS_PROBE_DONE)
+            return pr->pending;
+        snprintf(io->result, io->result_cap, "lua: yield outside sock calls");
+        return PS_PROBE_DONE;
+    }
+
+    if (status == LUA_OK) {
+        if (nres > 0 && lua_type(co, -nres) != LUA_TNIL) {
+            const char *s = lua_tostring(co, -nres);
+            if (s != NULL)
+                snprintf(io->result, io->result_cap, "%s", s);
+        }
+        return PS_PROBE_DONE;
+    }
+
+    const char *msg = lua_tostring(co, -1);
+    snprintf(io->result, io->result_cap, "lua error: %s", msg ? msg : "unknown");
+    return PS_PROBE_DONE;
+}
+
+static void lua_match_ports(const uint16_t *ports, uint8_t *match, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++)
+        match[i] = PORT_SCRIPT[ports[i]] != 0;
+}
+
+static int lua_begin(void *state, const PsProbeTarget *target, PsProbeIO *io) {
+    LuaProbe *pr = (LuaProbe*)state;
+    int script = PORT_SCRIPT[target->port] - 1;
+    pr->io = io;
+    if (script < 0)
+        return PS_PROBE_DONE;
+
+    pr->vm = pool_get();
+    if (pr->vm == NULL) {
+        snprintf(io->result, io->result_cap, "lua: no interpreter available");
+        return PS_PROBE_DONE;
+    }
+
+    lua_State *L = pr->vm->L;
+    pr->vm->base = pr->vm->used;
+    pr->vm->active = 1;
+
+    pr->co = lua_newthread(L);
+    pr->co_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    *(LuaProbe**)lua_getextraspace(pr->co) = pr;
+    lua_sethook(pr->co, cpu_hook, LUA_MASKCOUNT, LUA_HOOK_INTERVAL);
+
+    lua_State *co = pr->co;
+    lua_rawgeti(co, LUA_REGISTRYINDEX, pr->vm->action_ref[script]);
+    lua_createtable(co, 0, 3);
+    lua_pushstring(co, target->ip);
+    lua_setfield(co, -2, "ip");
+    lua_pushinteger(co, target->port);
+    lua_setfield(co, -2, "port");
+    lua_pushlstring(co, target->banner ? target->banner : "", (size_t)target->banner_len);
+    lua_setfield(co, -2, "banner");
+    lua_rawgeti(co, LUA_REGISTRYINDEX, pr->vm->sock_ref);
+
+    return lua_continue(pr, 2);
+}
+
+static int lua_step(void *state, PsProbeIO *io) {
+    LuaProbe *pr = (LuaProbe*)state;
+    lua_State *co = pr->co;
+    int nargs = 1;
+    pr->io = io;
+
+    if (io->event == PS_EVENT_SENT) {
+        lua_pushboolean(co, 1);
+    } else if (io->event == PS_EVENT_DATA) {
+        lua_pushlstring(co, (const char*)io->buf, (size_t)io->len);
+    } else {
+        lua_pushnil(co);
+        lua_pushstring(co, io->event == PS_EVENT_CLOSED ? "closed" :
+                           io->event == PS_EVENT_TIMEOUT ? "timeout" : "error");
+        nargs = 2;
+    }
+    return lua_continue(pr, nargs);
+}
+
+static void lua_end(void *state) {
+    LuaProbe *pr = (LuaProbe*)state;
+    if (pr->vm == NULL)
+        return;
+
+    // Dropping the reference lets even a suspended coroutine be collected
+    lua_State *L = pr->vm->L;
+    luaL_unref(L, LUA_REGISTRYINDEX, pr->co_ref);
+    pr->vm->active = 0;
+    lua_gc(L, LUA_GCSTEP, 0);
+    pool_put(pr->vm);
+}
+
+static void lua_unload(void) {
+    pthread_mutex_lock(&POOL_LOCK);
+    for (int i = 0; i < NUM_VMS; i++) {
+        lua_close(ALL_VMS[i]->L);
+        free(ALL_VMS[i]);
+    }
+    NUM_VMS = 0;
+    FREE_VMS = NULL;
+    pthread_mutex_unlock(&POOL_LOCK);
+}
+
+static const PsPlugin LUA_PLUGIN = {
+    PS_PLUGIN_ABI_VERSION,
+    sizeof(PsPlugin),
+    "lua",
+    sizeof(LuaProbe),
+    lua_match_ports,
+    lua_begin,
+    lua_step,
+    lua_end,
+    lua_unload
+};
+
+const PsPlugin *lua_engine_init(const char **paths, int num_paths) {
+    if (num_paths > LUA_MAX_SCRIPTS) {
+        printf("At most %d --script files are supported.\n", LUA_MAX_SCRIPTS);
+        return NULL;
+    }
+    for (int i = 0; i < num_paths; i++)
+        SCRIPT_PATHS[i] = paths[i];
+    NUM_SCRIPTS = num_paths;
+
+    LuaVM *vm = vm_create(1);
+    if (vm == NULL)
+        return NULL;
+    ALL_VMS[NUM_VMS++] = vm;
+    pool_put(vm);
+
+    printf("Loaded %d Lua script(s)\n", num_paths);
+    return &LUA_PLUGIN;
+}
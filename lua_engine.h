@@ -0,0 +1,38 @@
+/*
+ * Embedded Lua probe scripts (--script, builds with -DWITH_LUA)
+ * Description:
+ *     Runs per-service Lua scripts as a built-in probe plugin. Each script
+ *     declares the ports it handles and an action() that talks to the open
+ *     port through a socket object:
+ *
+ *         ports = { 6379 }
+ *         function action(target, sock)
+ *             sock:send("PING\r\n")
+ *             local reply, err = sock:recv()
+ *             return reply and ("redis: " .. reply) or err
+ *         end
+ *
+ *     Every invocation is a coroutine; sock:send() / sock:recv() yield back
+ *     to the scanner, which performs the I/O and resumes the coroutine with
+ *     the outcome (see plugin_api.h). Lua states are preloaded with all
+ *     scripts and pooled, so an invocation only costs a coroutine. Each
+ *     invocation is capped at LUA_CPU_LIMIT VM instructions and may grow
+ *     its state's heap by at most LUA_MEM_LIMIT bytes.
+ */
+
+#ifndef LUA_ENGINE_H
+#define LUA_ENGINE_H
+
+#include "plugin_api.h"
+
+#define LUA_MAX_SCRIPTS 32
+
+// Per-invocation caps
+#define LUA_CPU_LIMIT 10000000L         // VM instructions
+#define LUA_MEM_LIMIT (8 * 1024 * 1024) // bytes of heap growth
+
+// Load scripts into the first VM of the pool and build the port table.
+// Returns the engine's plugin descriptor, or NULL after printing why.
+const PsPlugin *lua_engine_init(const char **paths, int num_paths);
+
+#endif
@@ -0,0 +1,322 @@
+/*
+ * Enrichment pipeline (see pipeline.h)
+ */
+
+#include <winsock2.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scanner.h"
+#include "pipeline.h"
+
+// Bounded FIFO of items between two stages
+typedef struct {
+    PipeItem *items;
+    int cap;
+    int head;                   // next item to take
+    int count;
+    int closed;                 // no more pushes; consumers exit when empty
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} PipeQueue;
+
+typedef struct Stage {
+    PipeStageDef def;
+    PipeQueue in;
+    pthread_t *threads;
+    struct Stage *next;         // NULL = last stage, hands items to the sink
+    // Counters, under in.lock
+    long long processed;
+    long long found;
+    double busy_ms;
+} Stage;
+
+static Stage STAGES[PIPE_MAX_STAGES];
+static int NUM_STAGES = 0;
+static int RUNNING = 0;
+static PipeSink SINK;
+static long long SKIPPED;       // results printed unenriched (first queue full)
+
+// Banner buffers shared by all items in flight: allocated as banners
+// arrive, up to MAX_BANNERS, and kept on a stack of free ones for reuse
+static char **FREE_BANNERS;     // MAX_BANNERS slots
+static int MAX_BANNERS;
+static int NUM_BANNERS;         // allocated so far
+static int NUM_FREE;
+static int PEAK_BANNERS;        // most in use at once
+static long long NO_BANNER;     // results printed unenriched (pool empty)
+static pthread_mutex_t BANNER_LOCK = PTHREAD_MUTEX_INITIALIZER;
+
+static char *banner_take(void) {
+    char *buf = NULL;
+    pthread_mutex_lock(&BANNER_LOCK);
+    if (NUM_FREE > 0) {
+        buf = FREE_BANNERS[--NUM_FREE];
+    } else if (NUM_BANNERS < MAX_BANNERS && (buf = malloc(PIPE_BANNER_MAX)) != NULL) {
+        NUM_BANNERS++;
+    }
+    if (buf == NULL)
+        NO_BANNER++;
+    else if (NUM_BANNERS - NUM_FREE > PEAK_BANNERS)
+        PEAK_BANNERS = NUM_BANNERS - NUM_FREE;
+    pthread_mutex_unlock(&BANNER_LOCK);
+    return buf;
+}
+
+static void banner_release(const PipeItem *item) {
+    if (item->banner_len == 0)
+        return;
+    pthread_mutex_lock(&BANNER_LOCK);
+    FREE_BANNERS[NUM_FREE++] = (char*)item->banner;
+    pthread_mutex_unlock(&BANNER_LOCK);
+}
+
+// Free the pool (every buffer is back on the free stack by now)
+static void banner_free_all(void) {
+    for (int i = 0; i < NUM_FREE; i++)
+        free(FREE_BANNERS[i]);
+    free(FREE_BANNERS);
+    FREE_BANNERS = NULL;
+    NUM_BANNERS = NUM_FREE = 0;
+}
+
+static void queue_push(PipeQueue *q, const PipeItem *item) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->cap)
+        pthread_cond_wait(&q->not_full, &q->lock);
+    q->items[(q->head + q->count) % q->cap] = *item;
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static int queue_try_push(PipeQueue *q, const PipeItem *item) {
+    pthread_mutex_lock(&q->lock);
+    if (q->count == q->cap) {
+        pthread_mutex_unlock(&q->lock);
+        return 0;
+    }
+    q->items[(q->head + q->count) % q->cap] = *item;
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+    return 1;
+}
+
+// Take the oldest item; returns 0 once the queue is closed and empty
+static int queue_pop(PipeQueue *q, PipeItem *item) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed)
+        pthread_cond_wait(&q->not_empty, &q->lock);
+    if (q->count == 0) {
+        pthread_mutex_unlock(&q->lock);
+        return 0;
+    }
+    *item = q->items[q->head];
+    q->head = (q->head + 1) % q->cap;
+    q->count--;
+    pthread_cond_signal(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+    return 1;
+}
+
+static void queue_close(PipeQueue *q) {
+    pthread_mutex_lock(&q->lock);
+    q->closed = 1;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static void *stage_thread(void *arg) {
+    Stage *st = (Stage*)arg;
+    PipeItem item;
+
+    while (queue_pop(&st->in, &item)) {
+        char value[PIPE_VALUE_MAX] = "";
+        double start = now_ms();
+        int found = st->def.run(&item, value, sizeof(value)) && value[0] != '\0';
+        double ms = now_ms() - start;
+
+        if (found) {
+            size_t room = PIPE_ENRICH_MAX - item.enrich_len;
+            int n = snprintf(item.enrich + item.enrich_len, room, "%s%s=%s",
+                             item.enrich_len > 0 ? "; " : "", st->def.name, value);
+            if (n > 0)
+                item.enrich_len += (size_t)n < room ? (size_t)n : room - 1;
+        }
+
+        pthread_mutex_lock(&st->in.lock);
+        st->processed++;
+        st->found += found;
+        st->busy_ms += ms;
+        pthread_mutex_unlock(&st->in.lock);
+
+        // Blocking here is the backpressure on this stage
+        if (st->next != NULL) {
+            queue_push(&st->next->in, &item);
+        } else {
+            SINK(&item);
+            banner_release(&item);
+        }
+    }
+    return NULL;
+}
+
+int pipe_add_stage(const PipeStageDef *def, int threads, int queue) {
+    if (NUM_STAGES == PIPE_MAX_STAGES) {
+        printf("Enrichment: at most %d stages.\n", PIPE_MAX_STAGES);
+        return -1;
+    }
+    Stage *st = &STAGES[NUM_STAGES];
+    memset(st, 0, sizeof(*st));
+    st->def = *def;
+    st->def.threads = threads > 0 ? threads : def->threads;
+    st->def.queue = queue > 0 ? queue : def->queue;
+    NUM_STAGES++;
+    return 0;
+}
+
+int pipe_stages(void) {
+    return NUM_STAGES;
+}
+
+int pipe_start(PipeSink sink) {
+    SINK = sink;
+    SKIPPED = 0;
+    NO_BANNER = 0;
+    PEAK_BANNERS = 0;
+    if (NUM_STAGES == 0)
+        return 0;
+
+    // At most one buffer per item that can be in flight (a full queue and
+    // a busy thread at every stage), and no more than PIPE_BANNER_CAP:
+    // buffers are only allocated as bannered results come in
+    MAX_BANNERS = 0;
+    for (int i = 0; i < NUM_STAGES; i++)
+        MAX_BANNERS += STAGES[i].def.queue + STAGES[i].def.threads;
+    if (MAX_BANNERS > PIPE_BANNER_CAP)
+        MAX_BANNERS = PIPE_BANNER_CAP;
+    NUM_BANNERS = NUM_FREE = 0;
+    FREE_BANNERS = malloc((size_t)MAX_BANNERS * sizeof(char*));
+    if (FREE_BANNERS == NULL) {
+        printf("Enrichment: out of memory for banner buffers.\n");
+        return -1;
+    }
+
+    for (int i = 0; i < NUM_STAGES; i++) {
+        Stage *st = &STAGES[i];
+        st->next = i + 1 < NUM_STAGES ? &STAGES[i + 1] : NULL;
+        st->in.cap = st->def.queue;
+        st->in.items = malloc((size_t)st->in.cap * sizeof(PipeItem));
+        st->threads = malloc((size_t)st->def.threads * sizeof(pthread_t));
+        if (st->in.items == NULL || st->threads == NULL) {
+            printf("Enrichment: out of memory for stage %s.\n", st->def.name);
+            for (int j = 0; j <= i; j++) {
+                if (j < i) {
+                    pthread_mutex_destroy(&STAGES[j].in.lock);
+                    pthread_cond_destroy(&STAGES[j].in.not_empty);
+                    pthread_cond_destroy(&STAGES[j].in.not_full);
+                }
+                free(STAGES[j].in.items);
+                free(STAGES[j].threads);
+            }
+            banner_free_all();
+            return -1;
+        }
+        pthread_mutex_init(&st->in.lock, NULL);
+        pthread_cond_init(&st->in.not_empty, NULL);
+        pthread_cond_init(&st->in.not_full, NULL);
+    }
+
+    for (int i = 0; i < NUM_STAGES; i++)
+        for (int t = 0; t < STAGES[i].def.threads; t++)
+            pthread_create(&STAGES[i].threads[t], NULL, stage_thread, &STAGES[i]);
+    RUNNING = NUM_STAGES > 0;
+    return 0;
+}
+
+void pipe_item_init(PipeItem *item, const unsigned char addr[16], unsigned int scope_id,
+                    const char *ip, int port, int thread_id, const char *banner,
+                    int banner_len, const char *probe, const ConnInfo *conn) {
+    memcpy(item->addr, addr, 16);
+    item->scope_id = scope_id;
+    snprintf(item->ip, sizeof(item->ip), "%s", ip);
+    item->port = port;
+    item->thread_id = thread_id;
+    item->banner = banner;
+    item->banner_len = banner_len < PIPE_BANNER_MAX ? banner_len : PIPE_BANNER_MAX;
+    snprintf(item->probe, sizeof(item->probe), "%s", probe);
+    item->have_conn = conn != NULL;
+    if (conn != NULL)
+        item->conn = *conn;
+    item->enrich[0] = '\0';
+    item->enrich_len = 0;
+}
+
+int pipe_submit(const PipeItem *item) {
+    if (!RUNNING)
+        return 0;
+
+    // A buffer only for banners that have bytes
+    PipeItem queued = *item;
+    if (item->banner_len > 0) {
+        char *buf = banner_take();
+        if (buf == NULL)
+            return 0;
+        memcpy(buf, item->banner, (size_t)item->banner_len);
+        queued.banner = buf;
+    }
+    if (queue_try_push(&STAGES[0].in, &queued))
+        return 1;
+    banner_release(&queued);
+
+    pthread_mutex_lock(&STAGES[0].in.lock);
+    SKIPPED++;
+    pthread_mutex_unlock(&STAGES[0].in.lock);
+    return 0;
+}
+
+void pipe_finish(void) {
+    if (!RUNNING)
+        return;
+
+    // Stages drain in order: once a stage's threads are done, nothing more
+    // can reach the next one
+    for (int i = 0; i < NUM_STAGES; i++) {
+        Stage *st = &STAGES[i];
+        queue_close(&st->in);
+        for (int t = 0; t < st->def.threads; t++)
+            pthread_join(st->threads[t], NULL);
+    }
+    RUNNING = 0;
+
+    for (int i = 0; i < NUM_STAGES; i++) {
+        Stage *st = &STAGES[i];
+        pthread_mutex_destroy(&st->in.lock);
+        pthread_cond_destroy(&st->in.not_empty);
+        pthread_cond_destroy(&st->in.not_full);
+        free(st->in.items);
+        free(st->threads);
+        st->in.items = NULL;
+        st->threads = NULL;
+    }
+    banner_free_all();
+}
+
+void pipe_report(void) {
+    for (int i = 0; i < NUM_STAGES; i++) {
+        Stage *st = &STAGES[i];
+        printf("Enrichment: %-6s %lld results, %lld with a value, %.2f ms avg (%d threads, queue %d)\n",
+               st->def.name, st->processed, st->found,
+               st->processed > 0 ? st->busy_ms / (double)st->processed : 0.0,
+               st->def.threads, st->in.cap);
+    }
+    if (SKIPPED > 0)
+        printf("Enrichment: %lld results printed unenriched (first stage queue full)\n", SKIPPED);
+    if (NUM_STAGES > 0)
+        printf("Enrichment: banner buffers: peak %d in use (at most %d), %lld results printed "
+               "unenriched (no free buffer)\n", PEAK_BANNERS, MAX_BANNERS, NO_BANNER);
+}
@@ -0,0 +1,96 @@
+/*
+ * Enrichment pipeline (--enrich)
+ * Description:
+ *     Open ports can be enriched further (reverse DNS, TLS parameters, ...)
+ *     after the scan worker has moved on. Each enrichment is a stage with
+ *     its own thread pool and a bounded input queue; results flow through
+ *     the stages in the order given and then to a sink that prints them.
+ *
+ *         worker --try--> [queue] stage 1 --> [queue] stage 2 --> sink
+ *
+ *     Between stages a full queue blocks the stage in front of it
+ *     (backpressure), so a slow stage slows only the stages before it.
+ *     Scan workers never wait: if the first queue is full the result is
+ *     printed right away, unenriched, and counted.
+ *
+ *     Stages append "name=value" to the result's enrich text, shown by the
+ *     {enrich} format field.
+ *
+ *     Most open ports never send a banner, so items don't carry banner
+ *     space of their own. A banner is copied into a buffer from a shared
+ *     pool when the result is submitted, only if it has any bytes, and the
+ *     buffer goes back to the pool once the sink has printed the result.
+ *     Buffers are allocated only as bannered results arrive, up to
+ *     PIPE_BANNER_CAP (or one per queue slot and stage thread, if that is
+ *     fewer); with every one in use the result is printed right away, as
+ *     for a full queue.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stddef.h>
+
+#include "scanner.h"
+
+#define PIPE_MAX_STAGES 8
+#define PIPE_BANNER_MAX 512
+#define PIPE_BANNER_CAP 256         // pooled banner buffers (128 KB) at most
+#define PIPE_PROBE_MAX 256
+#define PIPE_ENRICH_MAX 256
+#define PIPE_VALUE_MAX 128
+
+// An open port travelling through the pipeline
+typedef struct {
+    unsigned char addr[16];
+    unsigned int scope_id;          // link-local IPv6 interface
+    char ip[46];
+    int port;
+    int thread_id;                  // scan worker that found it
+    const char *banner;             // the caller's bytes until pipe_submit,
+    int banner_len;                 // then a pooled buffer (if banner_len > 0)
+    char probe[PIPE_PROBE_MAX];     // plugin result
+    ConnInfo conn;                  // kernel TCP metrics, if have_conn
+    int have_conn;
+    char enrich[PIPE_ENRICH_MAX];   // "name=value; name=value"
+    size_t enrich_len;
+} PipeItem;
+
+// A stage's work: write its finding for item into out (cap bytes) and
+// return 1, or return 0 if there is nothing to add
+typedef int (*PipeStageFn)(const PipeItem *item, char *out, size_t cap);
+
+typedef struct {
+    const char *name;
+    PipeStageFn run;
+    int threads;                    // default concurrency
+    int queue;                      // default input queue bound
+} PipeStageDef;
+
+// Receives every result leaving the last stage (from stage threads)
+typedef void (*PipeSink)(PipeItem *item);
+
+// Append a stage (before pipe_start). Returns 0, or -1 after printing why.
+int pipe_add_stage(const PipeStageDef *def, int threads, int queue);
+
+int pipe_stages(void);
+
+// Start every stage's threads. Returns 0, or -1 after printing why.
+int pipe_start(PipeSink sink);
+
+void pipe_item_init(PipeItem *item, const unsigned char addr[16], unsigned int scope_id,
+                    const char *ip, int port, int thread_id, const char *banner,
+                    int banner_len, const char *probe, const ConnInfo *conn);
+
+// Hand an item to the first stage without waiting. Returns 1 if queued,
+// 0 if the pipeline isn't running or the first queue is full.
+int pipe_submit(const PipeItem *item);
+
+// Run everything queued through to the sink and stop the stages. No-op if
+// the pipeline isn't running.
+void pipe_finish(void);
+
+// Per-stage counts and banner pool use from the last run (after pipe_finish)
+void pipe_report(void);
+
+#endif
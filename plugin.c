@@ -0,0 +1,184 @@
+/*
+ * Probe plugin host (see plugin.h)
+ */
+
+#include <windows.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "plugin.h"
+
+// Whether a plugin's descriptor is large enough to contain field; fields
+// after the ABI 1 set are optional and read only when present
+#define PLUGIN_HAS(p, field) \
+    ((p)->struct_size >= offsetof(PsPlugin, field) + sizeof((p)->field))
+
+int plugin_add(PluginSet *set, const PsPlugin *p, void *module) {
+    if (set->count >= MAX_PLUGINS) {
+        printf("Plugin %s: at most %d plugins can be loaded.\n",
+               p->name ? p->name : "unnamed", MAX_PLUGINS);
+        return -1;
+    }
+    set->plugins[set->count] = p;
+    set->modules[set->count] = module;
+    set->count++;
+    return 0;
+}
+
+int plugin_load(PluginSet *set, const char *path) {
+    if (set->count >= MAX_PLUGINS) {
+        printf("Plugin %s: at most %d plugins can be loaded.\n", path, MAX_PLUGINS);
+        return -1;
+    }
+
+    HMODULE module = LoadLibraryA(path);
+    if (module == NULL) {
+        printf("Plugin %s: could not load library.\n", path);
+        return -1;
+    }
+
+    PsPluginEntry entry = (PsPluginEntry)(void*)GetProcAddress(module, "ps_plugin_entry");
+    const PsPlugin *p = entry ? entry(PS_PLUGIN_ABI_VERSION) : NULL;
+
+    const char *why = NULL;
+    if (entry == NULL)
+        why = "no ps_plugin_entry export";
+    else if (p == NULL)
+        why = "plugin declined this scanner version";
+    else if (p->abi_version != PS_PLUGIN_ABI_VERSION)
+        why = "built against a different plugin ABI";
+    else if (!PLUGIN_HAS(p, end))
+        why = "descriptor too small for this ABI";
+    else if (p->match_ports == NULL || p->begin == NULL || p->step == NULL)
+        why = "missing required callbacks";
+    else if (p->state_size > PLUGIN_MAX_STATE)
+        why = "per-probe state too large";
+    if (why != NULL) {
+        printf("Plugin %s: %s.\n", path, why);
+        FreeLibrary(module);
+        return -1;
+    }
+
+    if (plugin_add(set, p, module) != 0) {
+        FreeLibrary(module);
+        return -1;
+    }
+    printf("Loaded plugin %s (%s)\n", p->name ? p->name : "unnamed", path);
+    return 0;
+}
+
+int plugin_match(PluginSet *set, int start_port, int num_ports) {
+    if (set->count == 0)
+        return 0;
+
+    uint16_t *ports = malloc(num_ports * sizeof(uint16_t));
+    uint8_t *match = malloc(num_ports);
+    set->port_plugin = calloc(num_ports, 1);
+    if (ports == NULL || match == NULL || set->port_plugin == NULL) {
+        printf("Plugins: out of memory.\n");
+        free(ports);
+        free(match);
+        free(set->port_plugin);
+        set->port_plugin = NULL;
+        return -1;
+    }
+    set->start_port = start_port;
+    set->num_ports = num_ports;
+
+    for (int i = 0; i < num_ports; i++)
+        ports[i] = (uint16_t)(start_port + i);
+
+    // Last plugin first, so earlier plugins overwrite and win shared ports
+    for (int k = set->count - 1; k >= 0; k--) {
+        memset(match, 0, num_ports);
+        set->plugins[k]->match_ports(ports, match, (uint32_t)num_ports);
+        for (int i = 0; i < num_ports; i++)
+            if (match[i])
+                set->port_plugin[i] = (unsigned char)(k + 1);
+    }
+
+    free(ports);
+    free(match);
+    return 0;
+}
+
+int plugin_run(const PsPlugin *p, SOCKET s, const PsProbeTarget *target,
+               char *result, int result_cap) {
+    unsigned char buf[PLUGIN_IO_BUF];
+    void *state = NULL;
+
+    result[0] = '\0';
+    if (p->state_size > 0) {
+        state = calloc(1, p->state_size);
+        if (state == NULL)
+            return -1;
+    }
+
+    PsProbeIO io = {0};
+    io.buf = buf;
+    io.cap = sizeof(buf);
+    io.result = result;
+    io.result_cap = result_cap;
+
+    int action = p->begin(state, target, &io);
+    int steps = 0;
+    while (action != PS_PROBE_DONE && steps++ < PLUGIN_MAX_STEPS) {
+        // The I/O is always on buf: bytes a plugin points io.buf at are
+        // copied in, and io.cap can only lower the receive size
+        if (action == PS_PROBE_SEND) {
+            int len = io.len < 0 ? 0 : (io.len > (int)sizeof(buf) ? (int)sizeof(buf) : io.len);
+            if (io.buf == NULL && len > 0)
+                break;  // nothing to send: treat as a broken plugin
+            if (io.buf != buf)
+                memcpy(buf, io.buf, (size_t)len);
+            int sent = 0;
+            while (sent < len) {
+                int n = send(s, (const char*)buf + sent, len - sent, 0);
+                if (n <= 0)
+                    break;
+                sent += n;
+            }
+            io.event = sent == len ? PS_EVENT_SENT : PS_EVENT_ERROR;
+            io.len = 0;
+        } else if (action == PS_PROBE_RECV) {
+            int cap = io.cap < (int)sizeof(buf) ? io.cap : (int)sizeof(buf);
+            if (cap <= 0)
+                break;  // no room to receive: treat as a broken plugin
+            int n = recv(s, (char*)buf, cap, 0);
+            if (n > 0) {
+                io.event = PS_EVENT_DATA;
+                io.len = n;
+            } else {
+                io.event = n == 0 ? PS_EVENT_CLOSED :
+                           WSAGetLastError() == WSAETIMEDOUT ? PS_EVENT_TIMEOUT : PS_EVENT_ERROR;
+                io.len = 0;
+            }
+        } else {
+            break;  // unknown action: treat as a broken plugin
+        }
+        io.buf = buf;
+        io.cap = sizeof(buf);
+        action = p->step(state, &io);
+    }
+
+    // Plugins may not terminate the result; make sure it is a C string
+    result[result_cap - 1] = '\0';
+
+    if (p->end != NULL)
+        p->end(state);
+    free(state);
+    return action == PS_PROBE_DONE ? 0 : -1;
+}
+
+void plugin_unload_all(PluginSet *set) {
+    for (int i = 0; i < set->count; i++) {
+        if (PLUGIN_HAS(set->plugins[i], unload) && set->plugins[i]->unload != NULL)
+            set->plugins[i]->unload();
+        if (set->modules[i] != NULL)
+            FreeLibrary((HMODULE)set->modules[i]);
+    }
+    free(set->port_plugin);
+    memset(set, 0, sizeof(*set));
+}
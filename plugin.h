@@ -0,0 +1,56 @@
+/*
+ * Probe plugin host
+ * Description:
+ *     Loads plugin DLLs (--plugin), resolves which plugin handles each port
+ *     of the scan once up front, and drives a plugin's probe state machine
+ *     over a connected socket. See plugin_api.h for the plugin side.
+ */
+
+#ifndef PLUGIN_H
+#define PLUGIN_H
+
+#include "scanner.h"
+#include "plugin_api.h"
+
+#define MAX_PLUGINS 16
+
+// Upper bounds a plugin cannot exceed
+#define PLUGIN_MAX_STATE 65536
+#define PLUGIN_MAX_STEPS 64
+#define PLUGIN_IO_BUF 4096
+
+typedef struct {
+    const PsPlugin *plugins[MAX_PLUGINS];
+    void *modules[MAX_PLUGINS];     // HMODULE per plugin
+    int count;
+    unsigned char *port_plugin;     // per port of the range: plugin index + 1, 0 = none
+    int start_port;
+    int num_ports;
+} PluginSet;
+
+// Load one plugin DLL into the set. Returns 0, or -1 after printing why.
+int plugin_load(PluginSet *set, const char *path);
+
+// Add an already validated built-in plugin (module may be NULL)
+int plugin_add(PluginSet *set, const PsPlugin *p, void *module);
+
+// Build the port -> plugin table for ports start..start+num_ports-1 with
+// one match_ports() call per plugin. The first plugin loaded wins a port.
+int plugin_match(PluginSet *set, int start_port, int num_ports);
+
+// Plugin responsible for port, or NULL
+static inline const PsPlugin *plugin_for_port(const PluginSet *set, int port) {
+    if (set->port_plugin == NULL)
+        return NULL;
+    int idx = set->port_plugin[port - set->start_port];
+    return idx ? set->plugins[idx - 1] : NULL;
+}
+
+// Run p's state machine over the connected socket s. The result text
+// (possibly empty) is written to result. Returns 0 if the plugin finished.
+int plugin_run(const PsPlugin *p, SOCKET s, const PsProbeTarget *target,
+               char *result, int result_cap);
+
+void plugin_unload_all(PluginSet *set);
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * Probe plugin ABI
+ * Description:
+ *     The only header a plugin DLL needs. A plugin exports
+ *
+ *         const PsPlugin *ps_plugin_entry(uint32_t host_abi_version);
+ *
+ *     and returns a static PsPlugin describing which ports it wants and the
+ *     callbacks of its probe state machine. Callbacks never touch sockets:
+ *     each returns the next action (send these bytes / receive / done) and
+ *     the scanner performs the I/O, then calls step() with the outcome. A
+ *     plugin therefore never blocks, and the scanner is free to change how
+ *     it waits for I/O without breaking plugins.
+ *
+ *     Compatibility: PS_PLUGIN_ABI_VERSION changes only on incompatible
+ *     changes. New optional fields are appended to PsPlugin; the host reads
+ *     them only when struct_size says the plugin has them.
+ *
+ * Build a plugin:
+ *     gcc -shared my_probe.c -o my_probe.dll
+ */
+
+#ifndef PLUGIN_API_H
+#define PLUGIN_API_H
+
+#include <stdint.h>
+
+#define PS_PLUGIN_ABI_VERSION 1
+
+#ifdef _WIN32
+#define PS_PLUGIN_EXPORT __declspec(dllexport)
+#else
+#define PS_PLUGIN_EXPORT
+#endif
+
+// Next action requested by begin() / step()
+typedef enum {
+    PS_PROBE_DONE = 0,      // finished; io->result holds the outcome (may be empty)
+    PS_PROBE_SEND = 1,      // send io->buf[0..io->len) (see PsProbeIO)
+    PS_PROBE_RECV = 2       // receive up to io->cap bytes (see PsProbeIO)
+} PsProbeAction;
+
+// Outcome of the last action, passed to step()
+typedef enum {
+    PS_EVENT_SENT = 0,      // all bytes were sent
+    PS_EVENT_DATA = 1,      // io->len bytes were received into io->buf
+    PS_EVENT_CLOSED = 2,    // peer closed the connection
+    PS_EVENT_TIMEOUT = 3,   // nothing arrived within the scan timeout
+    PS_EVENT_ERROR = 4      // send/recv failed
+} PsProbeEvent;
+
+// The open port being probed
+typedef struct {
+    const char *ip;
+    uint16_t port;
+    const char *banner;     // what the service sent on connect (full mode), may be empty
+    int banner_len;
+} PsProbeTarget;
+
+// I/O buffer shared between the scanner and the plugin for one probe.
+// The buffer is the scanner's: before begin() and every step(), buf points
+// at it and cap is its size. To send, write up to cap bytes there, or point
+// buf at bytes of your own (up to cap of them are copied in). To receive,
+// cap may be lowered to bound the read; data always arrives in the
+// scanner's buffer.
+typedef struct {
+    int event;              // PsProbeEvent, valid in step()
+    unsigned char *buf;     // data to send / data received
+    int len;
+    int cap;
+    char *result;           // NUL-terminated result text, shown as {probe}
+    int result_cap;
+} PsProbeIO;
+
+typedef struct {
+    uint32_t abi_version;   // PS_PLUGIN_ABI_VERSION the plugin was built against
+    uint32_t struct_size;   // sizeof(PsPlugin) the plugin was built against
+    const char *name;
+
+    // Bytes of per-probe state the scanner allocates (zeroed) for each probe
+    uint32_t state_size;
+
+    // Mark the ports this plugin probes: match[i] = 1 for ports[i]. Called
+    // once for the whole port range at startup, not per probe.
+    void (*match_ports)(const uint16_t *ports, uint8_t *match, uint32_t n);
+
+    // Start a probe; returns a PsProbeAction
+    int (*begin)(void *state, const PsProbeTarget *target, PsProbeIO *io);
+
+    // Continue after the action completed (io->event says how)
+    int (*step)(void *state, PsProbeIO *io);
+
+    // Optional: release anything held in state (called after DONE or abort)
+    void (*end)(void *state);
+
+    // ---- ABI 1 fields above; optional fields below are appended ----
+
+    // Optional: called once before the plugin is unloaded
+    void (*unload)(void);
+} PsPlugin;
+
+typedef const PsPlugin *(*PsPluginEntry)(uint32_t host_abi_version);
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * Example probe plugin: HTTP status line
+ * Description:
+ *     Sends "HEAD / HTTP/1.0" to common web ports and reports the status
+ *     line and Server header, e.g. "HTTP/1.1 200 OK; Server: nginx".
+ *
+ * Build:
+ *     gcc -shared plugins/http_status.c -I. -o http_status.dll
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "plugin_api.h"
+
+typedef struct {
+    int phase;              // 0 = request sent, 1 = reading response
+    char head[1024];        // response headers collected so far
+    int head_len;
+} HttpState;
+
+static void match_ports(const uint16_t *ports, uint8_t *match, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        switch (ports[i]) {
+            case 80: case 8000: case 8008: case 8080: case 8088: case 8888:
+                match[i] = 1;
+                break;
+        }
+    }
+}
+
+// Copy the first line of the header block plus any Server header
+static void summarize(HttpState *st, PsProbeIO *io) {
+    st->head[st->head_len] = '\0';
+    char *eol = strpbrk(st->head, "\r\n");
+    int status_len = eol ? (int)(eol - st->head) : st->head_len;
+
+    const char *server = strstr(st->head, "\nServer:");
+    int server_len = 0;
+    if (server != NULL) {
+        server += 8;
+        while (*server == ' ')
+            server++;
+        server_len = (int)strcspn(server, "\r\n");
+    }
+
+    if (server_len > 0)
+        snprintf(io->result, io->result_cap, "%.*s; Server: %.*s",
+                 status_len, st->head, server_len, server);
+    else
+        snprintf(io->result, io->result_cap, "%.*s", status_len, st->head);
+}
+
+static int begin(void *state, const PsProbeTarget *target, PsProbeIO *io) {
+    HttpState *st = (HttpState*)state;
+    io->len = snprintf((char*)io->buf, io->cap,
+                       "HEAD / HTTP/1.0\r\nHost: %s\r\nUser-Agent: port_scanner\r\n\r\n",
+                       target->ip);
+    st->phase = 0;
+    return PS_PROBE_SEND;
+}
+
+static int step(void *state, PsProbeIO *io) {
+    HttpState *st = (HttpState*)state;
+
+    if (st->phase == 0) {
+        if (io->event != PS_EVENT_SENT)
+            return PS_PROBE_DONE;
+        st->phase = 1;
+        return PS_PROBE_RECV;
+    }
+
+    if (io->event == PS_EVENT_DATA) {
+        int room = (int)sizeof(st->head) - 1 - st->head_len;
+        int n = io->len < room ? io->len : room;
+        memcpy(st->head + st->head_len, io->buf, n);
+        st->head_len += n;
+        st->head[st->head_len] = '\0';
+
+        // Keep reading until the header block ends or the buffer is full
+        if (strstr(st->head, "\r\n\r\n") == NULL && st->head_len < (int)sizeof(st->head) - 1)
+            return PS_PROBE_RECV;
+    }
+
+    if (st->head_len > 0 && strncmp(st->head, "HTTP/", 5) == 0)
+        summarize(st, io);
+    return PS_PROBE_DONE;
+}
+
+static const PsPlugin PLUGIN = {
+    PS_PLUGIN_ABI_VERSION,
+    sizeof(PsPlugin),
+    "http-status",
+    sizeof(HttpState),
+    match_ports,
+    begin,
+    step,
+    NULL,
+    NULL
+};
+
+PS_PLUGIN_EXPORT const PsPlugin *ps_plugin_entry(uint32_t host_abi_version) {
+    return host_abi_version == PS_PLUGIN_ABI_VERSION ? &PLUGIN : NULL;
+}
@@ -6,34 +6,57 @@
  *     banner grabbing, thread identifiers, timing statistics, and file output.
  *
  * Build:
- *     gcc port_scanner.c -o port_scanner -lws2_32 -lpthread
+ *     gcc port_scanner.c history.c archive.c format.c plugin.c discover6.c gen6.c
+ *         rawscan.c console.c pipeline.c enrich.c targetset.c liveness.c pressure.c listeners.c weights.c
+ *         hostagg.c summary.c
+ *         -o port_scanner -lws2_32 -liphlpapi -lpthread
+ *
+ *     Lua scripting (--script): add -DWITH_LUA lua_engine.c -llua
+ *
+ *     Library build (no main; see portscan.h):
+ *     gcc -shared -DPORTSCAN_LIBRARY port_scanner.c history.c archive.c format.c plugin.c discover6.c
+ *         gen6.c console.c pipeline.c targetset.c liveness.c pressure.c weights.c hostagg.c summary.c
+ *         portscan.c -o portscan.dll -lws2_32 -liphlpapi -lpthread
  */
 
 // Enable newer Winsock features such as inet_pton
 #define _WIN32_WINNT 0x0601
 
-// ANSI color codes for console output (Windows 10+ / modern terminals)
-#define COLOR_GREEN  "\x1b[32m"
-#define COLOR_YELLOW "\x1b[33m"
-#define COLOR_RESET  "\x1b[0m"
-
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#include <windows.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <pthread.h>
 #include <time.h>
 #include <string.h>
 
-// Target IP shared by all threads
-static const char *TARGET_IP;
+#include "scanner.h"
+#include "history.h"
+#include "archive.h"
+#include "format.h"
+#include "plugin.h"
+#include "discover6.h"
+#include "gen6.h"
+#include "rawscan.h"
+#include "console.h"
+#include "pipeline.h"
+#include "enrich.h"
+#include "targetset.h"
+#include "liveness.h"
+#include "pressure.h"
+#include "listeners.h"
+#include "weights.h"
+#include "hostagg.h"
+#include "summary.h"
+#ifdef WITH_LUA
+#include "lua_engine.h"
+#endif
 
-// Mutex for synchronized console + file output
+// Mutex for synchronized file output (the console has its own renderer)
 pthread_mutex_t print_lock = PTHREAD_MUTEX_INITIALIZER;
 
-// Pre-parsed IPv4 address (set once in main)
-struct sockaddr_in tmp = {0};
-
 // Global output file (opened in main, written in worker threads)
 FILE *OUTPUT_FILE;
 
@@ -43,24 +66,437 @@ int FULL_MODE = 1;
 // Global timeout in milliseconds for connect()/recv()
 int TIMEOUT_MS = 200;
 
-// Thread-safe job queue of ports to scan
+// One record per host with all its open ports, instead of a line per port
+// (--by-host)
+int BY_HOST = 0;
+
+// Output line template (--format), compiled once in main
+static FormatTemplate OUTPUT_FORMAT;
+
+// Default templates, matching the classic output
+#define FORMAT_SINGLE_HOST \
+    "{color}[Thread {thread}] Port {port} OPEN{reset}{banner| - banner: }{service| (|)}{probe| [|]}{enrich| - }"
+#define FORMAT_MULTI_HOST \
+    "{color}[Thread {thread}] {ip} port {port} OPEN{reset}{banner| - banner: }{service| (|)}{probe| [|]}{enrich| - }"
+
+// Probe plugins (--plugin) and the port -> plugin table
+static PluginSet PLUGINS;
+
+// Accuracy audit (--audit p): fraction of non-open results to re-probe
+static double AUDIT_FRACTION = 0.0;
+
+// Audit re-probes use a longer timeout and fewer threads than the scan
+#define AUDIT_MIN_TIMEOUT_MS 1000
+#define AUDIT_TIMEOUT_FACTOR 4
+#define AUDIT_MAX_THREADS 16
+
+// Buckets of the original probe's duration relative to TIMEOUT_MS
+#define AUDIT_BUCKETS 4
+static const char *AUDIT_BUCKET_NAMES[AUDIT_BUCKETS] = {
+    "< 1/4 timeout", "1/4-1/2 timeout", "1/2-1x timeout", ">= timeout"
+};
+
+// Tail phase: once every job is handed out, idle workers re-send probes
+// that have gone unanswered for a share of the timeout, up to
+// TAIL_MAX_HEDGES times each, and wait TAIL_POLL_MS between looks
+#define TAIL_HEDGE_DIVISOR 3
+#define TAIL_MAX_HEDGES 2
+#define TAIL_POLL_MS 5
+
+// Once this many open ports have reported a kernel RTT, re-probes go out
+// after srtt + 4 * rttvar if that comes before the fixed share, but never
+// sooner than TAIL_MIN_HEDGE_MS (thread scheduling alone can take that long)
+#define RTT_MIN_SAMPLES 8
+#define TAIL_MIN_HEDGE_MS 10.0
+
+// A worker's probe in flight, under the queue lock
 typedef struct {
-    int *ports;             // contiguous list of port numbers
-    int size;               // total number of ports
-    int index;              // next index to hand out
-    pthread_mutex_t lock;   // protects index
+    int64_t job;            // -1 = none
+    double start;           // when the job was handed out
+    int hedges;             // re-probes sent for it so far
+    int answer;             // best answer a re-probe got, PORT_FILTERED = none
+} InFlight;
+
+// Thread-safe job queue of (host, port) probes. Jobs are numbered
+// host-major, so job order is also sorted (address, port) order; generated
+// host lists are in score order until sort_host_rows() after the scan.
+typedef struct {
+    uint32_t first_addr;    // first target address (host byte order)
+    int64_t num_hosts;      // addresses in the target range / host list
+    unsigned char (*hosts)[16]; // sorted explicit hosts (IPv6), NULL = IPv4 range
+    const TargetSet *set;   // IPv4 target ranges, NULL = num_hosts from first_addr
+    unsigned int scope_id;  // interface for link-local IPv6 hosts
+    Gen6 *gen;              // fills hosts lazily (seed targets), else NULL
+    int64_t generated;      // hosts filled in so far when gen is set
+    int start_port;         // first port of the range
+    int num_ports;          // ports per host
+    int64_t size;           // total number of jobs
+    int64_t index;          // next job to hand out
+    unsigned char *states;  // PortState per job, written by workers
+    uint16_t *elapsed_ms;   // connect duration per job (audit only), else NULL
+    InFlight *inflight;     // per worker, for the tail phase
+    int num_workers;
+    int hedge;              // re-probe stragglers in the tail (--no-hedge clears)
+    double tail_start;      // when the queue ran dry, 0 = not yet
+    int64_t tail_jobs;      // probes in flight at that point
+    double last_settle;     // when the last probe got its result
+    int64_t hedges;         // re-probes sent
+    int64_t hedge_wins;     // re-probes that answered before the original
+    int64_t recovered;      // ... where the original went unanswered
+    double srtt_ms;         // smoothed kernel RTT of open ports (RFC 6298)
+    double rttvar_ms;
+    int64_t rtt_samples;
+    WfqSched *sched;        // weighted hand-out order (--weights), NULL = job order
+    pthread_mutex_t lock;   // protects index, sched and the tail fields
 } JobQueue;
 
+static inline uint32_t job_addr(const JobQueue *q, int64_t job) {
+    if (q->set != NULL)
+        return tset_addr(q->set, job / q->num_ports);
+    return q->first_addr + (uint32_t)(job / q->num_ports);
+}
+
+static inline int job_port(const JobQueue *q, int64_t job) {
+    return q->start_port + (int)(job % q->num_ports);
+}
+
+// 16-byte address of a job's host (IPv4-mapped for IPv4 ranges)
+static inline void job_addr16(const JobQueue *q, int64_t job, unsigned char out[16]) {
+    if (q->hosts != NULL) {
+        memcpy(out, q->hosts[job / q->num_ports], 16);
+    } else {
+        struct in_addr a;
+        a.s_addr = htonl(job_addr(q, job));
+        addr_from_ipv4(out, &a);
+    }
+}
+
+// Socket address of a job; returns its length
+static inline int job_sockaddr(const JobQueue *q, int64_t job, struct sockaddr_storage *ss) {
+    unsigned char a[16];
+    job_addr16(q, job, a);
+    memset(ss, 0, sizeof(*ss));
+
+    if (addr_is_ipv4(a)) {
+        struct sockaddr_in *sin = (struct sockaddr_in*)ss;
+        sin->sin_family = AF_INET;
+        memcpy(&sin->sin_addr, a + 12, 4);
+        sin->sin_port = htons(job_port(q, job));
+        return sizeof(*sin);
+    }
+
+    struct sockaddr_in6 *sin6 = (struct sockaddr_in6*)ss;
+    sin6->sin6_family = AF_INET6;
+    memcpy(&sin6->sin6_addr, a, 16);
+    sin6->sin6_port = htons(job_port(q, job));
+    if (a[0] == 0xfe && (a[1] & 0xc0) == 0x80)
+        sin6->sin6_scope_id = q->scope_id;      // link-local needs an interface
+    return sizeof(*sin6);
+}
+
+// Sampled non-open jobs being re-probed by the audit
+typedef struct {
+    JobQueue *scan;         // results being audited
+    int64_t *jobs;          // sampled job indexes
+    int64_t size;
+    int64_t index;          // next sample to hand out
+    int timeout_ms;         // conservative timeout for re-probes
+    unsigned char *found;   // per sample: 1 if the re-probe found it open
+    pthread_mutex_t lock;   // protects index
+} AuditQueue;
+
+// What a worker thread is doing; time is charged to the current state
+typedef enum {
+    TS_QUEUE,       // waiting on / holding the job queue mutex
+    TS_CONNECT,     // socket() + blocking connect()
+    TS_RECV,        // blocking recv() for a banner
+    TS_FORMAT,      // rendering output lines
+    TS_PRINT_WAIT,  // waiting for print_lock
+    TS_OUTPUT,      // writing file output under print_lock
+    TS_PLUGIN,      // plugin probe on an open port
+    TS_THROTTLE,    // paused for connection table pressure
+    TS_TAIL,        // out of jobs, waiting for a straggler to re-probe
+    TS_OTHER,       // everything else (close, bookkeeping)
+    TS_COUNT
+} ThreadState;
+
+static const char *THREAD_STATE_NAMES[TS_COUNT] = {
+    "job queue lock", "connect", "banner recv", "formatting",
+    "print lock wait", "output write", "plugin probe", "table pressure", "tail wait",
+    "other"
+};
+
+// Per-thread counters, padded so threads never share a cache line
+typedef union {
+    struct {
+        double ms[TS_COUNT];    // accumulated time per state
+        double since;           // when the current state was entered
+        int state;              // current ThreadState
+        int64_t probes;         // jobs completed
+    } s;
+    char pad[128];
+} ThreadStats;
+
+// Charge the time since the last transition to the current state
+static inline void ts_enter(ThreadStats *st, int state) {
+    if (st == NULL)
+        return;
+    double now = now_ms();
+    st->s.ms[st->s.state] += now - st->s.since;
+    st->s.since = now;
+    st->s.state = state;
+}
+
 // Per-thread argument container
 typedef struct {
-    int id;          // thread id (0..num_threads-1)
-    JobQueue *queue; // shared job queue
+    int id;              // thread id (0..num_threads-1)
+    JobQueue *queue;     // shared job queue
+    ThreadStats *stats;  // this thread's counters, NULL unless --thread-stats
 } ThreadArgs;
 
 // Prototypes
 const char* service_name(int port);
 void *worker(void *arg);
-int get_next_port(JobQueue *q);
+void emit_result(const FmtRecord *rec, ThreadStats *st);
+void emit_host(const JobQueue *q, int64_t host, const uint16_t *ports, int n);
+void settle_host(JobQueue *q, int64_t job);
+int64_t get_next_job(JobQueue *q, int worker);
+int64_t next_hedge(JobQueue *q, int *timeout_ms);
+int settle_job(JobQueue *q, int worker, int64_t job, int hedge, int state);
+void print_tail_report(const JobQueue *q, double wall_start, double wall_end);
+void rtt_sample(JobQueue *q, uint32_t rtt_us);
+void print_rtt_report(const JobQueue *q);
+void print_thread_stats(ThreadStats *stats, int num_threads, double wall_ms);
+void print_raw_results(JobQueue *q);
+int run_audit(JobQueue *q, int num_threads);
+void *audit_worker(void *arg);
+int history_query_main(int argc, char *argv[]);
+int record_history(JobQueue *q, HistStore *store, time_t scan_time);
+int record_liveness(JobQueue *q, const char *path, time_t scan_time, int full);
+int write_archive(JobQueue *q, const char *path);
+int archive_dump_main(int argc, char *argv[]);
+int load_ipv6_targets(const char *spec, unsigned char (**hosts)[16], int64_t *count,
+                      unsigned int *scope_id);
+int sort_host_rows(JobQueue *q);
+
+#ifndef PORTSCAN_LIBRARY
+
+// Settings only main() reads; the library API takes its own arguments
+
+// Target spec (address, CIDR block or range)
+static const char *TARGET_SPEC;
+
+// Historical store prefix (--history), NULL when disabled
+static const char *HISTORY_PATH = NULL;
+
+// Delta-encoded result archive (--archive), NULL when disabled
+static const char *ARCHIVE_PATH = NULL;
+
+// Per-thread utilization report (--thread-stats)
+static int THREAD_STATS = 0;
+
+// Re-probe stragglers once the queue runs dry (--no-hedge turns it off)
+static int HEDGE = 1;
+
+// Local port budget for connection table pressure (--local-ports)
+static int LOCAL_PORTS = PRESSURE_DEFAULT_PORTS;
+
+// Liveness cache (--liveness), NULL when disabled, and how many silent
+// runs in a row get a host skipped (--dead-runs)
+static const char *LIVENESS_PATH = NULL;
+static int DEAD_RUNS = LIVE_DEFAULT_DEAD_RUNS;
+
+// Weighted target groups (--weights), NULL when disabled
+static const char *WEIGHTS_ARG = NULL;
+
+// Top-K / distinct-host summary at the end (--summary), and a live line
+// every SUMMARY_EVERY seconds while scanning (--summary-every)
+static int SUMMARY = 0;
+static int SUMMARY_EVERY = 0;
+
+// Raw packet scan mode (--ack, --sctp) and its probe rate (--rate)
+static RawProbe RAW_MODE = RAW_NONE;
+static int RAW_RATE = RAW_DEFAULT_RATE;
+
+// Read the host's own listener tables instead of probing (--local)
+static int LOCAL_MODE = 0;
+
+// --script files accepted on one command line
+#define MAX_SCRIPT_ARGS 32
+
+// --enrich stages accepted on one command line
+#define MAX_ENRICH_ARGS PIPE_MAX_STAGES
+
+// --include / --intersect / --exclude lists accepted on one command line
+#define MAX_TARGET_OPS 64
+
+typedef struct {
+    char op;                // '+' include, '&' intersect, '-' exclude
+    const char *list;       // target list or file (see targetset.h)
+} TargetOp;
+
+// Jobs handed out so far, for the console progress line
+static int64_t queue_progress(void *ctx) {
+    JobQueue *q = (JobQueue*)ctx;
+    pthread_mutex_lock(&q->lock);
+    int64_t done = q->index;
+    pthread_mutex_unlock(&q->lock);
+    return done;
+}
+
+// Pipeline sink: print a result once every enrichment stage has seen it
+static void emit_enriched(PipeItem *item) {
+    FmtRecord rec = { item->ip, item->port, service_name(item->port), item->banner,
+                      item->banner_len, item->thread_id, PORT_OPEN, item->probe,
+                      item->enrich, item->have_conn ? &item->conn : NULL };
+    emit_result(&rec, NULL);
+}
+
+// Host records still open when the workers are done (see agg_flush())
+static void flush_host(void *ctx, int64_t host, const uint16_t *ports, int n) {
+    emit_host((const JobQueue*)ctx, host, ports, n);
+}
+
+// Local mode: fill in the results from the listener table and print the
+// open ports the way a connect scan would, with the owning process as the
+// probe result. Targets that aren't this host's addresses stay filtered.
+static void local_inventory(JobQueue *q, ListenerTable *t) {
+    int64_t foreign = 0;
+    for (int64_t h = 0; h < q->num_hosts; h++) {
+        unsigned char *row = q->states + h * q->num_ports;
+        unsigned char addr[16];
+        char ip[INET6_ADDRSTRLEN];
+        job_addr16(q, h * q->num_ports, addr);
+        if (!addr_is_local(addr, q->scope_id)) {
+            memset(row, PORT_FILTERED, q->num_ports);
+            foreign++;
+            continue;
+        }
+        addr_format(addr, ip, sizeof(ip));
+
+        for (int p = 0; p < q->num_ports; p++) {
+            int port = q->start_port + p;
+            const Listener *l = listener_find(t, addr, port);
+            row[p] = l != NULL ? PORT_OPEN : PORT_CLOSED;
+            if (l == NULL)
+                continue;
+
+            char probe[32];
+            snprintf(probe, sizeof(probe), "pid %lu", (unsigned long)l->pid);
+            PipeItem item;
+            int queued = 0;
+            if (pipe_stages() > 0) {
+                pipe_item_init(&item, addr, q->scope_id, ip, port, 0, "", 0, probe, NULL);
+                queued = pipe_submit(&item);
+            }
+            if (!queued) {
+                FmtRecord rec = { ip, port, service_name(port), "", 0, 0, PORT_OPEN, probe,
+                                  "", NULL };
+                emit_result(&rec, NULL);
+            }
+        }
+    }
+
+    pthread_mutex_lock(&q->lock);
+    q->index = q->size;
+    pthread_mutex_unlock(&q->lock);
+    if (foreign > 0)
+        printf("Local: %lld targets are not addresses of this host; left filtered.\n",
+               (long long)foreign);
+}
+
+// A target that is neither a single range nor an IPv6 host is a target
+// list: comma-separated, or a file
+static int is_target_list(const char *spec) {
+    if (strchr(spec, ',') != NULL)
+        return 1;
+    FILE *f = fopen(spec, "r");
+    if (f == NULL)
+        return 0;
+    fclose(f);
+    return 1;
+}
+
+// Combine the target (a list, or the range first/count) with every
+// --include, then every --intersect, then every --exclude, so exclusions
+// always win. Returns 0, or -1 after printing why.
+static int build_target_set(TargetSet *set, const char *list, uint32_t first, int64_t count,
+                            const TargetOp *ops, int num_ops) {
+    tset_init(set);
+    if (list != NULL) {
+        if (tset_load(set, list) != 0)
+            return -1;
+    } else if ((set->ranges = malloc(sizeof(TsRange))) == NULL) {
+        printf("Memory allocation failed.\n");
+        return -1;
+    } else {
+        set->ranges[0].lo = first;
+        set->ranges[0].hi = (uint32_t)(first + (count - 1));
+        set->count = set->cap = 1;
+    }
+
+    static const char order[] = "+&-";
+    for (int pass = 0; pass < 3; pass++) {
+        for (int i = 0; i < num_ops; i++) {
+            if (ops[i].op != order[pass])
+                continue;
+            TargetSet arg, out;
+            tset_init(&arg);
+            tset_init(&out);
+            if (tset_load(&arg, ops[i].list) != 0) {
+                tset_free(set);
+                return -1;
+            }
+            int rc = ops[i].op == '+' ? tset_union(&out, set, &arg) :
+                     ops[i].op == '&' ? tset_intersect(&out, set, &arg) :
+                                        tset_subtract(&out, set, &arg);
+            tset_free(&arg);
+            tset_free(set);
+            if (rc != 0) {
+                printf("Memory allocation failed.\n");
+                return -1;
+            }
+            *set = out;
+        }
+    }
+
+    if (tset_index(set) != 0) {
+        printf("Memory allocation failed.\n");
+        tset_free(set);
+        return -1;
+    }
+    return 0;
+}
+
+// Target hosts below an address, for splitting them into weight groups
+typedef struct {
+    uint32_t first;
+    int64_t count;
+    const TargetSet *set;   // NULL = count hosts from first
+} HostRank;
+
+static int64_t host_rank(void *ctx, uint64_t addr) {
+    const HostRank *r = (const HostRank*)ctx;
+    if (r->set != NULL)
+        return tset_rank(r->set, addr);
+    if (addr <= r->first)
+        return 0;
+    return addr - r->first < (uint64_t)r->count ? (int64_t)(addr - r->first) : r->count;
+}
+
+// Flags followed by a value argument
+static int flag_takes_value(const char *arg) {
+    static const char *flags[] = {
+        "--timeout", "--history", "--archive", "--format", "--audit", "--plugin",
+        "--script", "--budget", "--rate", "--enrich", "--include", "--intersect",
+        "--exclude", "--liveness", "--dead-runs", "--local-ports", "--weights",
+        "--summary-every"
+    };
+    for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); i++)
+        if (strcmp(arg, flags[i]) == 0)
+            return 1;
+    return 0;
+}
 
 int main(int argc, char *argv[]) {
 
@@ -71,21 +507,80 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    if (argc < 2) {
-        printf("Usage: %s <ip> [start_port end_port] <num_threads> [--fast|--full] [--timeout ms]\n", argv[0]);
+    if (argc >= 2 && strcmp(argv[1], "--history-query") == 0) {
+        int rc = history_query_main(argc, argv);
         WSACleanup();
-        return 1;
+        return rc;
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "--archive-dump") == 0) {
+        int rc = archive_dump_main(argc, argv);
+        WSACleanup();
+        return rc;
     }
 
-    TARGET_IP = argv[1];
+    // Split positional arguments from flags (and flag values)
+    char *positional[4];
+    int num_positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (flag_takes_value(argv[i])) {
+            i++;
+            continue;
+        }
+        if (strncmp(argv[i], "--", 2) == 0)
+            continue;
+        if (num_positional < 4)
+            positional[num_positional++] = argv[i];
+    }
 
-    // Convert string IP to binary and store once
-    if (inet_pton(AF_INET, TARGET_IP, &tmp.sin_addr) != 1) {
-        printf("Invalid IPv4 address: %s\n", TARGET_IP);
+    if (num_positional < 1) {
+        printf("Usage: %s <ip|cidr|ip-ip|ipv6|ff02::1%%if|@seeds> [start_port end_port] <num_threads> [--fast|--full]\n"
+               "          [--timeout ms] [--history store] [--archive file] [--format template]\n"
+               "          [--audit fraction] [--thread-stats] [--plugin dll]...\n"
+               "          [--script file.lua]... [--budget n] [--ack|--sctp]\n"
+               "          [--rate pps] [--enrich name[:threads[:queue]]]...\n"
+               "          [--include list]... [--intersect list]... [--exclude list]...\n"
+               "          [--liveness cache] [--dead-runs n] [--local-ports n] [--no-hedge] [--local]\n"
+               "          [--weights list] [--by-host] [--summary] [--summary-every s]\n"
+               "       %s --history-query <store> <ip> <port>\n"
+               "       %s --archive-dump <file> [ip [port]]\n", argv[0], argv[0], argv[0]);
         WSACleanup();
         return 1;
     }
-    tmp.sin_family = AF_INET;
+
+    TARGET_SPEC = positional[0];
+    console_init();
+
+    // Convert the target spec to an IPv4 range, or an explicit IPv6 host
+    // list (a single address, or hosts discovered on a link). "@file"
+    // generates hosts from seed addresses, and IPv4 target lists become a
+    // range set, once the flags are known.
+    uint32_t first_addr = 0;
+    int64_t num_hosts = 0;
+    unsigned char (*target_hosts)[16] = NULL;
+    unsigned int scope_id = 0;
+    const char *seed_path = TARGET_SPEC[0] == '@' ? TARGET_SPEC + 1 : NULL;
+    const char *target_list = NULL;
+    if (seed_path == NULL && parse_target(TARGET_SPEC, &first_addr, &num_hosts) != 0 &&
+        load_ipv6_targets(TARGET_SPEC, &target_hosts, &num_hosts, &scope_id) != 0) {
+        if (!is_target_list(TARGET_SPEC)) {
+            printf("Invalid target: %s\n", TARGET_SPEC);
+            WSACleanup();
+            return 1;
+        }
+        target_list = TARGET_SPEC;
+    }
+    // Discovered and generated host lists print like multi-host scans even
+    // with one host
+    unsigned int nd_if;
+    int multi_host = seed_path != NULL || target_list != NULL || num_hosts > 1 ||
+                     nd6_parse_spec(TARGET_SPEC, &nd_if);
+    if (seed_path == NULL && target_list == NULL && num_hosts == 0) {
+        printf("No hosts to scan.\n");
+        free(target_hosts);
+        WSACleanup();
+        return 0;
+    }
 
     // Defaults
     int start = 1;
@@ -93,23 +588,92 @@ int main(int argc, char *argv[]) {
     int num_threads = 50;
 
     // Optional positional arguments: start,end,threads
-    if (argc == 4) {
-        start = atoi(argv[2]);
-        end = atoi(argv[3]);
-    } else if (argc >= 5) {
-        start = atoi(argv[2]);
-        end = atoi(argv[3]);
-        num_threads = atoi(argv[4]);
+    if (num_positional >= 3) {
+        start = atoi(positional[1]);
+        end = atoi(positional[2]);
     }
+    if (num_positional >= 4)
+        num_threads = atoi(positional[3]);
+
+    const char *format_spec = NULL;
+    const char *plugin_paths[MAX_PLUGINS];
+    int num_plugin_paths = 0;
+    const char *script_paths[MAX_SCRIPT_ARGS];
+    int num_script_paths = 0;
+    const char *enrich_specs[MAX_ENRICH_ARGS];
+    int num_enrich_specs = 0;
+    TargetOp target_ops[MAX_TARGET_OPS];
+    int num_target_ops = 0;
+    int64_t budget = GEN6_DEFAULT_BUDGET;
 
     // Parse flags (can appear anywhere after argv[1])
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--fast") == 0) FULL_MODE = 0;
         if (strcmp(argv[i], "--full") == 0) FULL_MODE = 1;
+        if (strcmp(argv[i], "--thread-stats") == 0) THREAD_STATS = 1;
+        if (strcmp(argv[i], "--no-hedge") == 0) HEDGE = 0;
+        if (strcmp(argv[i], "--local") == 0) LOCAL_MODE = 1;
+        if (strcmp(argv[i], "--by-host") == 0) BY_HOST = 1;
+        if (strcmp(argv[i], "--summary") == 0) SUMMARY = 1;
+        if (strcmp(argv[i], "--ack") == 0) RAW_MODE = RAW_ACK;
+        if (strcmp(argv[i], "--sctp") == 0) RAW_MODE = RAW_SCTP_INIT;
 
         if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
             TIMEOUT_MS = atoi(argv[i + 1]);
         }
+        if (strcmp(argv[i], "--history") == 0 && i + 1 < argc) {
+            HISTORY_PATH = argv[i + 1];
+        }
+        if (strcmp(argv[i], "--archive") == 0 && i + 1 < argc) {
+            ARCHIVE_PATH = argv[i + 1];
+        }
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            format_spec = argv[i + 1];
+        }
+        if (strcmp(argv[i], "--audit") == 0 && i + 1 < argc) {
+            AUDIT_FRACTION = atof(argv[i + 1]);
+        }
+        if (strcmp(argv[i], "--plugin") == 0 && i + 1 < argc) {
+            if (num_plugin_paths < MAX_PLUGINS)
+                plugin_paths[num_plugin_paths++] = argv[i + 1];
+        }
+        if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+            if (num_script_paths < MAX_SCRIPT_ARGS)
+                script_paths[num_script_paths++] = argv[i + 1];
+        }
+        if (strcmp(argv[i], "--enrich") == 0 && i + 1 < argc) {
+            if (num_enrich_specs < MAX_ENRICH_ARGS)
+                enrich_specs[num_enrich_specs++] = argv[i + 1];
+        }
+        if ((strcmp(argv[i], "--include") == 0 || strcmp(argv[i], "--intersect") == 0 ||
+             strcmp(argv[i], "--exclude") == 0) && i + 1 < argc) {
+            if (num_target_ops < MAX_TARGET_OPS) {
+                target_ops[num_target_ops].op = strcmp(argv[i], "--include") == 0 ? '+' :
+                                                strcmp(argv[i], "--intersect") == 0 ? '&' : '-';
+                target_ops[num_target_ops++].list = argv[i + 1];
+            }
+        }
+        if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+            budget = atoll(argv[i + 1]);
+        }
+        if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            RAW_RATE = atoi(argv[i + 1]);
+        }
+        if (strcmp(argv[i], "--liveness") == 0 && i + 1 < argc) {
+            LIVENESS_PATH = argv[i + 1];
+        }
+        if (strcmp(argv[i], "--dead-runs") == 0 && i + 1 < argc) {
+            DEAD_RUNS = atoi(argv[i + 1]);
+        }
+        if (strcmp(argv[i], "--local-ports") == 0 && i + 1 < argc) {
+            LOCAL_PORTS = atoi(argv[i + 1]);
+        }
+        if (strcmp(argv[i], "--weights") == 0 && i + 1 < argc) {
+            WEIGHTS_ARG = argv[i + 1];
+        }
+        if (strcmp(argv[i], "--summary-every") == 0 && i + 1 < argc) {
+            SUMMARY_EVERY = atoi(argv[i + 1]);
+        }
     }
 
     // Basic sanity bounds
@@ -118,35 +682,378 @@ int main(int argc, char *argv[]) {
 
     if (TIMEOUT_MS < 1) TIMEOUT_MS = 1;
 
-    printf("Scanning %s (ports %d-%d) with %d threads, mode=%s, timeout=%d ms...\n",
-           TARGET_IP, start, end, num_threads,
-           FULL_MODE ? "full" : "fast", TIMEOUT_MS);
+    if (AUDIT_FRACTION < 0.0) AUDIT_FRACTION = 0.0;
+    if (AUDIT_FRACTION > 1.0) AUDIT_FRACTION = 1.0;
+
+    if (budget < 1) budget = 1;
+
+    if (RAW_RATE < 0) RAW_RATE = 0;
+
+    if (LOCAL_PORTS < 1) LOCAL_PORTS = PRESSURE_DEFAULT_PORTS;
+
+    if (DEAD_RUNS < 0) DEAD_RUNS = 0;
+    if (DEAD_RUNS > 255) DEAD_RUNS = 255;
+
+    if (SUMMARY_EVERY < 0) SUMMARY_EVERY = 0;
+    if (SUMMARY_EVERY > 0) SUMMARY = 1;
+
+    if (LIVENESS_PATH != NULL && (target_hosts != NULL || seed_path != NULL)) {
+        printf("Liveness: the cache covers IPv4 targets only; not used.\n");
+        LIVENESS_PATH = NULL;
+    }
+
+    // Raw modes build IPv4 packets and classify without connecting, so
+    // there is nothing for the audit to re-probe
+    if (RAW_MODE != RAW_NONE) {
+        if (target_hosts != NULL || seed_path != NULL) {
+            printf("--%s scans support IPv4 targets only.\n", raw_probe_name(RAW_MODE));
+            free(target_hosts);
+            WSACleanup();
+            return 1;
+        }
+        if (AUDIT_FRACTION > 0.0) {
+            printf("Audit: not available for --%s scans.\n", raw_probe_name(RAW_MODE));
+            AUDIT_FRACTION = 0.0;
+        }
+        if (num_enrich_specs > 0) {
+            printf("Enrichment: not available for --%s scans.\n", raw_probe_name(RAW_MODE));
+            num_enrich_specs = 0;
+        }
+    }
+
+    // Local mode sends nothing, so there is nothing for the audit to
+    // re-probe; generated hosts would never be this host's addresses
+    if (LOCAL_MODE) {
+        if (RAW_MODE != RAW_NONE || seed_path != NULL) {
+            printf("--local reads this host's listeners; it takes address targets only and no raw mode.\n");
+            free(target_hosts);
+            WSACleanup();
+            return 1;
+        }
+        if (AUDIT_FRACTION > 0.0) {
+            printf("Audit: not available for --local scans.\n");
+            AUDIT_FRACTION = 0.0;
+        }
+    }
+
+    // Weights order the connect probes of IPv4 targets; raw modes pace
+    // their own packets and local mode sends none
+    if (WEIGHTS_ARG != NULL && (target_hosts != NULL || seed_path != NULL ||
+                                RAW_MODE != RAW_NONE || LOCAL_MODE)) {
+        printf("Weights: connect scans of IPv4 targets only; not used.\n");
+        WEIGHTS_ARG = NULL;
+    }
+
+    // Summary sketches are fed by connect workers
+    if (SUMMARY && (RAW_MODE != RAW_NONE || LOCAL_MODE)) {
+        printf("Summary: connect scans only; not used.\n");
+        SUMMARY = SUMMARY_EVERY = 0;
+    }
+
+    // Host records are built from connect results and list ports only, so
+    // banners, probe and enrichment results would have nowhere to go
+    if (BY_HOST && (RAW_MODE != RAW_NONE || LOCAL_MODE)) {
+        printf("--by-host: connect scans only; not used.\n");
+        BY_HOST = 0;
+    }
+    if (BY_HOST) {
+        FULL_MODE = 0;
+        if (num_enrich_specs > 0 || num_plugin_paths > 0 || num_script_paths > 0) {
+            printf("--by-host: records list open ports only; --enrich, --plugin and --script not used.\n");
+            num_enrich_specs = num_plugin_paths = num_script_paths = 0;
+        }
+    }
+
+    if (start < 1) start = 1;
+    if (end > 65535) end = 65535;
+    if (end < start) {
+        printf("Invalid port range: %d-%d\n", start, end);
+        free(target_hosts);
+        WSACleanup();
+        return 1;
+    }
+
+    WfqSched sched;
+    memset(&sched, 0, sizeof(sched));
+    if (WEIGHTS_ARG != NULL && wfq_parse(&sched, WEIGHTS_ARG) != 0) {
+        free(target_hosts);
+        WSACleanup();
+        return 1;
+    }
+
+    // Target lists and --include/--intersect/--exclude: a deduplicated range
+    // set, less hosts the liveness cache knows to be dead. A set that comes
+    // down to one range is scanned as a plain range.
+    TargetSet targets;
+    tset_init(&targets);
+    int live_full = 0;
+    if (target_list != NULL || num_target_ops > 0 || LIVENESS_PATH != NULL) {
+        if (target_hosts != NULL || seed_path != NULL) {
+            printf("Target lists support IPv4 targets only.\n");
+            free(target_hosts);
+            WSACleanup();
+            return 1;
+        }
+        if (build_target_set(&targets, target_list, first_addr, num_hosts,
+                             target_ops, num_target_ops) != 0) {
+            WSACleanup();
+            return 1;
+        }
+        if (target_list != NULL || num_target_ops > 0)
+            printf("Target set: %lld hosts in %lld ranges\n",
+                   (long long)targets.total, (long long)targets.count);
+
+        if (LIVENESS_PATH != NULL) {
+            TargetSet dead, alive;
+            tset_init(&alive);
+            if (live_dead_hosts(LIVENESS_PATH, &targets, DEAD_RUNS, &dead, &live_full) != 0) {
+                tset_free(&targets);
+                WSACleanup();
+                return 1;
+            }
+            if (tset_subtract(&alive, &targets, &dead) != 0 || tset_index(&alive) != 0) {
+                printf("Memory allocation failed.\n");
+                tset_free(&dead);
+                tset_free(&alive);
+                tset_free(&targets);
+                WSACleanup();
+                return 1;
+            }
+            if (live_full)
+                printf("Liveness: full re-validation run, probing every host\n");
+            else
+                printf("Liveness: skipping %lld hosts silent for %d+ runs\n",
+                       (long long)(targets.total - alive.total), DEAD_RUNS);
+            tset_free(&dead);
+            tset_free(&targets);
+            targets = alive;
+        }
+
+        if (targets.count == 0) {
+            printf("No hosts to scan.\n");
+            // Still a run, so re-validation comes around
+            if (LIVENESS_PATH != NULL)
+                live_record(LIVENESS_PATH, NULL, NULL, 0, time(NULL), live_full);
+            tset_free(&targets);
+            WSACleanup();
+            return 0;
+        }
+        first_addr = targets.ranges[0].lo;
+        num_hosts = targets.total;
+        multi_host = multi_host || num_hosts > 1;
+        if (targets.count == 1)
+            tset_free(&targets);
+    }
+
+    // Split the targets by weight block, most specific block first
+    if (WEIGHTS_ARG != NULL) {
+        HostRank rank = { first_addr, num_hosts, targets.count > 0 ? &targets : NULL };
+        if (wfq_build(&sched, num_hosts, end - start + 1, host_rank, &rank) != 0) {
+            free(target_hosts);
+            tset_free(&targets);
+            WSACleanup();
+            return 1;
+        }
+        printf("Weights: %d target groups\n", sched.num_groups);
+    }
+
+    if (format_spec == NULL)
+        format_spec = multi_host ? FORMAT_MULTI_HOST : FORMAT_SINGLE_HOST;
+
+    char format_err[128];
+    if (fmt_compile(&OUTPUT_FORMAT, format_spec, format_err, sizeof(format_err)) != 0) {
+        printf("Invalid --format template: %s\n", format_err);
+        free(target_hosts);
+        tset_free(&targets);
+        wfq_free(&sched);
+        WSACleanup();
+        return 1;
+    }
+
+    // Load plugins and decide once which one (if any) probes each port
+    for (int i = 0; i < num_plugin_paths; i++) {
+        if (plugin_load(&PLUGINS, plugin_paths[i]) != 0) {
+            plugin_unload_all(&PLUGINS);
+            fmt_free(&OUTPUT_FORMAT);
+            free(target_hosts);
+            tset_free(&targets);
+            wfq_free(&sched);
+            WSACleanup();
+            return 1;
+        }
+    }
+
+    // Lua scripts run as one more (built-in) plugin
+    if (num_script_paths > 0) {
+#ifdef WITH_LUA
+        const PsPlugin *lua = lua_engine_init(script_paths, num_script_paths);
+        if (lua == NULL || plugin_add(&PLUGINS, lua, NULL) != 0) {
+            if (lua != NULL)
+                lua->unload();
+            plugin_unload_all(&PLUGINS);
+            fmt_free(&OUTPUT_FORMAT);
+            free(target_hosts);
+            tset_free(&targets);
+            wfq_free(&sched);
+            WSACleanup();
+            return 1;
+        }
+#else
+        (void)script_paths;
+        printf("--script needs a build with -DWITH_LUA (see README).\n");
+        plugin_unload_all(&PLUGINS);
+        fmt_free(&OUTPUT_FORMAT);
+        free(target_hosts);
+        tset_free(&targets);
+        wfq_free(&sched);
+        WSACleanup();
+        return 1;
+#endif
+    }
+
+    if (plugin_match(&PLUGINS, start, end - start + 1) != 0) {
+        plugin_unload_all(&PLUGINS);
+        fmt_free(&OUTPUT_FORMAT);
+        free(target_hosts);
+        tset_free(&targets);
+        wfq_free(&sched);
+        WSACleanup();
+        return 1;
+    }
+
+    // Enrichment stages run in the order given
+    for (int i = 0; i < num_enrich_specs; i++) {
+        if (enrich_add(enrich_specs[i]) != 0) {
+            plugin_unload_all(&PLUGINS);
+            fmt_free(&OUTPUT_FORMAT);
+            free(target_hosts);
+            tset_free(&targets);
+            wfq_free(&sched);
+            WSACleanup();
+            return 1;
+        }
+    }
+
+    // Open the history store up front; compaction of older segments runs
+    // in the background while we scan
+    HistStore history;
+    if (HISTORY_PATH != NULL) {
+        if (hist_open(&history, HISTORY_PATH) != 0) {
+            plugin_unload_all(&PLUGINS);
+            fmt_free(&OUTPUT_FORMAT);
+            free(target_hosts);
+            tset_free(&targets);
+            wfq_free(&sched);
+            WSACleanup();
+            return 1;
+        }
+        hist_start_compaction(&history, HIST_COMPACT_SEGMENTS);
+    }
+    time_t scan_time = time(NULL);
+
+    // Seed targets: room for the whole budget, filled as workers ask
+    Gen6 *gen = NULL;
+    if (seed_path != NULL) {
+        gen = gen6_open(seed_path);
+        if (gen != NULL) {
+            gen6_report(gen);
+            target_hosts = malloc((size_t)budget * 16);
+            if (target_hosts == NULL)
+                printf("Memory allocation failed.\n");
+        }
+        if (target_hosts == NULL) {
+            gen6_free(gen);
+            if (HISTORY_PATH != NULL) hist_close(&history);
+            plugin_unload_all(&PLUGINS);
+            fmt_free(&OUTPUT_FORMAT);
+            WSACleanup();
+            return 1;
+        }
+        num_hosts = budget;
+    }
+
+    const char *mode = RAW_MODE != RAW_NONE ? raw_probe_name(RAW_MODE) :
+                       LOCAL_MODE ? "local" : FULL_MODE ? "full" : "fast";
+    if (gen != NULL)
+        printf("Scanning up to %lld hosts generated from %s (ports %d-%d) with %d threads, mode=%s, timeout=%d ms...\n",
+               (long long)num_hosts, seed_path, start, end, num_threads,
+               mode, TIMEOUT_MS);
+    else if (multi_host)
+        printf("Scanning %s (%lld hosts, ports %d-%d) with %d threads, mode=%s, timeout=%d ms...\n",
+               TARGET_SPEC, (long long)num_hosts, start, end, num_threads,
+               mode, TIMEOUT_MS);
+    else
+        printf("Scanning %s (ports %d-%d) with %d threads, mode=%s, timeout=%d ms...\n",
+               TARGET_SPEC, start, end, num_threads,
+               mode, TIMEOUT_MS);
 
     clock_t start_time = clock();
+    double wall_start = now_ms();
 
     // Initialize job queue
     JobQueue q;
-    q.size = end - start + 1;
-    q.ports = malloc(q.size * sizeof(int));
+    q.first_addr = first_addr;
+    q.num_hosts = num_hosts;
+    q.hosts = target_hosts;
+    q.set = targets.count > 0 ? &targets : NULL;
+    q.scope_id = scope_id;
+    q.gen = gen;
+    q.generated = 0;
+    q.start_port = start;
+    q.num_ports = end - start + 1;
+    q.size = num_hosts * q.num_ports;
+    q.states = calloc((size_t)q.size, 1);
+    q.elapsed_ms = NULL;
+    if (AUDIT_FRACTION > 0.0)
+        q.elapsed_ms = calloc((size_t)q.size, sizeof(uint16_t));
     q.index = 0;
+    q.inflight = calloc(num_threads, sizeof(InFlight));
+    q.num_workers = num_threads;
+    q.hedge = HEDGE;
+    q.tail_start = 0.0;
+    q.tail_jobs = 0;
+    q.last_settle = 0.0;
+    q.hedges = q.hedge_wins = q.recovered = 0;
+    q.srtt_ms = q.rttvar_ms = 0.0;
+    q.rtt_samples = 0;
+    q.sched = WEIGHTS_ARG != NULL ? &sched : NULL;
+    for (int i = 0; q.inflight != NULL && i < num_threads; i++)
+        q.inflight[i].job = -1;
     pthread_mutex_init(&q.lock, NULL);
 
-    if (q.ports == NULL) {
+    if (q.states == NULL || q.inflight == NULL ||
+        (AUDIT_FRACTION > 0.0 && q.elapsed_ms == NULL)) {
         printf("Memory allocation failed.\n");
+        free(q.states);
+        free(q.elapsed_ms);
+        free(q.inflight);
         pthread_mutex_destroy(&q.lock);
+        if (HISTORY_PATH != NULL) hist_close(&history);
+        plugin_unload_all(&PLUGINS);
+        fmt_free(&OUTPUT_FORMAT);
+        free(target_hosts);
+        tset_free(&targets);
+        wfq_free(&sched);
+        gen6_free(gen);
         WSACleanup();
         return 1;
     }
 
-    for (int i = 0; i < q.size; i++)
-        q.ports[i] = start + i;
-
     // Open output file
     FILE *out = fopen("scan_results.txt", "w");
     if (!out) {
         printf("Could not open output file.\n");
-        free(q.ports);
+        free(q.states);
+        free(q.elapsed_ms);
+        free(q.inflight);
         pthread_mutex_destroy(&q.lock);
+        if (HISTORY_PATH != NULL) hist_close(&history);
+        plugin_unload_all(&PLUGINS);
+        fmt_free(&OUTPUT_FORMAT);
+        free(target_hosts);
+        tset_free(&targets);
+        wfq_free(&sched);
+        gen6_free(gen);
         WSACleanup();
         return 1;
     }
@@ -157,34 +1064,158 @@ int main(int argc, char *argv[]) {
     if (threads == NULL) {
         printf("Failed to allocate thread array.\n");
         fclose(out);
-        free(q.ports);
+        free(q.states);
+        free(q.elapsed_ms);
+        free(q.inflight);
         pthread_mutex_destroy(&q.lock);
+        if (HISTORY_PATH != NULL) hist_close(&history);
+        plugin_unload_all(&PLUGINS);
+        fmt_free(&OUTPUT_FORMAT);
+        free(target_hosts);
+        tset_free(&targets);
+        wfq_free(&sched);
+        gen6_free(gen);
         WSACleanup();
         return 1;
     }
 
+    // Optional per-thread accounting
+    ThreadStats *stats = NULL;
+    if (THREAD_STATS) {
+        stats = calloc(num_threads, sizeof(ThreadStats));
+        if (stats == NULL)
+            printf("Thread stats disabled: allocation failed.\n");
+        for (int i = 0; stats != NULL && i < num_threads; i++)
+            stats[i].s.state = TS_OTHER;
+    }
+
+    // Raw modes: one sender and one receiver thread instead of workers
+    if (RAW_MODE != RAW_NONE) {
+        RawScan raw = { RAW_MODE, q.first_addr, q.num_hosts, q.set, q.start_port, q.num_ports,
+                        q.states, RAW_RATE,
+                        TIMEOUT_MS > RAW_MIN_WAIT_MS ? TIMEOUT_MS : RAW_MIN_WAIT_MS };
+        if (raw_scan(&raw) != 0) {
+            free(threads);
+            free(stats);
+            fclose(out);
+            free(q.states);
+            free(q.elapsed_ms);
+            free(q.inflight);
+            pthread_mutex_destroy(&q.lock);
+            if (HISTORY_PATH != NULL) hist_close(&history);
+            plugin_unload_all(&PLUGINS);
+            fmt_free(&OUTPUT_FORMAT);
+            free(target_hosts);
+            tset_free(&targets);
+            wfq_free(&sched);
+            gen6_free(gen);
+            WSACleanup();
+            return 1;
+        }
+    }
+
+    // Local mode: the kernel's listener tables instead of probes
+    ListenerTable listeners = { NULL, 0 };
+    if (LOCAL_MODE) {
+        double read_start = now_ms();
+        if (listeners_read(&listeners) != 0) {
+            free(threads);
+            free(stats);
+            fclose(out);
+            free(q.states);
+            free(q.elapsed_ms);
+            free(q.inflight);
+            pthread_mutex_destroy(&q.lock);
+            if (HISTORY_PATH != NULL) hist_close(&history);
+            plugin_unload_all(&PLUGINS);
+            fmt_free(&OUTPUT_FORMAT);
+            free(target_hosts);
+            tset_free(&targets);
+            wfq_free(&sched);
+            gen6_free(gen);
+            WSACleanup();
+            return 1;
+        }
+        printf("Local: %lld listening sockets read in %.1f ms\n",
+               (long long)listeners.count, now_ms() - read_start);
+    }
+
+    // Open ports go through the enrichment stages (if any) on their way out
+    if (RAW_MODE == RAW_NONE && pipe_start(emit_enriched) != 0)
+        printf("Enrichment disabled; printing results directly.\n");
+
+    // Pause connects before the local port range runs out
+    if (RAW_MODE == RAW_NONE && !LOCAL_MODE)
+        pressure_start(LOCAL_PORTS);
+
+    // Host records fill in while workers run (--by-host)
+    if (BY_HOST && agg_init(q.num_ports) != 0) {
+        printf("Per-host records disabled; printing open ports as they are found.\n");
+        BY_HOST = 0;
+    }
+
+    // Summary sketches take every open port the workers find
+    if (SUMMARY && sum_init(num_threads) != 0) {
+        printf("Summary disabled.\n");
+        SUMMARY = SUMMARY_EVERY = 0;
+    }
+
+    // Open ports print through the console renderer while workers run
+    if (RAW_MODE == RAW_NONE && console_start(queue_progress, &q, q.size) != 0)
+        printf("Console renderer unavailable; printing directly.\n");
+    if (SUMMARY_EVERY > 0 && sum_start_live(SUMMARY_EVERY) != 0)
+        printf("Live summary unavailable.\n");
+
+    if (LOCAL_MODE) {
+        local_inventory(&q, &listeners);
+        listeners_free(&listeners);
+    }
+
     // Spawn worker threads; each gets its own ThreadArgs
-    for (int i = 0; i < num_threads; i++) {
+    for (int i = 0; RAW_MODE == RAW_NONE && !LOCAL_MODE && i < num_threads; i++) {
         ThreadArgs *t = malloc(sizeof(ThreadArgs));
         if (t == NULL) {
             printf("Failed to allocate thread args.\n");
             // Not cleaning up partially created threads here to keep it simple.
+            pressure_stop();
+            pipe_finish();
+            sum_stop_live();
+            console_stop();
+            sum_free();
             free(threads);
+            free(stats);
             fclose(out);
-            free(q.ports);
+            free(q.states);
+            free(q.elapsed_ms);
+            free(q.inflight);
             pthread_mutex_destroy(&q.lock);
+            if (HISTORY_PATH != NULL) hist_close(&history);
+            plugin_unload_all(&PLUGINS);
+            fmt_free(&OUTPUT_FORMAT);
+            free(target_hosts);
+            tset_free(&targets);
+            wfq_free(&sched);
+            gen6_free(gen);
             WSACleanup();
             return 1;
         }
         t->id = i;
         t->queue = &q;
+        t->stats = stats ? &stats[i] : NULL;
 
         pthread_create(&threads[i], NULL, worker, t);
     }
 
     // Wait for all threads to finish
-    for (int i = 0; i < num_threads; i++)
+    for (int i = 0; RAW_MODE == RAW_NONE && !LOCAL_MODE && i < num_threads; i++)
         pthread_join(threads[i], NULL);
+    double wall_end = now_ms();
+    if (BY_HOST)
+        agg_flush(flush_host, &q);
+    pressure_stop();
+    pipe_finish();
+    sum_stop_live();
+    console_stop();
 
     printf("Scan complete.\n");
 
@@ -193,17 +1224,64 @@ int main(int argc, char *argv[]) {
     double elapsed = (double)(end_time - start_time) / CLOCKS_PER_SEC;
     printf("Total scan time: %.2f seconds\n", elapsed);
     printf("Ports per second: %.2f\n", q.size / elapsed);
+    pipe_report();
+    pressure_report();
+    print_tail_report(&q, wall_start, wall_end);
+    print_rtt_report(&q);
+    if (q.sched != NULL)
+        wfq_report(q.sched, wall_start);
+    sum_report();
 
-    // Cleanup
+    // Later stages expect address order
+    if (gen != NULL) {
+        printf("Generated %lld candidate hosts (budget %lld)\n",
+               (long long)q.num_hosts, (long long)budget);
+        if (sort_host_rows(&q) != 0)
+            printf("Memory allocation failed; results stay in generation order.\n");
+    }
+
+    if (RAW_MODE != RAW_NONE)
+        print_raw_results(&q);
+
+    if (stats != NULL) {
+        print_thread_stats(stats, num_threads, now_ms() - wall_start);
+        free(stats);
+    }
+
+    int rc = 0;
+    if (AUDIT_FRACTION > 0.0 && run_audit(&q, num_threads) != 0)
+        rc = 1;
+    if (ARCHIVE_PATH != NULL && write_archive(&q, ARCHIVE_PATH) != 0)
+        rc = 1;
+    if (LIVENESS_PATH != NULL && record_liveness(&q, LIVENESS_PATH, scan_time, live_full) != 0)
+        rc = 1;
+    if (HISTORY_PATH != NULL) {
+        if (record_history(&q, &history, scan_time) != 0)
+            rc = 1;
+        hist_close(&history); // waits for compaction
+    }
+
+    // Cleanup
     free(threads);
     fclose(out);
-    free(q.ports);
+    free(q.states);
+    free(q.elapsed_ms);
+    free(q.inflight);
     pthread_mutex_destroy(&q.lock);
+    plugin_unload_all(&PLUGINS);
+    fmt_free(&OUTPUT_FORMAT);
+    free(target_hosts);
+    tset_free(&targets);
+    wfq_free(&sched);
+    sum_free();
+    gen6_free(gen);
     WSACleanup();
 
-    return 0;
+    return rc;
 }
 
+#endif // PORTSCAN_LIBRARY
+
 // Map common ports to human-readable service names
 const char* service_name(int port) {
     switch (port) {
@@ -231,93 +1309,1137 @@ void *worker(void *arg) {
     ThreadArgs *info = (ThreadArgs*)arg;
     int thread_id = info->id;
     JobQueue *q = info->queue;
+    ThreadStats *st = info->stats;
     free(info); // free per-thread argument struct
 
+    // Time before this thread got scheduled is reported as idle
+    if (st != NULL)
+        st->s.since = now_ms();
+
     while (1) {
-        int port = get_next_port(q);
-        if (port == -1)
+        ts_enter(st, TS_QUEUE);
+        int64_t slot = get_next_job(q, thread_id);
+
+        // Out of jobs: help with probes still in flight instead of exiting
+        int hedge = 0;
+        int timeout_ms = TIMEOUT_MS;
+        if (slot == -1) {
+            ts_enter(st, TS_TAIL);
+            slot = next_hedge(q, &timeout_ms);
+            hedge = 1;
+        }
+        ts_enter(st, TS_OTHER);
+        if (slot == -1)
             break;
+        int port = job_port(q, slot);
 
-        struct sockaddr_in target = {0};
-        target.sin_family = AF_INET;
-        target.sin_addr = *((struct in_addr*)&tmp.sin_addr);
-        target.sin_port = htons(port);
+        struct sockaddr_storage target;
+        int target_len = job_sockaddr(q, slot, &target);
 
-        SOCKET s = socket(AF_INET, SOCK_STREAM, 0);
-        if (s == INVALID_SOCKET)
-            return NULL;
+        // Probes that fail for lack of local ports are retried after a
+        // back-off rather than recorded as filtered
+        SOCKET s;
+        double probe_start;
+        int state;
+        for (int attempt = 0; ; attempt++) {
+            ts_enter(st, TS_THROTTLE);
+            pressure_wait();
+            probe_start = q->elapsed_ms ? now_ms() : 0.0;
+            ts_enter(st, TS_CONNECT);
+            state = probe_port((struct sockaddr*)&target, target_len, timeout_ms, &s);
+            ts_enter(st, TS_OTHER);
+            if (state >= 0 || attempt == PRESSURE_MAX_RETRIES)
+                break;
+            pressure_exhausted();
+        }
+        if (state < 0)
+            state = PORT_FILTERED;  // no answer could be obtained
+        if (st != NULL)
+            st->s.probes++;
+
+        if (q->elapsed_ms && !hedge) {
+            double ms = now_ms() - probe_start;
+            q->elapsed_ms[slot] = (uint16_t)(ms > 65535.0 ? 65535.0 : ms);
+        }
 
-        DWORD timeout = TIMEOUT_MS;
-        setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (char*)&timeout, sizeof(timeout));
-        setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (char*)&timeout, sizeof(timeout));
+        // The original probe and its re-probes race; only the first to find
+        // the port open reports it
+        ts_enter(st, TS_QUEUE);
+        int report = settle_job(q, thread_id, slot, hedge, state);
+        ts_enter(st, TS_OTHER);
+        if (state == PORT_OPEN && !report) {
+            closesocket(s);
+            if (BY_HOST && !hedge)
+                settle_host(q, slot);
+            continue;
+        }
 
-        int result = connect(s, (struct sockaddr*)&target, sizeof(target));
+        if (state == PORT_OPEN) {
+            // One ioctl per open port; the RTT also tunes the re-probe point
+            ConnInfo conn;
+            int have_conn = conn_info(s, &conn) == 0;
+            if (have_conn)
+                rtt_sample(q, conn.rtt_us);
 
-        if (result == 0) {
             char banner[512];
             int n = 0;
-            if (FULL_MODE)
+            if (FULL_MODE) {
+                ts_enter(st, TS_RECV);
                 n = recv(s, banner, sizeof(banner) - 1, 0);
+            }
+            ts_enter(st, TS_FORMAT);
+            if (n < 0)
+                n = 0;
 
-            const char *svc = service_name(port);
+            // Banners usually end in CRLF; keep each result on one line
+            while (n > 0 && (banner[n - 1] == '\n' || banner[n - 1] == '\r'))
+                n--;
 
-            pthread_mutex_lock(&print_lock);
+            unsigned char addr[16];
+            char ip[INET6_ADDRSTRLEN];
+            job_addr16(q, slot, addr);
+            addr_format(addr, ip, sizeof(ip));
+            sum_add(thread_id, addr, port, service_name(port), banner, n);
 
-            if (n > 0) {
-                banner[n] = '\0';
+            // The port goes into its host's record; printed alone only if
+            // that can't be allocated
+            if (BY_HOST && agg_open(slot / q->num_ports, port) == 0) {
+                closesocket(s);
+                if (!hedge)
+                    settle_host(q, slot);
+                continue;
+            }
 
-                if (svc[0] != '\0')
-                    printf(COLOR_GREEN "[Thread %d] Port %d OPEN" COLOR_RESET
-                           " - banner: %s (%s)\n", thread_id, port, banner, svc);
-                else
-                    printf(COLOR_GREEN "[Thread %d] Port %d OPEN" COLOR_RESET
-                           " - banner: %s\n", thread_id, port, banner);
+            // Plugin probe for this port, driven over the same connection
+            char probe[256] = "";
+            const PsPlugin *plugin = plugin_for_port(&PLUGINS, port);
+            if (plugin != NULL) {
+                PsProbeTarget pt = { ip, (uint16_t)port, banner, n };
+                ts_enter(st, TS_PLUGIN);
+                plugin_run(plugin, s, &pt, probe, sizeof(probe));
+                ts_enter(st, TS_FORMAT);
+            }
 
-                if (svc[0] != '\0')
-                    fprintf(OUTPUT_FILE,
-                            "[Thread %d] Port %d OPEN - banner: %s (%s)\n",
-                            thread_id, port, banner, svc);
-                else
-                    fprintf(OUTPUT_FILE,
-                            "[Thread %d] Port %d OPEN - banner: %s\n",
-                            thread_id, port, banner);
-
-            } else {
-                if (svc[0] != '\0') {
-                    printf(COLOR_GREEN "[Thread %d] Port %d OPEN (%s)" COLOR_RESET "\n",
-                           thread_id, port, svc);
-                    fprintf(OUTPUT_FILE,
-                            "[Thread %d] Port %d OPEN (%s)\n",
-                            thread_id, port, svc);
-                } else {
-                    printf(COLOR_GREEN "[Thread %d] Port %d OPEN" COLOR_RESET "\n",
-                           thread_id, port);
-                    fprintf(OUTPUT_FILE,
-                            "[Thread %d] Port %d OPEN\n",
-                            thread_id, port);
-                }
+            // With enrichment on, the last stage prints the result; if the
+            // first stage is backed up it is printed now, unenriched
+            PipeItem item;
+            int queued = 0;
+            if (pipe_stages() > 0) {
+                pipe_item_init(&item, addr, q->scope_id, ip, port, thread_id,
+                               banner, n, probe, have_conn ? &conn : NULL);
+                queued = pipe_submit(&item);
+            }
+            if (!queued) {
+                FmtRecord rec = { ip, port, service_name(port), banner, n,
+                                  thread_id, PORT_OPEN, probe, "",
+                                  have_conn ? &conn : NULL };
+                emit_result(&rec, st);
             }
+            ts_enter(st, TS_OTHER);
 
-            fflush(OUTPUT_FILE);
-            pthread_mutex_unlock(&print_lock);
+            closesocket(s);
         }
+        if (BY_HOST && !hedge)
+            settle_host(q, slot);
+    }
+
+    ts_enter(st, TS_OTHER); // close out the final interval
+    return NULL;
+}
+
+// Print one open port: the console line goes to the renderer, the file line
+// is written under print_lock. Called by workers and by the last enrichment
+// stage (st NULL).
+void emit_result(const FmtRecord *rec, ThreadStats *st) {
+    // Format outside the lock; only the file write is serialized.
+    // The console line goes to the renderer, which never blocks us.
+    char console_line[1024], file_line[1024];
+    size_t file_len = fmt_render(&OUTPUT_FORMAT, rec, 0, file_line, sizeof(file_line));
+    if (console_color())
+        console_push(console_line, fmt_render(&OUTPUT_FORMAT, rec, 1,
+                                              console_line, sizeof(console_line)));
+    else
+        console_push(file_line, file_len);
+
+    ts_enter(st, TS_PRINT_WAIT);
+    pthread_mutex_lock(&print_lock);
+    ts_enter(st, TS_OUTPUT);
+    fwrite(file_line, 1, file_len, OUTPUT_FILE);
+    fflush(OUTPUT_FILE);
+    pthread_mutex_unlock(&print_lock);
+}
+
+// Print one host's record (--by-host) like emit_result prints a port:
+// "10.0.0.5: 3 open - 22 (SSH), 80 (HTTP), 8080"
+void emit_host(const JobQueue *q, int64_t host, const uint16_t *ports, int n) {
+    unsigned char addr[16];
+    char ip[INET6_ADDRSTRLEN];
+    job_addr16(q, host * q->num_ports, addr);
+    addr_format(addr, ip, sizeof(ip));
+
+    // Worst case per port: ", 65535 (NetBIOS)"
+    size_t cap = 128 + (size_t)n * 20;
+    char *list = malloc(cap), *line = malloc(cap);
+    if (list == NULL || line == NULL) {
+        printf("Memory allocation failed.\n");
+        free(list);
+        free(line);
+        return;
+    }
+    size_t len = 0;
+    for (int i = 0; i < n; i++) {
+        const char *service = service_name(ports[i]);
+        len += sprintf(list + len, "%s%u", i > 0 ? ", " : "", (unsigned)ports[i]);
+        if (*service)
+            len += sprintf(list + len, " (%s)", service);
+    }
+
+    int color = console_color();
+    int line_len = snprintf(line, cap, "%s%s: %d open%s - %s\n", color ? COLOR_GREEN : "",
+                            ip, n, color ? COLOR_RESET : "", list);
+    console_push(line, (size_t)line_len);
+    if (color)
+        line_len = snprintf(line, cap, "%s: %d open - %s\n", ip, n, list);
+
+    pthread_mutex_lock(&print_lock);
+    fwrite(line, 1, (size_t)line_len, OUTPUT_FILE);
+    fflush(OUTPUT_FILE);
+    pthread_mutex_unlock(&print_lock);
+    free(list);
+    free(line);
+}
 
+// Count a probe's final result toward its host, printing the host's
+// record once the last one is in (--by-host)
+void settle_host(JobQueue *q, int64_t job) {
+    uint16_t *ports;
+    int64_t host = job / q->num_ports;
+    int n = agg_settle(host, &ports);
+    if (n > 0) {
+        emit_host(q, host, ports, n);
+        free(ports);
+    }
+}
+
+// Connect to target with the given timeout. Returns the PortState, or -1 if
+// the probe couldn't be sent for lack of local resources (no socket, no
+// free local port). For open ports the connected socket is left in
+// *sock and the caller closes it.
+int probe_port(const struct sockaddr *target, int target_len, int timeout_ms, SOCKET *sock) {
+    SOCKET s = socket(target->sa_family, SOCK_STREAM, 0);
+    if (s == INVALID_SOCKET)
+        return -1;
+
+    // The socket timeouts bound banner reads and plugin I/O only
+    DWORD timeout = timeout_ms;
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (char*)&timeout, sizeof(timeout));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (char*)&timeout, sizeof(timeout));
+
+    // A blocking connect() ignores them and waits out the system's SYN
+    // retries, so connect without blocking and wait timeout_ms for it
+    u_long nonblocking = 1;
+    ioctlsocket(s, FIONBIO, &nonblocking);
+    int err = 0;
+    if (connect(s, target, target_len) != 0) {
+        err = WSAGetLastError();
+        if (err == WSAEWOULDBLOCK) {
+            fd_set wr, ex;
+            FD_ZERO(&wr);
+            FD_ZERO(&ex);
+            FD_SET(s, &wr);
+            FD_SET(s, &ex);
+            struct timeval tv = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+            int len = sizeof(err);
+            if (select((int)s + 1, NULL, &wr, &ex, &tv) <= 0)
+                err = WSAETIMEDOUT;
+            else if (getsockopt(s, SOL_SOCKET, SO_ERROR, (char*)&err, &len) != 0)
+                err = WSAGetLastError();
+        }
+    }
+    if (err != 0) {
         closesocket(s);
+        if (err == WSAENOBUFS || err == WSAEADDRINUSE)
+            return -1;
+        return err == WSAECONNREFUSED ? PORT_CLOSED : PORT_FILTERED;
     }
 
-    return NULL;
+    // Banner reads and plugins block, bounded by the socket timeouts
+    nonblocking = 0;
+    ioctlsocket(s, FIONBIO, &nonblocking);
+    *sock = s;
+    return PORT_OPEN;
+}
+
+// SIO_TCP_INFO needs Windows 10 1703; older SDK headers lack it. The
+// struct mirrors TCP_INFO_v0.
+#ifndef SIO_TCP_INFO
+#define SIO_TCP_INFO _WSAIORW(IOC_VENDOR, 39)
+#endif
+
+typedef struct {
+    int State;
+    ULONG Mss;
+    ULONG64 ConnectionTimeMs;
+    BOOLEAN TimestampsEnabled;
+    ULONG RttUs;
+    ULONG MinRttUs;
+    ULONG BytesInFlight;
+    ULONG Cwnd;
+    ULONG SndWnd;
+    ULONG RcvWnd;
+    ULONG RcvBuf;
+    ULONG64 BytesOut;
+    ULONG64 BytesIn;
+    ULONG BytesReordered;
+    ULONG BytesRetrans;
+    ULONG FastRetrans;
+    ULONG DupAcksIn;
+    ULONG TimeoutEpisodes;
+    UCHAR SynRetrans;
+} TcpInfoV0;
+
+// Snapshot the kernel's view of a connected socket. Returns 0, or -1 if
+// the stack doesn't support SIO_TCP_INFO.
+int conn_info(SOCKET s, ConnInfo *out) {
+    DWORD version = 0, bytes = 0;
+    TcpInfoV0 info;
+    if (WSAIoctl(s, SIO_TCP_INFO, &version, sizeof(version), &info, sizeof(info),
+                 &bytes, NULL, NULL) != 0)
+        return -1;
+    out->rtt_us = info.RttUs;
+    out->min_rtt_us = info.MinRttUs;
+    out->mss = info.Mss;
+    out->rcv_wnd = info.RcvWnd;
+    out->syn_retrans = info.SynRetrans;
+    return 0;
+}
+
+// Monotonic wall clock in milliseconds
+double now_ms(void) {
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart * 1000.0 / (double)freq.QuadPart;
+}
+
+// printf to the console and the output file
+static void print_both(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    va_start(ap, fmt);
+    vfprintf(OUTPUT_FILE, fmt, ap);
+    va_end(ap);
+}
+
+// Raw scans report per host rather than per port: the ports that answered
+// (as ranges) and how many didn't. Hosts where nothing answered are left out.
+void print_raw_results(JobQueue *q) {
+    int64_t total[4] = {0};
+    int64_t hosts_answering = 0;
+
+    for (int64_t h = 0; h < q->num_hosts; h++) {
+        const unsigned char *row = q->states + h * q->num_ports;
+        int64_t count[4] = {0};
+        for (int p = 0; p < q->num_ports; p++)
+            count[row[p] & 3]++;
+        for (int st = 0; st < 4; st++)
+            total[st] += count[st];
+        if (count[PORT_FILTERED] == q->num_ports)
+            continue;
+        hosts_answering++;
+
+        unsigned char addr[16];
+        char ip[INET6_ADDRSTRLEN];
+        job_addr16(q, h * q->num_ports, addr);
+        addr_format(addr, ip, sizeof(ip));
+        print_both("%s", ip);
+
+        static const int listed[] = { PORT_OPEN, PORT_UNFILTERED };
+        for (int k = 0; k < 2; k++) {
+            int st = listed[k];
+            if (count[st] == 0)
+                continue;
+            print_both(" %s ", state_name(st));
+            const char *sep = "";
+            for (int p = 0; p < q->num_ports; p++) {
+                if (row[p] != st)
+                    continue;
+                int last = p;
+                while (last + 1 < q->num_ports && row[last + 1] == st)
+                    last++;
+                if (last == p)
+                    print_both("%s%d", sep, q->start_port + p);
+                else
+                    print_both("%s%d-%d", sep, q->start_port + p, q->start_port + last);
+                sep = ",";
+                p = last;
+            }
+        }
+        if (count[PORT_CLOSED] > 0)
+            print_both(" (%lld closed)", (long long)count[PORT_CLOSED]);
+        if (count[PORT_FILTERED] > 0)
+            print_both(" (%lld filtered)", (long long)count[PORT_FILTERED]);
+        print_both("\n");
+    }
+
+    printf("%lld of %lld hosts answered: %lld open, %lld unfiltered, %lld closed, %lld filtered\n",
+           (long long)hosts_answering, (long long)q->num_hosts, (long long)total[PORT_OPEN],
+           (long long)total[PORT_UNFILTERED], (long long)total[PORT_CLOSED],
+           (long long)total[PORT_FILTERED]);
 }
 
-// Get next port from the queue in a thread-safe way
-int get_next_port(JobQueue *q) {
+// Get next job index from the queue in a thread-safe way (-1 when drained),
+// and note it as the worker's probe in flight
+int64_t get_next_job(JobQueue *q, int worker) {
     pthread_mutex_lock(&q->lock);
 
+    // Generate the job's host on first use; the queue ends early if the
+    // generator runs out before the budget
+    if (q->gen != NULL && q->index < q->size && q->index / q->num_ports >= q->generated) {
+        if (gen6_next(q->gen, q->hosts[q->generated])) {
+            q->generated++;
+        } else {
+            q->num_hosts = q->generated;
+            q->size = q->generated * q->num_ports;
+        }
+    }
+
     if (q->index >= q->size) {
+        // The first worker to find it empty starts the tail phase
+        if (q->tail_start == 0.0) {
+            q->tail_start = now_ms();
+            for (int i = 0; i < q->num_workers; i++)
+                if (q->inflight[i].job >= 0)
+                    q->tail_jobs++;
+        }
         pthread_mutex_unlock(&q->lock);
         return -1;
     }
 
-    int port = q->ports[q->index++];
+    // Weighted groups take turns; job numbers are the same either way
+    int64_t job = q->sched != NULL ? wfq_next(q->sched) : q->index;
+    q->index++;
+    InFlight *f = &q->inflight[worker];
+    f->job = job;
+    f->start = now_ms();
+    f->hedges = 0;
+    f->answer = PORT_FILTERED;
+    pthread_mutex_unlock(&q->lock);
+    return job;
+}
+
+// Tail phase: pick the probe in flight that has waited longest past its
+// next hedge point (every TIMEOUT_MS / TAIL_HEDGE_DIVISOR, or the RTT-based
+// timeout estimate if that is shorter) to re-probe,
+// with *timeout_ms set to what is left of the original's timeout so a
+// re-probe never outlasts it. Waits while probes are in flight but none is
+// due; returns -1 once none are left (or hedging is off).
+int64_t next_hedge(JobQueue *q, int *timeout_ms) {
+    if (!q->hedge)
+        return -1;
+    pthread_mutex_lock(&q->lock);
+    while (1) {
+        double now = now_ms();
+        double step = (double)TIMEOUT_MS / TAIL_HEDGE_DIVISOR;
+        double estimate = q->srtt_ms + 4.0 * q->rttvar_ms;
+        if (estimate < TAIL_MIN_HEDGE_MS)
+            estimate = TAIL_MIN_HEDGE_MS;
+        if (q->rtt_samples >= RTT_MIN_SAMPLES && estimate < step)
+            step = estimate;
+        InFlight *due = NULL;
+        int busy = 0;
+        for (int i = 0; i < q->num_workers; i++) {
+            InFlight *f = &q->inflight[i];
+            if (f->job < 0)
+                continue;
+            busy = 1;
+            if (f->hedges >= TAIL_MAX_HEDGES || f->answer != PORT_FILTERED ||
+                now < f->start + step * (f->hedges + 1))
+                continue;
+            if (due == NULL || f->start < due->start)
+                due = f;
+        }
+        if (!busy)
+            break;
+
+        if (due != NULL) {
+            int64_t job = due->job;
+            double left = due->start + TIMEOUT_MS - now;
+            *timeout_ms = left < 1.0 ? 1 : (int)left;
+            due->hedges++;
+            q->hedges++;
+            pthread_mutex_unlock(&q->lock);
+            return job;
+        }
+
+        pthread_mutex_unlock(&q->lock);
+        Sleep(TAIL_POLL_MS);
+        pthread_mutex_lock(&q->lock);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return -1;
+}
+
+// Answers ranked by how much they tell: none < closed < open
+static int state_rank(int state) {
+    return state == PORT_OPEN ? 2 : state == PORT_CLOSED ? 1 : 0;
+}
+
+// Record a finished probe (hedge: a tail re-probe of someone else's job).
+// The job keeps the best answer any of its probes got. Returns 1 if this
+// probe's answer is the first of its kind, i.e. an open port to report.
+int settle_job(JobQueue *q, int worker, int64_t job, int hedge, int state) {
+    pthread_mutex_lock(&q->lock);
+
+    // The original probe's entry, while it is still running
+    InFlight *f = NULL;
+    if (!hedge) {
+        f = &q->inflight[worker];
+    } else {
+        for (int i = 0; i < q->num_workers && f == NULL; i++)
+            if (q->inflight[i].job == job)
+                f = &q->inflight[i];
+    }
+
+    int best = f != NULL ? f->answer : q->states[job];
+    int first = state_rank(state) > state_rank(best);
+    q->states[job] = (unsigned char)(first ? state : best);
+
+    if (!hedge) {
+        if (f->hedges > 0 && state == PORT_FILTERED && best != PORT_FILTERED)
+            q->recovered++;
+        f->job = -1;
+    } else if (first) {
+        q->hedge_wins++;
+        if (f != NULL)
+            f->answer = state;
+        else
+            q->recovered++;     // the original had already given up
+    }
+    q->last_settle = now_ms();
+
+    pthread_mutex_unlock(&q->lock);
+    return first;
+}
+
+// Fold an open port's kernel RTT into the scan-wide estimate (RFC 6298
+// smoothing)
+void rtt_sample(JobQueue *q, uint32_t rtt_us) {
+    double r = rtt_us / 1000.0;
+    pthread_mutex_lock(&q->lock);
+    if (q->rtt_samples == 0) {
+        q->srtt_ms = r;
+        q->rttvar_ms = r / 2.0;
+    } else {
+        double err = q->srtt_ms > r ? q->srtt_ms - r : r - q->srtt_ms;
+        q->rttvar_ms = 0.75 * q->rttvar_ms + 0.25 * err;
+        q->srtt_ms = 0.875 * q->srtt_ms + 0.125 * r;
+    }
+    q->rtt_samples++;
     pthread_mutex_unlock(&q->lock);
-    return port;
+}
+
+// RTT of the open ports' connections and the timeout it suggests
+void print_rtt_report(const JobQueue *q) {
+    if (q->rtt_samples == 0)
+        return;
+    printf("Open-port RTT: smoothed %.2f ms, variation %.2f ms over %lld connections; "
+           "timeout estimate %.2f ms (--timeout %d)\n", q->srtt_ms, q->rttvar_ms,
+           (long long)q->rtt_samples, q->srtt_ms + 4.0 * q->rttvar_ms, TIMEOUT_MS);
+}
+
+// How the end of the scan went: when the queue ran dry, how long the probes
+// still in flight then took, and what re-probing them got
+void print_tail_report(const JobQueue *q, double wall_start, double wall_end) {
+    if (q->tail_start == 0.0 || q->tail_jobs == 0)
+        return;
+    double bulk = q->tail_start - wall_start;
+    double settled = q->last_settle > q->tail_start ? q->last_settle - q->tail_start : 0.0;
+    double tail = wall_end - q->tail_start;
+    printf("Tail: queue ran dry after %.2f s (%.0f probes/s); %lld probes in flight then "
+           "took %.2f s more (%.0f%% of the scan): results in %.2f s, banners/plugins %.2f s\n",
+           bulk / 1000.0, bulk > 0.0 ? (q->size - q->tail_jobs) * 1000.0 / bulk : 0.0,
+           (long long)q->tail_jobs, tail / 1000.0,
+           wall_end > wall_start ? 100.0 * tail / (wall_end - wall_start) : 0.0,
+           settled / 1000.0, (tail - settled) / 1000.0);
+    if (q->hedges > 0)
+        printf("Tail re-probes: %lld sent, %lld answered first, %lld answers the original "
+               "probe missed\n", (long long)q->hedges, (long long)q->hedge_wins,
+               (long long)q->recovered);
+}
+
+// Parse "a.b.c.d", "a.b.c.d/nn" or "a.b.c.d-e.f.g.h" into a host range.
+// Returns 0 on success.
+int parse_target(const char *spec, uint32_t *first, int64_t *count) {
+    char buf[64];
+    struct in_addr a, b;
+
+    snprintf(buf, sizeof(buf), "%s", spec);
+    char *slash = strchr(buf, '/');
+    char *dash = strchr(buf, '-');
+
+    if (slash != NULL) {
+        *slash = '\0';
+        int bits = atoi(slash + 1);
+        if (bits < 0 || bits > 32 || inet_pton(AF_INET, buf, &a) != 1)
+            return -1;
+        uint32_t mask = bits == 0 ? 0 : 0xffffffffu << (32 - bits);
+        *first = ntohl(a.s_addr) & mask;
+        *count = (int64_t)1 << (32 - bits);
+    } else if (dash != NULL) {
+        *dash = '\0';
+        if (inet_pton(AF_INET, buf, &a) != 1 || inet_pton(AF_INET, dash + 1, &b) != 1 ||
+            ntohl(b.s_addr) < ntohl(a.s_addr))
+            return -1;
+        *first = ntohl(a.s_addr);
+        *count = (int64_t)ntohl(b.s_addr) - ntohl(a.s_addr) + 1;
+    } else {
+        if (inet_pton(AF_INET, buf, &a) != 1)
+            return -1;
+        *first = ntohl(a.s_addr);
+        *count = 1;
+    }
+    return 0;
+}
+
+// Parse an IPv6 target: "addr" or "addr%if" scans one host, "ff02::1%if"
+// scans every host discovered on that link. Returns 0 on success.
+int load_ipv6_targets(const char *spec, unsigned char (**hosts)[16], int64_t *count,
+                      unsigned int *scope_id) {
+    unsigned int if_index;
+    if (nd6_parse_spec(spec, &if_index)) {
+        size_t n;
+        printf("Discovering IPv6 hosts on interface %u...\n", if_index);
+        if (nd6_discover(if_index, ND6_WAIT_MS, hosts, &n) != 0)
+            return -1;
+        *count = (int64_t)n;
+        *scope_id = if_index;
+        return 0;
+    }
+
+    char buf[INET6_ADDRSTRLEN + 32];
+    snprintf(buf, sizeof(buf), "%s", spec);
+    char *pct = strchr(buf, '%');
+    if (pct != NULL) {
+        *pct = '\0';
+        *scope_id = nd6_interface(pct + 1);
+    }
+
+    unsigned char a[16];
+    if (inet_pton(AF_INET6, buf, a) != 1)
+        return -1;
+    *hosts = malloc(16);
+    if (*hosts == NULL)
+        return -1;
+    memcpy((*hosts)[0], a, 16);
+    *count = 1;
+    return 0;
+}
+
+typedef struct {
+    unsigned char addr[16];
+    int64_t row;
+} HostRow;
+
+static int host_row_cmp(const void *a, const void *b) {
+    return memcmp(((const HostRow*)a)->addr, ((const HostRow*)b)->addr, 16);
+}
+
+// Reorder a finished scan's host list (and each host's row of results)
+// into address order. Returns 0, or -1 if out of memory.
+int sort_host_rows(JobQueue *q) {
+    HostRow *rows = malloc((size_t)q->num_hosts * sizeof(HostRow));
+    unsigned char *states = malloc((size_t)q->size);
+    uint16_t *elapsed = q->elapsed_ms ? malloc((size_t)q->size * sizeof(uint16_t)) : NULL;
+    if (rows == NULL || states == NULL || (q->elapsed_ms && elapsed == NULL)) {
+        free(rows);
+        free(states);
+        free(elapsed);
+        return -1;
+    }
+
+    for (int64_t h = 0; h < q->num_hosts; h++) {
+        memcpy(rows[h].addr, q->hosts[h], 16);
+        rows[h].row = h;
+    }
+    qsort(rows, (size_t)q->num_hosts, sizeof(HostRow), host_row_cmp);
+
+    size_t n = (size_t)q->num_ports;
+    for (int64_t h = 0; h < q->num_hosts; h++) {
+        memcpy(q->hosts[h], rows[h].addr, 16);
+        memcpy(states + h * n, q->states + rows[h].row * n, n);
+        if (elapsed)
+            memcpy(elapsed + h * n, q->elapsed_ms + rows[h].row * n, n * sizeof(uint16_t));
+    }
+
+    free(q->states);
+    q->states = states;
+    if (elapsed) {
+        free(q->elapsed_ms);
+        q->elapsed_ms = elapsed;
+    }
+    free(rows);
+    return 0;
+}
+
+// Append this scan's per-port states to the history store
+int record_history(JobQueue *q, HistStore *store, time_t scan_time) {
+    HistRecord *recs = malloc(q->size * sizeof(HistRecord));
+    if (recs == NULL) {
+        printf("History: out of memory.\n");
+        return -1;
+    }
+
+    for (int64_t i = 0; i < q->size; i++) {
+        job_addr16(q, i, recs[i].addr);
+        recs[i].port = (uint16_t)job_port(q, i);
+        recs[i].state = q->states[i];
+        recs[i].time = (int64_t)scan_time;
+    }
+
+    int rc = hist_ingest(store, recs, (size_t)q->size);
+    free(recs);
+    if (rc == 0)
+        printf("History: recorded %lld observations in %s\n",
+               (long long)q->size, store->prefix);
+    return rc;
+}
+
+// Record which hosts answered on any port in the liveness cache. The
+// strongest answer is kept: open, then unfiltered, then closed.
+int record_liveness(JobQueue *q, const char *path, time_t scan_time, int full) {
+    static const int rank[4] = { 1, 3, 0, 2 };  // by PortState
+    uint32_t *addrs = malloc((size_t)q->num_hosts * sizeof(uint32_t));
+    unsigned char *states = malloc((size_t)q->num_hosts);
+    if (addrs == NULL || states == NULL) {
+        printf("Liveness: out of memory.\n");
+        free(addrs);
+        free(states);
+        return -1;
+    }
+
+    int64_t answered = 0;
+    for (int64_t h = 0; h < q->num_hosts; h++) {
+        const unsigned char *row = q->states + h * q->num_ports;
+        unsigned char best = PORT_FILTERED;
+        for (int p = 0; p < q->num_ports; p++)
+            if (rank[row[p]] > rank[best])
+                best = row[p];
+        addrs[h] = job_addr(q, h * q->num_ports);
+        states[h] = best;
+        answered += best != PORT_FILTERED;
+    }
+
+    int rc = live_record(path, addrs, states, q->num_hosts, scan_time, full);
+    free(addrs);
+    free(states);
+    if (rc == 0)
+        printf("Liveness: %lld of %lld hosts answered, recorded in %s\n",
+               (long long)answered, (long long)q->num_hosts, path);
+    return rc;
+}
+
+// Write every job's result to a delta-encoded archive. Jobs are numbered
+// in (address, port) order, so no sort is needed.
+int write_archive(JobQueue *q, const char *path) {
+    ArcWriter w;
+    if (arc_writer_open(&w, path) != 0)
+        return -1;
+
+    int rc = 0;
+    for (int64_t i = 0; i < q->size && rc == 0; i++) {
+        ArcRecord r;
+        job_addr16(q, i, r.addr);
+        r.port = (uint16_t)job_port(q, i);
+        r.state = q->states[i];
+        rc = arc_writer_put(&w, &r);
+    }
+
+    if (arc_writer_close(&w) != 0)
+        rc = -1;
+    if (rc != 0) {
+        printf("Archive: writing %s failed.\n", path);
+        return -1;
+    }
+
+    printf("Archive: wrote %lld results to %s\n", (long long)q->size, path);
+    return 0;
+}
+
+// --archive-dump <file> [ip [port]]: decode an archive, optionally seeking
+// to the results of one host (or one host and port)
+int archive_dump_main(int argc, char *argv[]) {
+    if (argc < 3) {
+        printf("Usage: %s --archive-dump <file> [ip [port]]\n", argv[0]);
+        return 1;
+    }
+
+    ArcReader r;
+    if (arc_reader_open(&r, argv[2]) != 0)
+        return 1;
+
+    unsigned char seek_addr[16];
+    int seek_port = 0;
+    if (argc >= 4) {
+        if (!addr_parse(argv[3], seek_addr)) {
+            printf("Invalid address: %s\n", argv[3]);
+            arc_reader_close(&r);
+            return 1;
+        }
+        if (argc >= 5)
+            seek_port = atoi(argv[4]);
+        if (arc_reader_seek(&r, seek_addr, (uint16_t)seek_port) != 0) {
+            arc_reader_close(&r);
+            return 1;
+        }
+    }
+
+    ArcRecord rec;
+    int more;
+    while ((more = arc_reader_next(&r, &rec)) == 1) {
+        // With a filter, stop once past the requested host / port
+        if (argc >= 4 && memcmp(rec.addr, seek_addr, 16) != 0)
+            break;
+        if (argc >= 5 && rec.port != seek_port)
+            break;
+
+        char ip[INET6_ADDRSTRLEN];
+        addr_format(rec.addr, ip, sizeof(ip));
+        printf("%s %u %s\n", ip, (unsigned)rec.port, state_name(rec.state));
+    }
+
+    arc_reader_close(&r);
+    return more < 0 ? 1 : 0;
+}
+
+// --history-query <store> <ip> <port>: print the state transitions of one port
+int history_query_main(int argc, char *argv[]) {
+    if (argc < 5) {
+        printf("Usage: %s --history-query <store> <ip> <port>\n", argv[0]);
+        return 1;
+    }
+
+    unsigned char addr[16];
+    if (!addr_parse(argv[3], addr)) {
+        printf("Invalid address: %s\n", argv[3]);
+        return 1;
+    }
+    int port = atoi(argv[4]);
+    if (port < 1 || port > 65535) {
+        printf("Invalid port: %s\n", argv[4]);
+        return 1;
+    }
+
+    HistStore store;
+    if (hist_open(&store, argv[2]) != 0)
+        return 1;
+
+    HistRecord *recs;
+    size_t n;
+    if (hist_query(&store, addr, (uint16_t)port, &recs, &n) != 0) {
+        hist_close(&store);
+        return 1;
+    }
+
+    printf("History of %s port %d (%zu transitions):\n", argv[3], port, n);
+    const HistRecord *first_open = NULL;
+    for (size_t i = 0; i < n; i++) {
+        char when[32];
+        time_t t = (time_t)recs[i].time;
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&t));
+        printf("  %s  %s\n", when, state_name(recs[i].state));
+        if (first_open == NULL && recs[i].state == PORT_OPEN)
+            first_open = &recs[i];
+    }
+
+    if (first_open != NULL) {
+        char when[32];
+        time_t t = (time_t)first_open->time;
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&t));
+        printf("First seen open: %s\n", when);
+    } else {
+        printf("Never seen open.\n");
+    }
+
+    free(recs);
+    hist_close(&store);
+    return 0;
+}
+
+// End-of-scan breakdown of where worker thread time went. Time a thread was
+// alive but not accounted (started late, finished early) counts as idle.
+void print_thread_stats(ThreadStats *stats, int num_threads, double wall_ms) {
+    double total[TS_COUNT] = {0};
+    double idle = 0.0;
+    int64_t probes = 0;
+    int busiest = 0, laziest = 0;
+    double busiest_ms = -1.0, laziest_ms = -1.0;
+
+    for (int i = 0; i < num_threads; i++) {
+        double busy = 0.0;
+        for (int k = 0; k < TS_COUNT; k++) {
+            total[k] += stats[i].s.ms[k];
+            busy += stats[i].s.ms[k];
+        }
+        if (busy < wall_ms)
+            idle += wall_ms - busy;
+        probes += stats[i].s.probes;
+
+        // "Busy" here means not waiting for work or for locks
+        double useful = busy - stats[i].s.ms[TS_QUEUE] - stats[i].s.ms[TS_PRINT_WAIT];
+        if (busiest_ms < 0 || useful > busiest_ms) {
+            busiest_ms = useful;
+            busiest = i;
+        }
+        if (laziest_ms < 0 || useful < laziest_ms) {
+            laziest_ms = useful;
+            laziest = i;
+        }
+    }
+
+    double thread_ms = wall_ms * num_threads;
+    if (thread_ms <= 0.0)
+        thread_ms = 1.0;
+
+    printf("Thread utilization (%d threads, %.2f s wall, %.2f thread-seconds):\n",
+           num_threads, wall_ms / 1000.0, thread_ms / 1000.0);
+    for (int k = 0; k < TS_COUNT; k++)
+        printf("  %-16s %6.2f%%  %10.2f s\n", THREAD_STATE_NAMES[k],
+               100.0 * total[k] / thread_ms, total[k] / 1000.0);
+    printf("  %-16s %6.2f%%  %10.2f s\n", "idle",
+           100.0 * idle / thread_ms, idle / 1000.0);
+
+    if (probes > 0)
+        printf("  Average per probe: connect %.2f ms, banner recv %.2f ms\n",
+               total[TS_CONNECT] / probes, total[TS_RECV] / probes);
+    printf("  Most utilized thread: %d (%.1f%%), least utilized: %d (%.1f%%)\n",
+           busiest, 100.0 * busiest_ms / (wall_ms > 0 ? wall_ms : 1.0),
+           laziest, 100.0 * laziest_ms / (wall_ms > 0 ? wall_ms : 1.0));
+}
+
+// xorshift64*: cheap sampling PRNG, seeded once per audit
+static uint64_t audit_rand(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static int audit_bucket(const JobQueue *q, int64_t job) {
+    int ms = q->elapsed_ms[job];
+    if (ms * 4 < TIMEOUT_MS) return 0;
+    if (ms * 2 < TIMEOUT_MS) return 1;
+    if (ms < TIMEOUT_MS) return 2;
+    return 3;
+}
+
+// Audit tally of one sampled /24
+typedef struct {
+    uint32_t subnet;        // address >> 8
+    int64_t sampled;
+    int64_t missed;
+} AuditSubnet;
+
+static void print_audit_row(const char *label, int64_t sampled, int64_t missed) {
+    printf("    %-20s %8lld sampled %6lld missed %6.2f%%\n", label,
+           (long long)sampled, (long long)missed,
+           sampled ? 100.0 * missed / sampled : 0.0);
+}
+
+// Re-probe a random sample of non-open results at conservative settings and
+// report the estimated false-negative rate per subnet and timeout bucket.
+// Ports found open by the audit are corrected in q->states.
+int run_audit(JobQueue *q, int num_threads) {
+    AuditQueue a;
+    memset(&a, 0, sizeof(a));
+    a.scan = q;
+    a.timeout_ms = TIMEOUT_MS * AUDIT_TIMEOUT_FACTOR;
+    if (a.timeout_ms < AUDIT_MIN_TIMEOUT_MS)
+        a.timeout_ms = AUDIT_MIN_TIMEOUT_MS;
+
+    // Draw the sample
+    uint64_t rng = (uint64_t)time(NULL) * 0x9E3779B97F4A7C15ULL | 1;
+    // 2^64 doesn't fit a uint64_t; a fraction of 1 samples everything
+    uint64_t threshold = AUDIT_FRACTION < 1.0 ?
+        (uint64_t)(AUDIT_FRACTION * 18446744073709551615.0) : UINT64_MAX;
+    int64_t non_open = 0, cap = 0;
+    for (int64_t i = 0; i < q->size; i++) {
+        if (q->states[i] == PORT_OPEN)
+            continue;
+        non_open++;
+        if (AUDIT_FRACTION < 1.0 && audit_rand(&rng) > threshold)
+            continue;
+        if (a.size == cap) {
+            cap = cap ? cap * 2 : 1024;
+            int64_t *jobs = realloc(a.jobs, cap * sizeof(int64_t));
+            if (jobs == NULL) {
+                printf("Audit: out of memory.\n");
+                free(a.jobs);
+                return -1;
+            }
+            a.jobs = jobs;
+        }
+        a.jobs[a.size++] = i;
+    }
+
+    if (a.size == 0) {
+        printf("Audit: no non-open results sampled.\n");
+        free(a.jobs);
+        return 0;
+    }
+
+    a.found = calloc((size_t)a.size, 1);
+    if (a.found == NULL) {
+        printf("Audit: out of memory.\n");
+        free(a.jobs);
+        return -1;
+    }
+    pthread_mutex_init(&a.lock, NULL);
+
+    int audit_threads = num_threads < AUDIT_MAX_THREADS ? num_threads : AUDIT_MAX_THREADS;
+    if (audit_threads > a.size)
+        audit_threads = (int)a.size;
+
+    printf("Audit: re-probing %lld of %lld non-open results with %d threads, timeout=%d ms...\n",
+           (long long)a.size, (long long)non_open, audit_threads, a.timeout_ms);
+
+    pthread_t *threads = malloc(audit_threads * sizeof(pthread_t));
+    if (threads == NULL) {
+        printf("Audit: out of memory.\n");
+        pthread_mutex_destroy(&a.lock);
+        free(a.found);
+        free(a.jobs);
+        return -1;
+    }
+    for (int i = 0; i < audit_threads; i++)
+        pthread_create(&threads[i], NULL, audit_worker, &a);
+    for (int i = 0; i < audit_threads; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+
+    // Tally per timeout bucket and per /24 (IPv4 only). Jobs are numbered
+    // in address order and the sample is drawn in job order, so each
+    // sampled /24 is one run of the sample: only those get a row, however
+    // sparse the target set.
+    int64_t bucket_sampled[AUDIT_BUCKETS] = {0}, bucket_missed[AUDIT_BUCKETS] = {0};
+    AuditSubnet *subnets = NULL;
+    int64_t num_subnets = 0;
+    if (q->hosts == NULL) {
+        subnets = malloc((size_t)a.size * sizeof(AuditSubnet));
+        if (subnets == NULL) {
+            printf("Audit: out of memory.\n");
+            pthread_mutex_destroy(&a.lock);
+            free(a.found);
+            free(a.jobs);
+            return -1;
+        }
+    }
+
+    int64_t missed = 0;
+    for (int64_t i = 0; i < a.size; i++) {
+        int64_t job = a.jobs[i];
+        int b = audit_bucket(q, job);
+        AuditSubnet *sn = NULL;
+        if (subnets != NULL) {
+            uint32_t subnet = job_addr(q, job) >> 8;
+            if (num_subnets == 0 || subnets[num_subnets - 1].subnet != subnet)
+                subnets[num_subnets++] = (AuditSubnet){ subnet, 0, 0 };
+            sn = &subnets[num_subnets - 1];
+            sn->sampled++;
+        }
+        bucket_sampled[b]++;
+        if (a.found[i]) {
+            bucket_missed[b]++;
+            if (sn != NULL)
+                sn->missed++;
+            missed++;
+        }
+    }
+
+    double rate = (double)missed / a.size;
+    printf("Audit: %lld missed open ports in sample, estimated miss rate %.2f%% "
+           "(~%.0f misses across all %lld non-open results)\n",
+           (long long)missed, 100.0 * rate, rate * non_open, (long long)non_open);
+
+    printf("  By original probe time (timeout %d ms):\n", TIMEOUT_MS);
+    for (int b = 0; b < AUDIT_BUCKETS; b++)
+        if (bucket_sampled[b] > 0)
+            print_audit_row(AUDIT_BUCKET_NAMES[b], bucket_sampled[b], bucket_missed[b]);
+
+    // Every sampled subnet for small scans; only subnets with misses otherwise
+    int verbose = num_subnets <= 16;
+    int64_t clean = 0;
+    if (q->hosts == NULL)
+        printf("  By subnet (/24):\n");
+    for (int64_t i = 0; i < num_subnets; i++) {
+        const AuditSubnet *sn = &subnets[i];
+        if (!verbose && sn->missed == 0) {
+            clean++;
+            continue;
+        }
+        struct in_addr net;
+        char label[32], ip[INET_ADDRSTRLEN];
+        net.s_addr = htonl(sn->subnet << 8);
+        inet_ntop(AF_INET, &net, ip, sizeof(ip));
+        snprintf(label, sizeof(label), "%s/24", ip);
+        print_audit_row(label, sn->sampled, sn->missed);
+    }
+    if (clean > 0)
+        printf("    %lld other sampled subnets had no misses\n", (long long)clean);
+
+    free(subnets);
+    pthread_mutex_destroy(&a.lock);
+    free(a.found);
+    free(a.jobs);
+    return 0;
+}
+
+// Audit thread: re-probes sampled jobs, retrying once before giving up
+void *audit_worker(void *arg) {
+    AuditQueue *a = (AuditQueue*)arg;
+    JobQueue *q = a->scan;
+
+    while (1) {
+        pthread_mutex_lock(&a->lock);
+        int64_t i = a->index < a->size ? a->index++ : -1;
+        pthread_mutex_unlock(&a->lock);
+        if (i == -1)
+            break;
+
+        int64_t job = a->jobs[i];
+        struct sockaddr_storage target;
+        int target_len = job_sockaddr(q, job, &target);
+
+        SOCKET s;
+        int state = PORT_FILTERED;
+        // A refusal is a definite answer; only silence (or a local failure)
+        // is worth the second try
+        for (int attempt = 0; attempt < 2 && (state == PORT_FILTERED || state < 0); attempt++)
+            state = probe_port((struct sockaddr*)&target, target_len, a->timeout_ms, &s);
+        if (state != PORT_OPEN)
+            continue;
+        closesocket(s);
+
+        a->found[i] = 1;
+        q->states[job] = PORT_OPEN;
+
+        unsigned char addr[16];
+        char ip[INET6_ADDRSTRLEN];
+        job_addr16(q, job, addr);
+        addr_format(addr, ip, sizeof(ip));
+        pthread_mutex_lock(&print_lock);
+        printf("[Audit] %s port %d OPEN (missed by main scan)\n", ip, job_port(q, job));
+        fprintf(OUTPUT_FILE, "[Audit] %s port %d OPEN (missed by main scan)\n",
+                ip, job_port(q, job));
+        fflush(OUTPUT_FILE);
+        pthread_mutex_unlock(&print_lock);
+    }
+
+    return NULL;
 }
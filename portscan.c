@@ -0,0 +1,245 @@
+/*
+ * Scanner library API (see portscan.h)
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "scanner.h"
+#include "portscan.h"
+
+struct PsScan {
+    uint32_t first_addr;
+    int start_port;
+    int num_ports;
+    int64_t size;
+    int timeout_ms;
+
+    // Result columns, one entry per job (host-major, like JobQueue)
+    uint32_t *addrs;
+    uint16_t *ports;
+    uint8_t *states;
+    uint16_t *rtt_ms;
+    uint32_t *tcp_rtt_us;   // kernel RTT of open ports, 0 = none
+
+    unsigned char *done;    // per job: result written
+    int64_t next;           // next job to hand out
+    int64_t completed;      // every job below this is done
+
+    pthread_t *threads;
+    int num_threads;
+    int running;            // workers not yet finished
+    pthread_mutex_t lock;   // protects next, done, completed, running
+    pthread_cond_t finished;
+};
+
+static void *ps_worker(void *arg) {
+    PsScan *scan = (PsScan*)arg;
+
+    while (1) {
+        pthread_mutex_lock(&scan->lock);
+        if (scan->next >= scan->size) {
+            pthread_mutex_unlock(&scan->lock);
+            break;
+        }
+        int64_t job = scan->next++;
+        pthread_mutex_unlock(&scan->lock);
+
+        struct sockaddr_in target = {0};
+        target.sin_family = AF_INET;
+        target.sin_addr.s_addr = htonl(scan->addrs[job]);
+        target.sin_port = htons(scan->ports[job]);
+
+        SOCKET s;
+        double start = now_ms();
+        int state = probe_port((struct sockaddr*)&target, sizeof(target), scan->timeout_ms, &s);
+        double ms = now_ms() - start;
+
+        // Out of sockets: no answer was obtained, which is what filtered means
+        if (state < 0)
+            state = PORT_FILTERED;
+        if (state == PORT_OPEN) {
+            ConnInfo conn;
+            if (conn_info(s, &conn) == 0)
+                scan->tcp_rtt_us[job] = conn.rtt_us;
+            closesocket(s);
+        }
+
+        scan->states[job] = (uint8_t)state;
+        scan->rtt_ms[job] = (uint16_t)(ms > 65535.0 ? 65535.0 : ms);
+
+        // Publish the result and advance the completed prefix
+        pthread_mutex_lock(&scan->lock);
+        scan->done[job] = 1;
+        while (scan->completed < scan->size && scan->done[scan->completed])
+            scan->completed++;
+        pthread_mutex_unlock(&scan->lock);
+    }
+
+    pthread_mutex_lock(&scan->lock);
+    if (--scan->running == 0)
+        pthread_cond_broadcast(&scan->finished);
+    pthread_mutex_unlock(&scan->lock);
+    return NULL;
+}
+
+static void ps_release(PsScan *scan) {
+    free(scan->addrs);
+    free(scan->ports);
+    free(scan->states);
+    free(scan->rtt_ms);
+    free(scan->tcp_rtt_us);
+    free(scan->done);
+    free(scan->threads);
+    free(scan);
+}
+
+PS_API PsScan *ps_scan_start(const char *target, int start_port, int end_port,
+                             int num_threads, int timeout_ms) {
+    uint32_t first_addr;
+    int64_t num_hosts;
+    if (target == NULL || parse_target(target, &first_addr, &num_hosts) != 0)
+        return NULL;
+
+    if (start_port < 1) start_port = 1;
+    if (end_port > 65535) end_port = 65535;
+    if (end_port < start_port)
+        return NULL;
+    if (num_threads < 1) num_threads = 1;
+    if (num_threads > 5000) num_threads = 5000;
+    if (timeout_ms < 1) timeout_ms = 1;
+
+    PsScan *scan = calloc(1, sizeof(PsScan));
+    if (scan == NULL)
+        return NULL;
+
+    scan->first_addr = first_addr;
+    scan->start_port = start_port;
+    scan->num_ports = end_port - start_port + 1;
+    scan->size = num_hosts * scan->num_ports;
+    scan->timeout_ms = timeout_ms;
+
+    size_t n = (size_t)scan->size;
+    scan->addrs = malloc(n * sizeof(uint32_t));
+    scan->ports = malloc(n * sizeof(uint16_t));
+    scan->states = calloc(n, sizeof(uint8_t));
+    scan->rtt_ms = calloc(n, sizeof(uint16_t));
+    scan->tcp_rtt_us = calloc(n, sizeof(uint32_t));
+    scan->done = calloc(n, 1);
+    scan->threads = malloc(num_threads * sizeof(pthread_t));
+    if (scan->addrs == NULL || scan->ports == NULL || scan->states == NULL ||
+        scan->rtt_ms == NULL || scan->tcp_rtt_us == NULL || scan->done == NULL ||
+        scan->threads == NULL) {
+        ps_release(scan);
+        return NULL;
+    }
+
+    for (int64_t i = 0; i < scan->size; i++) {
+        scan->addrs[i] = first_addr + (uint32_t)(i / scan->num_ports);
+        scan->ports[i] = (uint16_t)(start_port + (int)(i % scan->num_ports));
+    }
+
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2,2), &wsa) != 0) {
+        ps_release(scan);
+        return NULL;
+    }
+
+    pthread_mutex_init(&scan->lock, NULL);
+    pthread_cond_init(&scan->finished, NULL);
+
+    // running is set before any worker can decrement it
+    scan->running = num_threads;
+    for (int i = 0; i < num_threads; i++) {
+        if (pthread_create(&scan->threads[i], NULL, ps_worker, scan) != 0) {
+            pthread_mutex_lock(&scan->lock);
+            scan->running -= num_threads - i;
+            if (scan->running == 0)
+                pthread_cond_broadcast(&scan->finished);
+            pthread_mutex_unlock(&scan->lock);
+            num_threads = i;
+            break;
+        }
+    }
+    scan->num_threads = num_threads;
+
+    // Not a single worker: nothing will ever complete
+    if (num_threads == 0) {
+        pthread_mutex_destroy(&scan->lock);
+        pthread_cond_destroy(&scan->finished);
+        WSACleanup();
+        ps_release(scan);
+        return NULL;
+    }
+    return scan;
+}
+
+PS_API int64_t ps_scan_size(const PsScan *scan) {
+    return scan->size;
+}
+
+PS_API int64_t ps_scan_completed(PsScan *scan) {
+    pthread_mutex_lock(&scan->lock);
+    int64_t completed = scan->completed;
+    pthread_mutex_unlock(&scan->lock);
+    return completed;
+}
+
+PS_API int ps_scan_wait(PsScan *scan, int timeout_ms) {
+    double deadline = now_ms() + timeout_ms;
+
+    pthread_mutex_lock(&scan->lock);
+    while (scan->running > 0) {
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&scan->finished, &scan->lock);
+            continue;
+        }
+        double left = deadline - now_ms();
+        if (left <= 0)
+            break;
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += (time_t)(left / 1000);
+        ts.tv_nsec += (long)((left - (double)(int64_t)(left / 1000) * 1000) * 1000000);
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&scan->finished, &scan->lock, &ts);
+    }
+    int done = scan->running == 0;
+    pthread_mutex_unlock(&scan->lock);
+    return done;
+}
+
+PS_API void ps_scan_cancel(PsScan *scan) {
+    pthread_mutex_lock(&scan->lock);
+    scan->next = scan->size;
+    pthread_mutex_unlock(&scan->lock);
+}
+
+PS_API const uint32_t *ps_scan_addrs(const PsScan *scan) { return scan->addrs; }
+PS_API const uint16_t *ps_scan_ports(const PsScan *scan) { return scan->ports; }
+PS_API const uint8_t *ps_scan_states(const PsScan *scan) { return scan->states; }
+PS_API const uint16_t *ps_scan_rtt_ms(const PsScan *scan) { return scan->rtt_ms; }
+PS_API const uint32_t *ps_scan_tcp_rtt_us(const PsScan *scan) { return scan->tcp_rtt_us; }
+
+PS_API void ps_scan_free(PsScan *scan) {
+    if (scan == NULL)
+        return;
+
+    ps_scan_cancel(scan);
+    for (int i = 0; i < scan->num_threads; i++)
+        pthread_join(scan->threads[i], NULL);
+
+    pthread_mutex_destroy(&scan->lock);
+    pthread_cond_destroy(&scan->finished);
+    WSACleanup();
+    ps_release(scan);
+}
@@ -0,0 +1,61 @@
+/*
+ * Scanner library API
+ * Description:
+ *     C interface for driving scans from other languages (see
+ *     python/portscan.py). Results are kept in columnar arrays owned by the
+ *     scan - one entry per (address, port) in job order - so a binding can
+ *     wrap them directly as NumPy / Arrow arrays without copying.
+ *
+ *     Workers finish jobs out of order; ps_scan_completed() returns the
+ *     length of the prefix whose results are final, so a consumer can
+ *     stream batches [previous, completed) while the scan is running.
+ *
+ * Build:
+ *     gcc -shared -DPORTSCAN_LIBRARY port_scanner.c history.c archive.c format.c
+ *         plugin.c discover6.c gen6.c console.c pipeline.c targetset.c liveness.c
+ *         pressure.c weights.c hostagg.c summary.c portscan.c
+ *         -o portscan.dll -lws2_32 -liphlpapi -lpthread
+ */
+
+#ifndef PORTSCAN_H
+#define PORTSCAN_H
+
+#include <stdint.h>
+
+#ifdef _WIN32
+#define PS_API __declspec(dllexport)
+#else
+#define PS_API
+#endif
+
+typedef struct PsScan PsScan;
+
+// Start scanning target (address, CIDR block or range) on ports start..end
+// in the background. Returns NULL on invalid arguments or allocation failure.
+PS_API PsScan *ps_scan_start(const char *target, int start_port, int end_port,
+                             int num_threads, int timeout_ms);
+
+// Total number of results the scan will produce
+PS_API int64_t ps_scan_size(const PsScan *scan);
+
+// Results [0, completed) are final and will not change
+PS_API int64_t ps_scan_completed(PsScan *scan);
+
+// Wait up to timeout_ms (-1 = forever); returns 1 once all workers are done
+PS_API int ps_scan_wait(PsScan *scan, int timeout_ms);
+
+// Stop handing out new jobs; in-flight probes still finish
+PS_API void ps_scan_cancel(PsScan *scan);
+
+// Result columns, valid until ps_scan_free(). Address and port are filled
+// in up front; state and rtt are written as jobs complete.
+PS_API const uint32_t *ps_scan_addrs(const PsScan *scan);   // IPv4, host byte order
+PS_API const uint16_t *ps_scan_ports(const PsScan *scan);
+PS_API const uint8_t *ps_scan_states(const PsScan *scan);   // PortState
+PS_API const uint16_t *ps_scan_rtt_ms(const PsScan *scan);  // probe duration
+PS_API const uint32_t *ps_scan_tcp_rtt_us(const PsScan *scan); // kernel RTT, open ports only
+
+// Cancels, joins the workers and releases all result memory
+PS_API void ps_scan_free(PsScan *scan);
+
+#endif
@@ -0,0 +1,162 @@
+/*
+ * Connection table pressure (see pressure.h)
+ */
+
+#include <winsock2.h>
+#include <windows.h>
+#include <iphlpapi.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "scanner.h"
+#include "console.h"
+#include "pressure.h"
+
+static pthread_mutex_t LOCK = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t DRAINED = PTHREAD_COND_INITIALIZER;
+static pthread_t MONITOR;
+static int RUNNING = 0;
+static int STOP = 0;
+
+static int PORTS;                   // local port budget
+static int THROTTLED = 0;           // occupancy went over PRESSURE_HIGH
+static int GAVE_UP = 0;             // a pause ran out; occupancy is ignored
+static double BACKOFF_UNTIL = 0.0;  // after a local resource failure
+static double THROTTLE_START;
+
+// Report counters, under LOCK
+static DWORD PEAK_ENTRIES;
+static int64_t THROTTLES;
+static double THROTTLED_MS;
+static int64_t EXHAUSTED;
+
+// IPv4 and IPv6 connections both take ports from the dynamic range; a
+// host without an IPv6 stack has no IPv6 table and counts none
+static int read_entries(DWORD *entries) {
+    MIB_TCPSTATS stats;
+    if (GetTcpStatisticsEx(&stats, AF_INET) != NO_ERROR)
+        return -1;
+    *entries = stats.dwNumConns;
+    if (GetTcpStatisticsEx(&stats, AF_INET6) == NO_ERROR)
+        *entries += stats.dwNumConns;
+    return 0;
+}
+
+static int paused(double now) {
+    return THROTTLED || now < BACKOFF_UNTIL;
+}
+
+static void *monitor(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&LOCK);
+    while (!STOP) {
+        pthread_mutex_unlock(&LOCK);
+        Sleep(PRESSURE_POLL_MS);
+        DWORD entries;
+        int ok = read_entries(&entries) == 0;
+        double now = now_ms();
+        pthread_mutex_lock(&LOCK);
+        if (!ok || STOP)
+            continue;
+
+        if (entries > PEAK_ENTRIES)
+            PEAK_ENTRIES = entries;
+        double occupancy = (double)entries / PORTS;
+        if (!THROTTLED && !GAVE_UP && occupancy >= PRESSURE_HIGH) {
+            THROTTLED = 1;
+            THROTTLES++;
+            THROTTLE_START = now;
+        } else if (THROTTLED && occupancy <= PRESSURE_LOW) {
+            THROTTLED = 0;
+            THROTTLED_MS += now - THROTTLE_START;
+        } else if (THROTTLED && now - THROTTLE_START >= PRESSURE_MAX_THROTTLE_MS) {
+            // Not draining: held by other programs, or the budget is wrong
+            THROTTLED = 0;
+            GAVE_UP = 1;
+            THROTTLED_MS += now - THROTTLE_START;
+            char line[256];
+            int len = snprintf(line, sizeof(line),
+                               "Connection table still holds %lu entries (%d local ports) after "
+                               "%.0f s; connect probes are no longer throttled.\n",
+                               (unsigned long)entries, PORTS, PRESSURE_MAX_THROTTLE_MS / 1000.0);
+            console_push(line, (size_t)len);
+        }
+        if (!paused(now))
+            pthread_cond_broadcast(&DRAINED);
+    }
+    if (THROTTLED) {
+        THROTTLED = 0;
+        THROTTLED_MS += now_ms() - THROTTLE_START;
+    }
+    BACKOFF_UNTIL = 0.0;
+    pthread_cond_broadcast(&DRAINED);
+    pthread_mutex_unlock(&LOCK);
+    return NULL;
+}
+
+int pressure_start(int local_ports) {
+    DWORD entries;
+    if (read_entries(&entries) != 0) {
+        printf("Connection table unavailable; connect probes are not throttled.\n");
+        return -1;
+    }
+    PORTS = local_ports > 0 ? local_ports : PRESSURE_DEFAULT_PORTS;
+
+    // Entries held by other programs would never drain, so waiting on them
+    // could stall the scan for good
+    if (entries >= PRESSURE_LOW * PORTS) {
+        printf("Connection table already holds %lu entries (%d local ports); "
+               "connect probes are not throttled.\n", (unsigned long)entries, PORTS);
+        PORTS = 0;
+        return -1;
+    }
+    PEAK_ENTRIES = entries;
+    THROTTLES = 0;
+    THROTTLED_MS = 0.0;
+    EXHAUSTED = 0;
+    GAVE_UP = 0;
+    STOP = 0;
+    if (pthread_create(&MONITOR, NULL, monitor, NULL) != 0)
+        return -1;
+    RUNNING = 1;
+    return 0;
+}
+
+void pressure_wait(void) {
+    if (!RUNNING)
+        return;
+    pthread_mutex_lock(&LOCK);
+    while (paused(now_ms()) && !STOP)
+        pthread_cond_wait(&DRAINED, &LOCK);
+    pthread_mutex_unlock(&LOCK);
+}
+
+void pressure_exhausted(void) {
+    pthread_mutex_lock(&LOCK);
+    EXHAUSTED++;
+    if (RUNNING)
+        BACKOFF_UNTIL = now_ms() + PRESSURE_BACKOFF_MS;
+    pthread_mutex_unlock(&LOCK);
+    if (!RUNNING)
+        Sleep(PRESSURE_BACKOFF_MS);
+}
+
+void pressure_stop(void) {
+    if (!RUNNING)
+        return;
+    pthread_mutex_lock(&LOCK);
+    STOP = 1;
+    pthread_mutex_unlock(&LOCK);
+    pthread_join(MONITOR, NULL);
+    RUNNING = 0;
+}
+
+void pressure_report(void) {
+    if (PORTS == 0 || (PEAK_ENTRIES < PRESSURE_LOW * PORTS && THROTTLES == 0 && EXHAUSTED == 0))
+        return;
+    printf("Connection table: peak %lu entries (%.0f%% of %d local ports), "
+           "paused %lld times for %.2f s, %lld local port failures retried\n",
+           (unsigned long)PEAK_ENTRIES, 100.0 * PEAK_ENTRIES / PORTS, PORTS,
+           (long long)THROTTLES, THROTTLED_MS / 1000.0, (long long)EXHAUSTED);
+}
@@ -0,0 +1,57 @@
+/*
+ * Connection table pressure (connect scans)
+ * Description:
+ *     Every connect probe takes a local ephemeral port, which stays in the
+ *     TCP connection table (in TIME_WAIT after an open port is closed)
+ *     well after the probe is done. At high rates the dynamic port range
+ *     runs out: connect() then fails locally and the probe looks exactly
+ *     like a filtered port, a silent false negative.
+ *
+ *     A monitor thread samples the size of the TCP connection table (IPv4
+ *     and IPv6 connections, which share the port range) every
+ *     PRESSURE_POLL_MS. Once it reaches PRESSURE_HIGH of the local port
+ *     budget, workers pause before their next connect until it drains to
+ *     PRESSURE_LOW. A pause that lasts PRESSURE_MAX_THROTTLE_MS is given up
+ *     with a warning: the connections are held by something other than the
+ *     scan, and waiting longer would only stall it. Probes that fail for
+ *     lack of local resources anyway back off and are retried instead of
+ *     being recorded.
+ */
+
+#ifndef PRESSURE_H
+#define PRESSURE_H
+
+#include <stdint.h>
+
+// Windows' default dynamic port range, 49152-65535 (--local-ports)
+#define PRESSURE_DEFAULT_PORTS 16384
+
+#define PRESSURE_POLL_MS 100
+#define PRESSURE_HIGH 0.85          // pause workers at this occupancy
+#define PRESSURE_LOW 0.70           // ... until it is back down to this
+#define PRESSURE_MAX_THROTTLE_MS 10000  // ... or for at most this long
+
+// A local resource failure pauses every worker for this long, and a probe
+// is retried this many times before it is given up as filtered
+#define PRESSURE_BACKOFF_MS 500
+#define PRESSURE_MAX_RETRIES 10
+
+// Start monitoring against a budget of local_ports. Returns 0, or -1 if
+// the table can't be read or is already past PRESSURE_LOW (workers are
+// then never paused).
+int pressure_start(int local_ports);
+
+// Called by workers before each connect: returns at once unless the table
+// is under pressure, else waits for it to drain
+void pressure_wait(void);
+
+// A probe failed for lack of local ports / buffers
+void pressure_exhausted(void);
+
+// Stop the monitor (no-op if it isn't running)
+void pressure_stop(void);
+
+// Peak occupancy, pauses and retries (only if there was any pressure)
+void pressure_report(void);
+
+#endif
@@ -0,0 +1,160 @@
+"""
+Python bindings for the port scanner library (portscan.dll / libportscan.so).
+
+Results are exposed as NumPy arrays that view the scanner's own result
+columns - no per-result Python objects and no copies - so a million
+results can go straight into pandas or Arrow:
+
+    import portscan
+    with portscan.Scan("192.0.2.0/24", 1, 1024, threads=500, timeout_ms=200) as scan:
+        for batch in scan.batches():
+            print(len(batch["port"]), "results,", (batch["state"] == portscan.OPEN).sum(), "open")
+        df = scan.to_pandas()
+
+Arrays returned by a Scan keep a reference to it, so the C memory is only
+released once the Scan and every array viewing it are gone.
+"""
+
+import ctypes
+import os
+import sys
+
+import numpy as np
+
+CLOSED, OPEN, FILTERED = 0, 1, 2
+STATE_NAMES = ("closed", "open", "filtered")
+
+
+def _load(path=None):
+    if path is None:
+        name = "portscan.dll" if sys.platform == "win32" else "libportscan.so"
+        here = os.path.dirname(os.path.abspath(__file__))
+        path = os.environ.get("PORTSCAN_LIBRARY", os.path.join(here, "..", name))
+
+    lib = ctypes.CDLL(path)
+    lib.ps_scan_start.restype = ctypes.c_void_p
+    lib.ps_scan_start.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_int,
+                                  ctypes.c_int, ctypes.c_int]
+    for fn in ("ps_scan_size", "ps_scan_completed"):
+        getattr(lib, fn).restype = ctypes.c_int64
+        getattr(lib, fn).argtypes = [ctypes.c_void_p]
+    lib.ps_scan_wait.restype = ctypes.c_int
+    lib.ps_scan_wait.argtypes = [ctypes.c_void_p, ctypes.c_int]
+    lib.ps_scan_cancel.argtypes = [ctypes.c_void_p]
+    lib.ps_scan_free.argtypes = [ctypes.c_void_p]
+    for fn, ctype in (("ps_scan_addrs", ctypes.c_uint32), ("ps_scan_ports", ctypes.c_uint16),
+                      ("ps_scan_states", ctypes.c_uint8), ("ps_scan_rtt_ms", ctypes.c_uint16),
+                      ("ps_scan_tcp_rtt_us", ctypes.c_uint32)):
+        getattr(lib, fn).restype = ctypes.POINTER(ctype)
+        getattr(lib, fn).argtypes = [ctypes.c_void_p]
+    return lib
+
+
+_LIB = None
+
+
+def _lib():
+    global _LIB
+    if _LIB is None:
+        _LIB = _load()
+    return _LIB
+
+
+class Scan:
+    """A running (or finished) scan whose results live in C memory."""
+
+    def __init__(self, target, start_port=1, end_port=1023, threads=50, timeout_ms=200):
+        lib = _lib()
+        self._lib = lib
+        self._handle = lib.ps_scan_start(target.encode(), start_port, end_port,
+                                         threads, timeout_ms)
+        if not self._handle:
+            raise ValueError("could not start scan of %r ports %d-%d"
+                             % (target, start_port, end_port))
+        self.size = lib.ps_scan_size(self._handle)
+
+        # Full-length views over the result columns; the base object keeps
+        # this Scan (and so the C memory) alive as long as any view exists
+        self._columns = {}
+        for name, fn in (("addr", lib.ps_scan_addrs), ("port", lib.ps_scan_ports),
+                         ("state", lib.ps_scan_states), ("rtt_ms", lib.ps_scan_rtt_ms),
+                         ("tcp_rtt_us", lib.ps_scan_tcp_rtt_us)):
+            arr = np.ctypeslib.as_array(fn(self._handle), shape=(self.size,))
+            arr.flags.writeable = False
+            self._columns[name] = _Owned(arr, self)
+
+    def completed(self):
+        """Number of leading results that are final."""
+        return self._lib.ps_scan_completed(self._handle)
+
+    def wait(self, timeout_ms=-1):
+        """Block until the scan finishes (or timeout_ms passes); True if done."""
+        return bool(self._lib.ps_scan_wait(self._handle, timeout_ms))
+
+    def cancel(self):
+        self._lib.ps_scan_cancel(self._handle)
+
+    def columns(self, start=0, stop=None):
+        """Zero-copy views of results [start, stop); stop defaults to completed()."""
+        if stop is None:
+            stop = self.completed()
+        return {name: col[start:stop] for name, col in self._columns.items()}
+
+    def batches(self, poll_ms=100):
+        """Yield column views of newly completed results until the scan ends."""
+        emitted = 0
+        while True:
+            done = self.wait(poll_ms)
+            completed = self.completed()
+            if completed > emitted:
+                yield self.columns(emitted, completed)
+                emitted = completed
+            if done:
+                return
+
+    def to_pandas(self):
+        """DataFrame over the completed results (columns share memory where pandas allows)."""
+        import pandas as pd
+        return pd.DataFrame(self.columns(), copy=False)
+
+    def to_arrow(self):
+        """pyarrow.Table over the completed results, without copying."""
+        import pyarrow as pa
+        cols = self.columns()
+        return pa.table({name: pa.array(col) for name, col in cols.items()})
+
+    def close(self):
+        """Stop the scan and wait for in-flight probes. The memory itself is
+        freed only once neither the Scan nor any array viewing it is alive."""
+        if self._handle:
+            self.cancel()
+            self.wait()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            self._lib.ps_scan_free(self._handle)
+            self._handle = None
+
+
+class _Owned(np.ndarray):
+    """ndarray view that holds a reference to the Scan owning its memory."""
+
+    def __new__(cls, arr, owner):
+        obj = arr.view(cls)
+        obj._owner = owner
+        return obj
+
+    def __array_finalize__(self, obj):
+        self._owner = getattr(obj, "_owner", None)
+
+
+def ip_strings(addrs):
+    """Convert an addr column (uint32, host order) to dotted-quad strings."""
+    b = addrs.astype(">u4").view(np.uint8).reshape(-1, 4)
+    return ["%d.%d.%d.%d" % tuple(row) for row in b]
@@ -0,0 +1,386 @@
+/*
+ * Stateless raw-packet scan modes (see rawscan.h)
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <mstcpip.h>
+#include <windows.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "scanner.h"
+#include "rawscan.h"
+
+#define TCP_RST 0x04
+#define TCP_ACK 0x10
+
+#define SCTP_INIT 1
+#define SCTP_INIT_ACK 2
+#define SCTP_ABORT 6
+#define SCTP_FLAG_T 0x01    // ABORT: verification tag reflected, not ours
+
+// IPv4 header + largest probe
+#define RAW_PACKET_MAX 64
+
+typedef struct {
+    RawScan *scan;
+    SOCKET sock;
+    uint32_t src_addr;          // our address (host byte order)
+    uint64_t secret;            // cookie key for this scan
+    volatile LONG stop;         // set by the sender once the wait is over
+    int64_t replies;            // valid replies matched to a probe
+    int64_t ignored;            // packets for us that failed validation
+} Receiver;
+
+// ---- Packet helpers ----
+
+static uint16_t be16(const uint8_t *p) { return (uint16_t)(p[0] << 8 | p[1]); }
+static uint32_t be32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+static void put16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)(v >> 8); p[1] = (uint8_t)v; }
+static void put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8); p[3] = (uint8_t)v;
+}
+
+static uint32_t sum16(const uint8_t *p, size_t len, uint32_t sum) {
+    for (size_t i = 0; i + 1 < len; i += 2)
+        sum += (uint32_t)(p[i] << 8 | p[i + 1]);
+    if (len & 1)
+        sum += (uint32_t)(p[len - 1] << 8);
+    return sum;
+}
+
+static uint16_t fold(uint32_t sum) {
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+// splitmix64 finalizer, keyed by the scan secret
+static uint64_t mix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// Cookie for a probe to (dst, dport): the low 32 bits go in the field the
+// target echoes, the top bits pick our source port
+static uint64_t raw_cookie(uint64_t secret, uint32_t dst, uint16_t dport) {
+    return mix64(secret ^ ((uint64_t)dst << 16) ^ dport);
+}
+
+static uint16_t cookie_sport(uint64_t cookie) {
+    return (uint16_t)(RAW_SPORT_BASE + (cookie >> 50));
+}
+
+// CRC32c (Castagnoli), reflected, as SCTP uses it
+static uint32_t crc32c(const uint8_t *p, size_t len) {
+    static uint32_t table[256];
+    if (table[1] == 0) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? (c >> 1) ^ 0x82F63B78u : c >> 1;
+            table[i] = c;
+        }
+    }
+    uint32_t crc = 0xffffffffu;
+    for (size_t i = 0; i < len; i++)
+        crc = table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void build_ip(uint8_t *ip, uint32_t src, uint32_t dst, uint8_t proto, int payload_len,
+                     uint16_t id) {
+    memset(ip, 0, 20);
+    ip[0] = 0x45;
+    put16(ip + 2, (uint16_t)(20 + payload_len));
+    put16(ip + 4, id);
+    ip[8] = 64;
+    ip[9] = proto;
+    put32(ip + 12, src);
+    put32(ip + 16, dst);
+    put16(ip + 10, fold(sum16(ip, 20, 0)));
+}
+
+// ---- Probes ----
+
+// SCTP INIT; INIT-ACK and ABORT replies carry our initiate tag (the
+// cookie) as their verification tag. Listeners keep no state for an INIT
+// (the association only starts once a COOKIE-ECHO arrives), so probes need
+// no teardown.
+static int build_sctp_init(uint8_t *pkt, uint32_t src, uint32_t dst, uint16_t dport,
+                           uint64_t cookie) {
+    uint8_t *sctp = pkt + 20;
+    uint32_t tag = (uint32_t)cookie ? (uint32_t)cookie : 1;   // 0 is not a valid tag
+
+    memset(sctp, 0, 32);
+    put16(sctp, cookie_sport(cookie));
+    put16(sctp + 2, dport);
+    // verification tag (sctp + 4) is 0 in an INIT
+
+    uint8_t *init = sctp + 12;
+    init[0] = SCTP_INIT;
+    put16(init + 2, 20);
+    put32(init + 4, tag);                       // initiate tag
+    put32(init + 8, 65536);                     // advertised receive window
+    put16(init + 12, 10);                       // outbound streams
+    put16(init + 14, 2048);                     // max inbound streams
+    put32(init + 16, (uint32_t)(cookie >> 32)); // initial TSN
+
+    // CRC32c goes in little-endian byte order
+    uint32_t crc = crc32c(sctp, 32);
+    sctp[8] = (uint8_t)crc;
+    sctp[9] = (uint8_t)(crc >> 8);
+    sctp[10] = (uint8_t)(crc >> 16);
+    sctp[11] = (uint8_t)(crc >> 24);
+
+    build_ip(pkt, src, dst, 132, 32, (uint16_t)(cookie >> 16));
+    return 52;
+}
+
+// Build the probe for (dst, dport) into pkt; returns its length
+static int build_probe(RawProbe kind, uint8_t *pkt, uint32_t src, uint32_t dst,
+                       uint16_t dport, uint64_t cookie) {
+    uint8_t *tcp = pkt + 20;
+    if (kind == RAW_SCTP_INIT)
+        return build_sctp_init(pkt, src, dst, dport, cookie);
+
+    // Bare ACK; the RST it provokes carries seq = our ack = cookie
+    memset(tcp, 0, 20);
+    put16(tcp, cookie_sport(cookie));
+    put16(tcp + 2, dport);
+    put32(tcp + 4, (uint32_t)(cookie >> 32));
+    put32(tcp + 8, (uint32_t)cookie);
+    tcp[12] = 5 << 4;
+    tcp[13] = TCP_ACK;
+    put16(tcp + 14, 1024);
+    uint32_t sum = (src >> 16) + (src & 0xffff) + (dst >> 16) + (dst & 0xffff) + 6 + 20;
+    put16(tcp + 16, fold(sum16(tcp, 20, sum)));
+
+    build_ip(pkt, src, dst, 6, 20, (uint16_t)(cookie >> 16));
+    return 40;
+}
+
+// Classify a reply from src; returns its PortState and the job's port in
+// *port, or -1 if the packet isn't a valid reply to one of our probes
+static int parse_reply(const Receiver *r, uint8_t proto, uint32_t src, const uint8_t *l4,
+                       int len, uint16_t *port) {
+    if (len < 16)
+        return -1;
+    uint16_t sport = be16(l4), dport = be16(l4 + 2);
+    uint64_t cookie = raw_cookie(r->secret, src, sport);
+    if (dport != cookie_sport(cookie))
+        return -1;
+    *port = sport;
+
+    if (r->scan->kind == RAW_ACK) {
+        if (proto != 6 || len < 20 || !(l4[13] & TCP_RST) || be32(l4 + 4) != (uint32_t)cookie)
+            return -1;
+        return PORT_UNFILTERED;
+    }
+
+    // SCTP: the first chunk decides. An ABORT with the T flag reflects the
+    // INIT's zero tag, so only the source port vouches for it.
+    if (proto != 132)
+        return -1;
+    uint32_t tag = (uint32_t)cookie ? (uint32_t)cookie : 1;
+    uint32_t vtag = be32(l4 + 4);
+    const uint8_t *chunk = l4 + 12;
+    if (chunk[0] == SCTP_INIT_ACK && vtag == tag)
+        return PORT_OPEN;
+    if (chunk[0] == SCTP_ABORT && (vtag == tag || ((chunk[1] & SCTP_FLAG_T) && vtag == 0)))
+        return PORT_CLOSED;
+    return -1;
+}
+
+// ---- Receiver ----
+
+static void *receiver(void *arg) {
+    Receiver *r = (Receiver*)arg;
+    RawScan *scan = r->scan;
+    uint8_t buf[65536];
+
+    while (!r->stop) {
+        fd_set rd;
+        FD_ZERO(&rd);
+        FD_SET(r->sock, &rd);
+        struct timeval tv = { 0, 50 * 1000 };
+        if (select((int)r->sock + 1, &rd, NULL, NULL, &tv) <= 0)
+            continue;
+
+        int n = recv(r->sock, (char*)buf, sizeof(buf), 0);
+        if (n < 20 || (buf[0] >> 4) != 4)
+            continue;
+        int ihl = (buf[0] & 0x0f) * 4;
+        uint32_t src = be32(buf + 12), dst = be32(buf + 16);
+        if (dst != r->src_addr || n < ihl)
+            continue;
+
+        // Replies go to one of our source ports (TCP and SCTP both keep
+        // ports in the first four bytes) - this also skips our own probes
+        // when scanning ourselves
+        uint16_t to_port = n - ihl >= 4 ? be16(buf + ihl + 2) : 0;
+        if (to_port < RAW_SPORT_BASE || to_port >= RAW_SPORT_BASE + (1 << 14))
+            continue;
+
+        // Replies must come from the scanned range
+        int64_t host = scan->set != NULL ? tset_find(scan->set, src) :
+                       (int64_t)src - (int64_t)scan->first_addr;
+        if (host < 0 || host >= scan->num_hosts)
+            continue;
+
+        uint16_t port;
+        int state = parse_reply(r, buf[9], src, buf + ihl, n - ihl, &port);
+        int64_t slot = port - scan->start_port;
+        if (state < 0 || slot < 0 || slot >= scan->num_ports) {
+            r->ignored++;
+            continue;
+        }
+        scan->states[host * scan->num_ports + slot] = (unsigned char)state;
+        r->replies++;
+    }
+    return NULL;
+}
+
+// Our address on the route to dst (host byte order), 0 if there's none
+static uint32_t route_source(uint32_t dst) {
+    SOCKET s = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s == INVALID_SOCKET)
+        return 0;
+
+    struct sockaddr_in to = {0};
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = htonl(dst);
+    to.sin_port = htons(9);
+    struct sockaddr_in me;
+    socklen_t me_len = sizeof(me);
+    uint32_t src = 0;
+    if (connect(s, (struct sockaddr*)&to, sizeof(to)) == 0 &&
+        getsockname(s, (struct sockaddr*)&me, &me_len) == 0)
+        src = ntohl(me.sin_addr.s_addr);
+    closesocket(s);
+    return src;
+}
+
+// Raw receive socket seeing every IPv4 packet addressed to src
+static SOCKET open_receiver(uint32_t src) {
+    SOCKET s = socket(AF_INET, SOCK_RAW, IPPROTO_IP);
+    if (s == INVALID_SOCKET)
+        return INVALID_SOCKET;
+
+    // A deep kernel buffer absorbs reply bursts while we classify
+    int rcvbuf = 8 * 1024 * 1024;
+    setsockopt(s, SOL_SOCKET, SO_RCVBUF, (char*)&rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_in me = {0};
+    me.sin_family = AF_INET;
+    me.sin_addr.s_addr = htonl(src);
+    DWORD on = RCVALL_IPLEVEL, bytes;
+    if (bind(s, (struct sockaddr*)&me, sizeof(me)) != 0 ||
+        WSAIoctl(s, SIO_RCVALL, &on, sizeof(on), NULL, 0, &bytes, NULL, NULL) != 0) {
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+    return s;
+}
+
+int raw_scan(RawScan *scan) {
+    int64_t size = scan->num_hosts * scan->num_ports;
+    memset(scan->states, PORT_FILTERED, (size_t)size);   // until a reply says otherwise
+
+    Receiver r = {0};
+    r.scan = scan;
+    r.secret = mix64((uint64_t)time(NULL) ^ (uint64_t)(now_ms() * 1000.0));
+    r.src_addr = route_source(scan->first_addr);
+    if (r.src_addr == 0) {
+        printf("Raw scan: no route to the target.\n");
+        return -1;
+    }
+
+    SOCKET tx = socket(AF_INET, SOCK_RAW, IPPROTO_RAW);
+    int on = 1;
+    if (tx == INVALID_SOCKET ||
+        setsockopt(tx, IPPROTO_IP, IP_HDRINCL, (char*)&on, sizeof(on)) != 0) {
+        printf("Raw scan: cannot open a raw socket (error %d; run as administrator).\n",
+               WSAGetLastError());
+        if (tx != INVALID_SOCKET)
+            closesocket(tx);
+        return -1;
+    }
+    r.sock = open_receiver(r.src_addr);
+    if (r.sock == INVALID_SOCKET) {
+        printf("Raw scan: cannot capture replies (error %d).\n", WSAGetLastError());
+        closesocket(tx);
+        return -1;
+    }
+
+    pthread_t rx_thread;
+    pthread_create(&rx_thread, NULL, receiver, &r);
+
+    // Send port-major, so consecutive probes go to different hosts. Each
+    // batch is built first, then sent back to back; pacing sleeps between
+    // batches.
+    static uint8_t batch[RAW_BATCH][RAW_PACKET_MAX];
+    struct sockaddr_in to[RAW_BATCH];
+    int lens[RAW_BATCH];
+    int pending = 0;
+    int64_t sent = 0, failed = 0;
+    double start = now_ms();
+
+    for (int64_t i = 0; i < size; i++) {
+        int64_t host = i % scan->num_hosts;
+        uint32_t dst = scan->set != NULL ? tset_addr(scan->set, host) :
+                       scan->first_addr + (uint32_t)host;
+        uint16_t dport = (uint16_t)(scan->start_port + i / scan->num_hosts);
+
+        uint64_t cookie = raw_cookie(r.secret, dst, dport);
+        lens[pending] = build_probe(scan->kind, batch[pending], r.src_addr, dst, dport, cookie);
+        memset(&to[pending], 0, sizeof(to[pending]));
+        to[pending].sin_family = AF_INET;
+        to[pending].sin_addr.s_addr = htonl(dst);
+        pending++;
+        if (pending < RAW_BATCH && i + 1 < size)
+            continue;
+
+        for (int k = 0; k < pending; k++) {
+            if (sendto(tx, (const char*)batch[k], lens[k], 0,
+                       (struct sockaddr*)&to[k], sizeof(to[k])) == lens[k])
+                sent++;
+            else
+                failed++;
+        }
+        pending = 0;
+
+        if (scan->rate > 0) {
+            double ahead = (double)(sent + failed) * 1000.0 / scan->rate - (now_ms() - start);
+            if (ahead >= 1.0)
+                Sleep((DWORD)ahead);
+        }
+    }
+    double send_ms = now_ms() - start;
+
+    // Late replies still count
+    Sleep((DWORD)scan->wait_ms);
+    InterlockedExchange(&r.stop, 1);
+    pthread_join(rx_thread, NULL);
+    closesocket(r.sock);
+    closesocket(tx);
+
+    printf("Raw scan: %lld %s probes in %.2f s (%.0f/s), %lld replies",
+           (long long)sent, raw_probe_name(scan->kind), send_ms / 1000.0,
+           send_ms > 0.0 ? sent * 1000.0 / send_ms : 0.0, (long long)r.replies);
+    if (failed > 0)
+        printf(", %lld sends failed", (long long)failed);
+    if (r.ignored > 0)
+        printf(", %lld invalid replies ignored", (long long)r.ignored);
+    printf("\n");
+    return 0;
+}
@@ -0,0 +1,76 @@
+/*
+ * Stateless raw-packet scan modes (--ack, --sctp)
+ * Description:
+ *     Connect scans need a socket per probe and can't tell a stateful
+ *     firewall from a closed port. Raw modes instead build every probe
+ *     packet themselves: one thread sends probes in paced batches, a
+ *     receiver thread classifies replies, and no per-probe state is kept.
+ *     Each probe carries a cookie (a keyed hash of the target address and
+ *     port) in a field the target must echo back, so replies are matched to
+ *     probes - and forged or stray packets rejected - by recomputing it.
+ *
+ *     ACK scan: a bare ACK reaches a host's TCP stack only if no stateful
+ *     filter drops it, and any stack answers an unexpected ACK with a RST
+ *     whose sequence number is our acknowledgment number (the cookie).
+ *     RST = unfiltered, no reply = filtered. Maps firewall policy, not
+ *     services.
+ *
+ *     SCTP INIT scan: services on SCTP never show up in TCP connects. An
+ *     INIT carries the cookie as its initiate tag, which INIT-ACK and ABORT
+ *     replies use as their verification tag. INIT-ACK = open, ABORT =
+ *     closed, no reply = filtered.
+ *
+ *     IPv4 targets only. Needs administrator rights; client editions of
+ *     Windows refuse TCP over raw sockets, so ACK scans need Windows Server.
+ */
+
+#ifndef RAWSCAN_H
+#define RAWSCAN_H
+
+#include <stdint.h>
+
+#include "targetset.h"
+
+typedef enum {
+    RAW_NONE = 0,       // connect scan
+    RAW_ACK,            // --ack
+    RAW_SCTP_INIT       // --sctp
+} RawProbe;
+
+// Probes sent per batch between pacing checks
+#define RAW_BATCH 64
+
+// Default probe rate (--rate), packets per second
+#define RAW_DEFAULT_RATE 10000
+
+// Replies are collected for max(--timeout, this) after the last probe
+#define RAW_MIN_WAIT_MS 1000
+
+// Our source ports: base + 14 bits of the cookie
+#define RAW_SPORT_BASE 40000
+
+typedef struct {
+    RawProbe kind;
+    uint32_t first_addr;    // target range (host byte order)
+    int64_t num_hosts;
+    const TargetSet *set;   // target ranges, NULL = num_hosts from first_addr
+    int start_port;
+    int num_ports;
+    unsigned char *states;  // PortState per job, host-major like JobQueue
+    int rate;               // probes per second, 0 = unlimited
+    int wait_ms;            // listen time after the last probe
+} RawScan;
+
+// Probe every (host, port) of the scan and fill in states. Returns 0, or
+// -1 after printing why.
+int raw_scan(RawScan *scan);
+
+static inline const char *raw_probe_name(RawProbe kind) {
+    switch (kind) {
+        case RAW_ACK: return "ack";
+        case RAW_SCTP_INIT: return "sctp";
+        default: return "connect";
+    }
+}
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ * Shared scanner definitions
+ * Description:
+ *     Types and small helpers used by port_scanner.c and the storage /
+ *     output modules (port states, 16-byte address handling).
+ */
+
+#ifndef SCANNER_H
+#define SCANNER_H
+
+// inet_pton / inet_ntop need Vista+ declarations
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0601
+#endif
+
+// ANSI color codes for console output (Windows 10+ / modern terminals)
+#define COLOR_GREEN  "\x1b[32m"
+#define COLOR_YELLOW "\x1b[33m"
+#define COLOR_RESET  "\x1b[0m"
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <stdint.h>
+#include <string.h>
+
+// Outcome of probing a single (address, port)
+typedef enum {
+    PORT_CLOSED = 0,    // connection refused (RST)
+    PORT_OPEN = 1,      // connect() succeeded
+    PORT_FILTERED = 2,  // timed out / no answer
+    PORT_UNFILTERED = 3 // ACK scan: RST came back, so no filter dropped the probe
+} PortState;
+
+static inline const char *state_name(int state) {
+    switch (state) {
+        case PORT_OPEN: return "open";
+        case PORT_CLOSED: return "closed";
+        case PORT_FILTERED: return "filtered";
+        case PORT_UNFILTERED: return "unfiltered";
+        default: return "unknown";
+    }
+}
+
+// Addresses are stored as 16 bytes everywhere; IPv4 uses the
+// IPv4-mapped form ::ffff:a.b.c.d so on-disk formats cover both families.
+static inline void addr_from_ipv4(unsigned char out[16], const struct in_addr *a) {
+    memset(out, 0, 10);
+    out[10] = 0xff;
+    out[11] = 0xff;
+    memcpy(out + 12, a, 4);
+}
+
+static inline int addr_is_ipv4(const unsigned char a[16]) {
+    static const unsigned char prefix[12] = {0,0,0,0,0,0,0,0,0,0,0xff,0xff};
+    return memcmp(a, prefix, 12) == 0;
+}
+
+// Parse an IPv4 or IPv6 literal; returns 1 on success
+static inline int addr_parse(const char *s, unsigned char out[16]) {
+    struct in_addr v4;
+    if (inet_pton(AF_INET, s, &v4) == 1) {
+        addr_from_ipv4(out, &v4);
+        return 1;
+    }
+    return inet_pton(AF_INET6, s, out) == 1;
+}
+
+static inline const char *addr_format(const unsigned char a[16], char *buf, size_t len) {
+    if (addr_is_ipv4(a))
+        return inet_ntop(AF_INET, (void*)(a + 12), buf, len);
+    return inet_ntop(AF_INET6, (void*)a, buf, len);
+}
+
+// What the kernel knows about a connected socket (SIO_TCP_INFO)
+typedef struct {
+    uint32_t rtt_us;        // smoothed round-trip time
+    uint32_t min_rtt_us;    // lowest RTT seen (Windows keeps no RTT variance)
+    uint32_t mss;
+    uint32_t rcv_wnd;       // receive window
+    uint32_t syn_retrans;   // SYNs resent before the connect succeeded
+} ConnInfo;
+
+// Probe helpers implemented in port_scanner.c (also used by the library API)
+double now_ms(void);
+int probe_port(const struct sockaddr *target, int target_len, int timeout_ms, SOCKET *sock);
+int conn_info(SOCKET s, ConnInfo *out);
+int parse_target(const char *spec, uint32_t *first, int64_t *count);
+
+#endif
@@ -0,0 +1,22 @@
+-- Example --script: check whether a Redis server answers without auth
+-- port_scanner.exe 192.0.2.10 6379 6380 10 --fast --script scripts/redis_ping.lua
+
+ports = { 6379, 6380 }
+
+function action(target, sock)
+    local ok, err = sock:send("PING\r\n")
+    if not ok then
+        return err
+    end
+
+    local reply, rerr = sock:recv()
+    if not reply then
+        return "no reply (" .. rerr .. ")"
+    end
+    if reply:sub(1, 5) == "+PONG" then
+        return "redis: no auth"
+    elseif reply:find("NOAUTH", 1, true) then
+        return "redis: auth required"
+    end
+    return "not redis"
+end
@@ -0,0 +1,376 @@
+/*
+ * Scan summary sketches (see summary.h)
+ */
+
+#include <winsock2.h>
+#include <windows.h>
+#include <pthread.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "console.h"
+#include "summary.h"
+
+// The live thread checks for sum_stop_live() this often
+#define SUM_LIVE_POLL_MS 100
+
+enum { LIST_PORTS, LIST_SERVICES, LIST_BANNERS, NUM_LISTS };
+static const char *LIST_TITLES[NUM_LISTS] = { "Top ports:", "Top services:", "Top banners:" };
+
+typedef struct {
+    uint64_t key;               // hash of list and label
+    uint32_t count;             // never below the key's true count ...
+    uint32_t err;               // ... and at most this much above it
+    char label[SUM_LABEL];
+    uint8_t hll[1 << SUM_ENTRY_HLL_BITS];   // hosts (ports and services)
+} SumEntry;
+
+typedef struct {
+    SumEntry e[SUM_SLOTS];
+    int n;
+} SumList;
+
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t open;              // open ports added
+    SumList lists[NUM_LISTS];
+    uint32_t cms[SUM_CMS_DEPTH][SUM_CMS_WIDTH];
+    uint8_t hosts[1 << SUM_HLL_BITS];
+} SumShard;
+
+static SumShard *SHARDS;        // NULL = not collecting
+static int NUM_SHARDS;
+
+static pthread_t LIVE;
+static int LIVE_RUNNING = 0;
+static volatile LONG LIVE_STOP = 0;
+static int LIVE_INTERVAL_S;
+
+// Merged view of one entry across shards
+typedef struct {
+    uint64_t key;
+    uint32_t count;
+    uint32_t low;               // count - error: the true count is at least this
+    uint64_t present_min;       // shard minimums of the shards that had the key
+    char label[SUM_LABEL];
+    uint8_t hll[1 << SUM_ENTRY_HLL_BITS];
+} SumMerged;
+
+typedef struct {
+    uint64_t open;
+    double hosts;
+    SumMerged *lists[NUM_LISTS];    // sorted by count, largest first
+    int n[NUM_LISTS];
+} SumView;
+
+// splitmix64 finalizer
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static uint64_t hash_bytes(const void *p, size_t n, uint64_t seed) {
+    const unsigned char *b = p;
+    uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+    for (size_t i = 0; i < n; i++)
+        h = (h ^ b[i]) * 0x100000001b3ULL;
+    return mix64(h);
+}
+
+static void hll_add(uint8_t *reg, int bits, uint64_t h) {
+    uint64_t rest = h << bits;
+    uint8_t rank = rest == 0 ? (uint8_t)(64 - bits + 1) : (uint8_t)(__builtin_clzll(rest) + 1);
+    size_t j = (size_t)(h >> (64 - bits));
+    if (rank > reg[j])
+        reg[j] = rank;
+}
+
+static double hll_estimate(const uint8_t *reg, int bits) {
+    int m = 1 << bits, zeros = 0;
+    double sum = 0.0;
+    for (int j = 0; j < m; j++) {
+        sum += ldexp(1.0, -reg[j]);
+        zeros += reg[j] == 0;
+    }
+    double e = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+    // Small cardinalities: linear counting is more accurate
+    if (e <= 2.5 * m && zeros > 0)
+        e = m * log((double)m / zeros);
+    return e;
+}
+
+static size_t cms_cell(uint64_t key, int row) {
+    return (size_t)(mix64(key + (uint64_t)(row + 1) * 0x9e3779b97f4a7c15ULL) & (SUM_CMS_WIDTH - 1));
+}
+
+int sum_init(int num_threads) {
+    NUM_SHARDS = num_threads < SUM_SHARDS ? num_threads : SUM_SHARDS;
+    if (NUM_SHARDS < 1)
+        NUM_SHARDS = 1;
+    SHARDS = calloc((size_t)NUM_SHARDS, sizeof(SumShard));
+    if (SHARDS == NULL) {
+        printf("Memory allocation failed.\n");
+        return -1;
+    }
+    for (int i = 0; i < NUM_SHARDS; i++)
+        pthread_mutex_init(&SHARDS[i].lock, NULL);
+    return 0;
+}
+
+// Count key in l (space-saving), and host among its hosts if given
+static void ss_add(SumList *l, uint64_t key, const char *label, const uint64_t *host) {
+    SumEntry *e = NULL;
+    for (int i = 0; i < l->n && e == NULL; i++)
+        if (l->e[i].key == key)
+            e = &l->e[i];
+    if (e == NULL) {
+        if (l->n < SUM_SLOTS) {
+            e = &l->e[l->n++];
+            memset(e, 0, sizeof(*e));
+        } else {
+            // The least counted key makes way; its count becomes the
+            // newcomer's error
+            e = &l->e[0];
+            for (int i = 1; i < SUM_SLOTS; i++)
+                if (l->e[i].count < e->count)
+                    e = &l->e[i];
+            e->err = e->count;
+            memset(e->hll, 0, sizeof(e->hll));
+        }
+        e->key = key;
+        snprintf(e->label, sizeof(e->label), "%s", label);
+    }
+    e->count++;
+    if (host != NULL)
+        hll_add(e->hll, SUM_ENTRY_HLL_BITS, *host);
+}
+
+// First line of a banner, printable characters only
+static void banner_label(const char *banner, int len, char *out) {
+    int n = 0;
+    for (int i = 0; i < len && n < SUM_LABEL - 1 && banner[i] != '\r' && banner[i] != '\n'; i++)
+        out[n++] = banner[i] >= 0x20 && banner[i] < 0x7f ? banner[i] : '.';
+    out[n] = '\0';
+}
+
+void sum_add(int thread, const unsigned char addr[16], int port, const char *service,
+             const char *banner, int banner_len) {
+    if (SHARDS == NULL)
+        return;
+
+    // Labels and hashes outside the lock
+    char labels[NUM_LISTS][SUM_LABEL];
+    uint64_t keys[NUM_LISTS];
+    uint64_t host = hash_bytes(addr, 16, 0);
+    if (*service)
+        snprintf(labels[LIST_PORTS], SUM_LABEL, "%d (%s)", port, service);
+    else
+        snprintf(labels[LIST_PORTS], SUM_LABEL, "%d", port);
+    snprintf(labels[LIST_SERVICES], SUM_LABEL, "%s", service);
+    banner_label(banner, banner_len, labels[LIST_BANNERS]);
+    for (int l = 0; l < NUM_LISTS; l++)
+        keys[l] = hash_bytes(labels[l], strlen(labels[l]), (uint64_t)l + 1);
+
+    SumShard *s = &SHARDS[thread % NUM_SHARDS];
+    pthread_mutex_lock(&s->lock);
+    s->open++;
+    hll_add(s->hosts, SUM_HLL_BITS, host);
+    for (int l = 0; l < NUM_LISTS; l++) {
+        if (labels[l][0] == '\0')
+            continue;   // no service name / no banner
+        ss_add(&s->lists[l], keys[l], labels[l], l != LIST_BANNERS ? &host : NULL);
+        for (int row = 0; row < SUM_CMS_DEPTH; row++)
+            s->cms[row][cms_cell(keys[l], row)]++;
+    }
+    pthread_mutex_unlock(&s->lock);
+}
+
+static int cmp_merged(const void *a, const void *b) {
+    const SumMerged *x = a, *y = b;
+    return x->count > y->count ? -1 : x->count < y->count ? 1 : strcmp(x->label, y->label);
+}
+
+static void view_free(SumView *v) {
+    for (int l = 0; l < NUM_LISTS; l++)
+        free(v->lists[l]);
+}
+
+// Merge every shard into v. Returns 0, or -1 on allocation failure.
+static int view_build(SumView *v) {
+    memset(v, 0, sizeof(*v));
+    SumShard *snap = malloc(sizeof(SumShard));
+    uint32_t (*cms)[SUM_CMS_WIDTH] = calloc(SUM_CMS_DEPTH, sizeof(*cms));
+    uint8_t hosts[1 << SUM_HLL_BITS] = {0};
+    uint64_t min_total[NUM_LISTS] = {0};
+    for (int l = 0; l < NUM_LISTS; l++)
+        v->lists[l] = malloc((size_t)NUM_SHARDS * SUM_SLOTS * sizeof(SumMerged));
+    int ok = snap != NULL && cms != NULL;
+    for (int l = 0; l < NUM_LISTS; l++)
+        ok = ok && v->lists[l] != NULL;
+    if (!ok) {
+        free(snap);
+        free(cms);
+        view_free(v);
+        return -1;
+    }
+
+    for (int i = 0; i < NUM_SHARDS; i++) {
+        // Copy the shard so workers wait only for the copy
+        pthread_mutex_lock(&SHARDS[i].lock);
+        memcpy(snap, &SHARDS[i], sizeof(SumShard));
+        pthread_mutex_unlock(&SHARDS[i].lock);
+
+        v->open += snap->open;
+        for (int j = 0; j < (1 << SUM_HLL_BITS); j++)
+            if (snap->hosts[j] > hosts[j])
+                hosts[j] = snap->hosts[j];
+        for (int row = 0; row < SUM_CMS_DEPTH; row++)
+            for (int c = 0; c < SUM_CMS_WIDTH; c++)
+                cms[row][c] += snap->cms[row][c];
+
+        for (int l = 0; l < NUM_LISTS; l++) {
+            const SumList *sl = &snap->lists[l];
+            // A key this shard doesn't list was counted at most this often
+            uint32_t shard_min = 0;
+            if (sl->n == SUM_SLOTS) {
+                shard_min = sl->e[0].count;
+                for (int k = 1; k < sl->n; k++)
+                    if (sl->e[k].count < shard_min)
+                        shard_min = sl->e[k].count;
+            }
+            min_total[l] += shard_min;
+
+            for (int k = 0; k < sl->n; k++) {
+                const SumEntry *e = &sl->e[k];
+                SumMerged *m = NULL;
+                for (int x = 0; x < v->n[l] && m == NULL; x++)
+                    if (v->lists[l][x].key == e->key)
+                        m = &v->lists[l][x];
+                if (m == NULL) {
+                    m = &v->lists[l][v->n[l]++];
+                    memset(m, 0, sizeof(*m));
+                    m->key = e->key;
+                    memcpy(m->label, e->label, SUM_LABEL);
+                }
+                m->count += e->count;
+                m->low += e->count - e->err;
+                m->present_min += shard_min;
+                for (int j = 0; j < (1 << SUM_ENTRY_HLL_BITS); j++)
+                    if (e->hll[j] > m->hll[j])
+                        m->hll[j] = e->hll[j];
+            }
+        }
+    }
+
+    // Shards that dropped a key may have seen it up to their minimum; the
+    // count-min estimate is an upper bound too, so take the tighter one
+    for (int l = 0; l < NUM_LISTS; l++) {
+        for (int x = 0; x < v->n[l]; x++) {
+            SumMerged *m = &v->lists[l][x];
+            uint64_t upper = m->count + (min_total[l] - m->present_min);
+            for (int row = 0; row < SUM_CMS_DEPTH; row++) {
+                uint32_t c = cms[row][cms_cell(m->key, row)];
+                if (c < upper)
+                    upper = c;
+            }
+            m->count = (uint32_t)upper;
+            if (m->low > m->count)
+                m->low = m->count;
+        }
+        qsort(v->lists[l], (size_t)v->n[l], sizeof(SumMerged), cmp_merged);
+    }
+    v->hosts = hll_estimate(hosts, SUM_HLL_BITS);
+    free(snap);
+    free(cms);
+    return 0;
+}
+
+// "312", or "~312" when the sketches can only bound it
+static void format_count(const SumMerged *m, char *out, size_t cap) {
+    snprintf(out, cap, "%s%lu", m->low < m->count ? "~" : "", (unsigned long)m->count);
+}
+
+static void *live(void *arg) {
+    (void)arg;
+    for (;;) {
+        for (int t = 0; t < LIVE_INTERVAL_S * 1000 / SUM_LIVE_POLL_MS; t++) {
+            if (LIVE_STOP)
+                return NULL;
+            Sleep(SUM_LIVE_POLL_MS);
+        }
+
+        SumView v;
+        if (view_build(&v) != 0)
+            continue;
+        char line[CONSOLE_LINE_MAX], count[16];
+        int len = snprintf(line, sizeof(line), "Live: %llu open ports on ~%.0f hosts",
+                           (unsigned long long)v.open, v.open > 0 ? v.hosts : 0.0);
+        for (int x = 0; x < v.n[LIST_PORTS] && x < SUM_LIVE_TOP; x++) {
+            format_count(&v.lists[LIST_PORTS][x], count, sizeof(count));
+            len += snprintf(line + len, sizeof(line) - len, "%s%s %s", x == 0 ? "; top " : ", ",
+                            v.lists[LIST_PORTS][x].label, count);
+        }
+        len += snprintf(line + len, sizeof(line) - len, "\n");
+        console_push(line, (size_t)len);
+        view_free(&v);
+    }
+}
+
+int sum_start_live(int interval_s) {
+    if (SHARDS == NULL || interval_s < 1)
+        return -1;
+    LIVE_INTERVAL_S = interval_s;
+    InterlockedExchange(&LIVE_STOP, 0);
+    if (pthread_create(&LIVE, NULL, live, NULL) != 0)
+        return -1;
+    LIVE_RUNNING = 1;
+    return 0;
+}
+
+void sum_stop_live(void) {
+    if (!LIVE_RUNNING)
+        return;
+    InterlockedExchange(&LIVE_STOP, 1);
+    pthread_join(LIVE, NULL);
+    LIVE_RUNNING = 0;
+}
+
+void sum_report(void) {
+    if (SHARDS == NULL)
+        return;
+    SumView v;
+    if (view_build(&v) != 0) {
+        printf("Summary: memory allocation failed.\n");
+        return;
+    }
+    printf("Summary: %llu open ports on ~%.0f distinct hosts\n",
+           (unsigned long long)v.open, v.open > 0 ? v.hosts : 0.0);
+    for (int l = 0; l < NUM_LISTS; l++) {
+        if (v.n[l] == 0)
+            continue;
+        printf("%s\n", LIST_TITLES[l]);
+        for (int x = 0; x < v.n[l] && x < SUM_TOP; x++) {
+            const SumMerged *m = &v.lists[l][x];
+            char count[16];
+            format_count(m, count, sizeof(count));
+            if (l == LIST_BANNERS)
+                printf("  %8s  %s\n", count, m->label);
+            else
+                printf("  %8s  %-16s on ~%.0f hosts\n", count, m->label,
+                       hll_estimate(m->hll, SUM_ENTRY_HLL_BITS));
+        }
+    }
+    view_free(&v);
+}
+
+void sum_free(void) {
+    for (int i = 0; SHARDS != NULL && i < NUM_SHARDS; i++)
+        pthread_mutex_destroy(&SHARDS[i].lock);
+    free(SHARDS);
+    SHARDS = NULL;
+}
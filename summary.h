@@ -0,0 +1,61 @@
+/*
+ * Scan summary sketches (--summary)
+ * Description:
+ *     Fleet-wide questions (which ports and services are most common, which
+ *     banners repeat, how many hosts run each) shouldn't need every result
+ *     kept around. Workers feed each open port into fixed-size sketches
+ *     instead, so memory stays the same on any scan size:
+ *
+ *       - space-saving top-K lists of ports, services and banners: SUM_SLOTS
+ *         counters per list, the least counted one is replaced when a new
+ *         key arrives, and its count carried over as the new key's error
+ *       - a count-min sketch over the same keys, whose minimum over
+ *         SUM_CMS_DEPTH rows bounds each count from above independently
+ *       - HyperLogLog registers for the distinct hosts with open ports, and
+ *         per port and service entry for the hosts behind them
+ *
+ *     Workers update one of SUM_SHARDS shards (thread id modulo the shard
+ *     count, each with its own lock), so they rarely contend. Shards are
+ *     merged for the end-of-scan report and, with --summary-every, for a
+ *     live line on the console while the scan runs: counters and count-min
+ *     cells add up, registers take the maximum.
+ */
+
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include <stdint.h>
+
+#define SUM_SHARDS 32               // at most; fewer with fewer threads
+#define SUM_SLOTS 64                // space-saving counters per list
+#define SUM_TOP 10                  // entries printed per list
+#define SUM_LIVE_TOP 3              // ... and on the live line
+
+#define SUM_CMS_DEPTH 4
+#define SUM_CMS_WIDTH 512
+
+#define SUM_HLL_BITS 12             // distinct hosts overall (~1.6% error)
+#define SUM_ENTRY_HLL_BITS 8        // ... per port / service (~6.5% error)
+
+#define SUM_LABEL 48                // banner text kept for the report
+
+// Start collecting for num_threads workers. Returns 0, or -1 on
+// allocation failure.
+int sum_init(int num_threads);
+
+// An open port found by worker thread (no-op unless sum_init() succeeded).
+// service and banner may be empty.
+void sum_add(int thread, const unsigned char addr[16], int port, const char *service,
+             const char *banner, int banner_len);
+
+// Print a merged summary line to the console every interval_s seconds
+// until sum_stop_live(). Returns 0, or -1 if the thread can't start.
+int sum_start_live(int interval_s);
+void sum_stop_live(void);
+
+// Merge the shards and print the top lists
+void sum_report(void);
+
+void sum_free(void);
+
+#endif
@@ -0,0 +1,378 @@
+/*
+ * IPv4 target set algebra (see targetset.h)
+ */
+
+#include <winsock2.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scanner.h"
+#include "targetset.h"
+
+void tset_init(TargetSet *s) {
+    memset(s, 0, sizeof(*s));
+}
+
+void tset_free(TargetSet *s) {
+    free(s->ranges);
+    free(s->before);
+    tset_init(s);
+}
+
+static int push_range(TargetSet *s, uint32_t lo, uint32_t hi) {
+    if (s->count == s->cap) {
+        int64_t cap = s->cap ? s->cap * 2 : 64;
+        TsRange *r = realloc(s->ranges, (size_t)cap * sizeof(TsRange));
+        if (r == NULL)
+            return -1;
+        s->ranges = r;
+        s->cap = cap;
+    }
+    s->ranges[s->count].lo = lo;
+    s->ranges[s->count].hi = hi;
+    s->count++;
+    return 0;
+}
+
+int tset_append(TargetSet *s, uint32_t lo, uint32_t hi) {
+    if (s->count > 0) {
+        TsRange *last = &s->ranges[s->count - 1];
+        if (last->hi == UINT32_MAX || lo <= last->hi + 1) {
+            if (hi > last->hi)
+                last->hi = hi;
+            return 0;
+        }
+    }
+    return push_range(s, lo, hi);
+}
+
+// ---- Parallel LSD radix sort of raw addresses ----
+
+typedef struct {
+    const uint32_t *src;
+    uint32_t *dst;
+    int64_t begin, end;
+    int shift;
+    int64_t count[256];     // histogram, then this thread's output offsets
+} SortPart;
+
+static void *sort_count(void *arg) {
+    SortPart *p = (SortPart*)arg;
+    memset(p->count, 0, sizeof(p->count));
+    for (int64_t i = p->begin; i < p->end; i++)
+        p->count[(p->src[i] >> p->shift) & 0xff]++;
+    return NULL;
+}
+
+static void *sort_scatter(void *arg) {
+    SortPart *p = (SortPart*)arg;
+    for (int64_t i = p->begin; i < p->end; i++)
+        p->dst[p->count[(p->src[i] >> p->shift) & 0xff]++] = p->src[i];
+    return NULL;
+}
+
+// Run fn over every part, on threads when there is more than one
+static void sort_run(SortPart *parts, int num_parts, void *(*fn)(void*)) {
+    pthread_t threads[TSET_SORT_THREADS];
+    int started[TSET_SORT_THREADS] = {0};
+    for (int t = 1; t < num_parts; t++)
+        started[t] = pthread_create(&threads[t], NULL, fn, &parts[t]) == 0;
+    fn(&parts[0]);
+    for (int t = 1; t < num_parts; t++) {
+        if (started[t])
+            pthread_join(threads[t], NULL);
+        else
+            fn(&parts[t]);
+    }
+}
+
+// Sort n addresses in place (8 bits per pass, each pass split across
+// threads: count per thread, then scatter to per-thread offsets so the
+// pass stays stable). Returns 0, or -1 on allocation failure.
+static int radix_sort(uint32_t *a, int64_t n) {
+    uint32_t *tmp = malloc((size_t)n * sizeof(uint32_t));
+    if (tmp == NULL)
+        return -1;
+
+    int num_parts = n >= TSET_PARALLEL_MIN ? TSET_SORT_THREADS : 1;
+    SortPart parts[TSET_SORT_THREADS];
+    uint32_t *src = a, *dst = tmp;
+
+    for (int shift = 0; shift < 32; shift += 8) {
+        for (int t = 0; t < num_parts; t++) {
+            parts[t].src = src;
+            parts[t].dst = dst;
+            parts[t].begin = n * t / num_parts;
+            parts[t].end = n * (t + 1) / num_parts;
+            parts[t].shift = shift;
+        }
+        sort_run(parts, num_parts, sort_count);
+
+        // Digit-major, thread-minor prefix sums
+        int64_t next = 0;
+        for (int d = 0; d < 256; d++) {
+            for (int t = 0; t < num_parts; t++) {
+                int64_t c = parts[t].count[d];
+                parts[t].count[d] = next;
+                next += c;
+            }
+        }
+        sort_run(parts, num_parts, sort_scatter);
+
+        uint32_t *swap = src;
+        src = dst;
+        dst = swap;
+    }
+    // Four passes: the sorted data is back in a
+    free(tmp);
+    return 0;
+}
+
+static int cmp_range(const void *a, const void *b) {
+    const TsRange *x = a, *y = b;
+    return x->lo < y->lo ? -1 : x->lo > y->lo;
+}
+
+// ---- Loading ----
+
+typedef struct {
+    TargetSet ranges;           // blocks and ranges, unsorted
+    uint32_t *addrs;            // single addresses, unsorted
+    int64_t num_addrs;
+    int64_t cap_addrs;
+} Loader;
+
+static int load_item(void *ctx, const char *item) {
+    Loader *l = ctx;
+    uint32_t first;
+    int64_t count;
+    if (parse_target(item, &first, &count) != 0) {
+        printf("Invalid target in list: %s\n", item);
+        return -1;
+    }
+    if (count > 1)
+        return push_range(&l->ranges, first, (uint32_t)(first + (count - 1)));
+
+    if (l->num_addrs == l->cap_addrs) {
+        int64_t cap = l->cap_addrs ? l->cap_addrs * 2 : 1024;
+        uint32_t *a = realloc(l->addrs, (size_t)cap * sizeof(uint32_t));
+        if (a == NULL) {
+            printf("Memory allocation failed.\n");
+            return -1;
+        }
+        l->addrs = a;
+        l->cap_addrs = cap;
+    }
+    l->addrs[l->num_addrs++] = first;
+    return 0;
+}
+
+// Split text on commas and whitespace and pass each item on; '#' ends the text
+static int split_text(char *text, TsItemFn item, void *ctx) {
+    char *hash = strchr(text, '#');
+    if (hash != NULL)
+        *hash = '\0';
+    for (char *tok = strtok(text, ", \t\r\n"); tok != NULL; tok = strtok(NULL, ", \t\r\n"))
+        if (item(ctx, tok) != 0)
+            return -1;
+    return 0;
+}
+
+// Read one whole line of f into *buf (grown as needed, the caller frees).
+// Returns 1, 0 at end of file, or -1 on allocation failure.
+static int read_line(FILE *f, char **buf, size_t *cap) {
+    size_t len = 0;
+    for (;;) {
+        if (*cap - len < 2) {
+            size_t n = *cap > 0 ? *cap * 2 : 256;
+            char *p = realloc(*buf, n);
+            if (p == NULL) {
+                printf("Memory allocation failed.\n");
+                return -1;
+            }
+            *buf = p;
+            *cap = n;
+        }
+        if (fgets(*buf + len, (int)(*cap - len), f) == NULL)
+            return len > 0 ? 1 : 0;
+        len += strlen(*buf + len);
+        if ((*buf)[len - 1] == '\n')
+            return 1;
+    }
+}
+
+int tset_read_list(const char *arg, TsItemFn item, void *ctx) {
+    int rc = 0;
+    FILE *f = fopen(arg, "r");
+    if (f != NULL) {
+        char *line = NULL;
+        size_t cap = 0;
+        while (rc == 0 && (rc = read_line(f, &line, &cap)) == 1)
+            rc = split_text(line, item, ctx);
+        free(line);
+        fclose(f);
+        return rc;
+    }
+
+    char *copy = malloc(strlen(arg) + 1);
+    if (copy == NULL) {
+        printf("Memory allocation failed.\n");
+        return -1;
+    }
+    strcpy(copy, arg);
+    rc = split_text(copy, item, ctx);
+    free(copy);
+    return rc;
+}
+
+int tset_load(TargetSet *s, const char *arg) {
+    Loader l;
+    memset(&l, 0, sizeof(l));
+    tset_init(&l.ranges);
+    int rc = tset_read_list(arg, load_item, &l);
+
+    // Single addresses: radix sort, then runs of consecutive addresses
+    // become ranges next to the blocks
+    if (rc == 0 && l.num_addrs > 0) {
+        if (radix_sort(l.addrs, l.num_addrs) != 0) {
+            printf("Memory allocation failed.\n");
+            rc = -1;
+        }
+        for (int64_t i = 0; rc == 0 && i < l.num_addrs; ) {
+            int64_t j = i;
+            while (j + 1 < l.num_addrs && l.addrs[j + 1] - l.addrs[j] <= 1)
+                j++;
+            rc = push_range(&l.ranges, l.addrs[i], l.addrs[j]);
+            i = j + 1;
+        }
+    }
+    free(l.addrs);
+
+    // Normalize: sort by start, merge overlapping and adjacent ranges
+    tset_free(s);
+    if (rc == 0 && l.ranges.count > 0) {
+        qsort(l.ranges.ranges, (size_t)l.ranges.count, sizeof(TsRange), cmp_range);
+        for (int64_t i = 0; rc == 0 && i < l.ranges.count; i++)
+            rc = tset_append(s, l.ranges.ranges[i].lo, l.ranges.ranges[i].hi);
+        if (rc != 0)
+            printf("Memory allocation failed.\n");
+    }
+    tset_free(&l.ranges);
+    if (rc != 0)
+        tset_free(s);
+    return rc;
+}
+
+// ---- Algebra ----
+
+int tset_union(TargetSet *out, const TargetSet *a, const TargetSet *b) {
+    tset_free(out);
+    int64_t i = 0, j = 0;
+    while (i < a->count || j < b->count) {
+        const TsRange *r;
+        if (j == b->count || (i < a->count && a->ranges[i].lo <= b->ranges[j].lo))
+            r = &a->ranges[i++];
+        else
+            r = &b->ranges[j++];
+        if (tset_append(out, r->lo, r->hi) != 0) {
+            tset_free(out);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int tset_intersect(TargetSet *out, const TargetSet *a, const TargetSet *b) {
+    tset_free(out);
+    int64_t i = 0, j = 0;
+    while (i < a->count && j < b->count) {
+        const TsRange *x = &a->ranges[i], *y = &b->ranges[j];
+        uint32_t lo = x->lo > y->lo ? x->lo : y->lo;
+        uint32_t hi = x->hi < y->hi ? x->hi : y->hi;
+        if (lo <= hi && push_range(out, lo, hi) != 0) {
+            tset_free(out);
+            return -1;
+        }
+        // Drop whichever range ends first
+        if (x->hi < y->hi)
+            i++;
+        else
+            j++;
+    }
+    return 0;
+}
+
+int tset_subtract(TargetSet *out, const TargetSet *a, const TargetSet *b) {
+    tset_free(out);
+    int64_t j = 0;
+    for (int64_t i = 0; i < a->count; i++) {
+        uint32_t lo = a->ranges[i].lo, hi = a->ranges[i].hi;
+        int empty = 0;
+
+        // Skip exclusions entirely below this range
+        while (j < b->count && b->ranges[j].hi < lo)
+            j++;
+        for (int64_t k = j; !empty && k < b->count && b->ranges[k].lo <= hi; k++) {
+            if (b->ranges[k].lo > lo && push_range(out, lo, b->ranges[k].lo - 1) != 0) {
+                tset_free(out);
+                return -1;
+            }
+            if (b->ranges[k].hi >= hi)
+                empty = 1;
+            else
+                lo = b->ranges[k].hi + 1;
+        }
+        if (!empty && push_range(out, lo, hi) != 0) {
+            tset_free(out);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// ---- Host index ----
+
+int tset_index(TargetSet *s) {
+    free(s->before);
+    s->before = malloc((size_t)(s->count > 0 ? s->count : 1) * sizeof(int64_t));
+    if (s->before == NULL)
+        return -1;
+    s->total = 0;
+    for (int64_t i = 0; i < s->count; i++) {
+        s->before[i] = s->total;
+        s->total += (int64_t)(s->ranges[i].hi - s->ranges[i].lo) + 1;
+    }
+    return 0;
+}
+
+int64_t tset_find(const TargetSet *s, uint32_t addr) {
+    int64_t lo = 0, hi = s->count - 1;
+    while (lo <= hi) {
+        int64_t mid = (lo + hi) / 2;
+        if (addr < s->ranges[mid].lo)
+            hi = mid - 1;
+        else if (addr > s->ranges[mid].hi)
+            lo = mid + 1;
+        else
+            return s->before[mid] + (int64_t)(addr - s->ranges[mid].lo);
+    }
+    return -1;
+}
+
+int64_t tset_rank(const TargetSet *s, uint64_t addr) {
+    // Last range starting below addr
+    int64_t lo = 0, hi = s->count - 1;
+    if (s->count == 0 || addr <= s->ranges[0].lo)
+        return 0;
+    while (lo < hi) {
+        int64_t mid = (lo + hi + 1) / 2;
+        if (s->ranges[mid].lo < addr)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    uint64_t end = (uint64_t)s->ranges[lo].hi + 1;
+    return s->before[lo] + (int64_t)((addr < end ? addr : end) - s->ranges[lo].lo);
+}
@@ -0,0 +1,92 @@
+/*
+ * IPv4 target set algebra
+ * Description:
+ *     Targets often come from several inventories that overlap, plus lists
+ *     of addresses that must not be touched. A target set is a sorted list
+ *     of disjoint, non-adjacent address ranges; union, intersection and
+ *     difference of two sets are linear merges of their range lists, so the
+ *     result stays normalized and every address is probed at most once.
+ *
+ *     Sets are read from target lists: comma-separated and/or one item per
+ *     line, each an address, a.b.c.d/nn block or a.b.c.d-e.f.g.h range
+ *     ('#' starts a comment). Lists of millions of single addresses are
+ *     turned into ranges with a parallel LSD radix sort instead of
+ *     comparing them pairwise.
+ *
+ *     The scanner walks a set by host index (0 .. total-1), which
+ *     tset_addr() maps back to an address with a binary search over the
+ *     ranges' starting indexes.
+ */
+
+#ifndef TARGETSET_H
+#define TARGETSET_H
+
+#include <stdint.h>
+
+// Address lists at least this long are radix sorted with threads
+#define TSET_PARALLEL_MIN (1 << 18)
+#define TSET_SORT_THREADS 4
+
+typedef struct {
+    uint32_t lo, hi;            // inclusive, host byte order
+} TsRange;
+
+typedef struct {
+    TsRange *ranges;            // sorted, disjoint, non-adjacent once normalized
+    int64_t count;
+    int64_t cap;
+    int64_t *before;            // hosts in ranges[0 .. i-1] (after tset_index)
+    int64_t total;              // hosts in the whole set (after tset_index)
+} TargetSet;
+
+void tset_init(TargetSet *s);
+void tset_free(TargetSet *s);
+
+// One item of a list; returns 0, or -1 after printing why
+typedef int (*TsItemFn)(void *ctx, const char *item);
+
+// Call item for each entry of a list: arg is read as a file if one exists
+// by that name, else as a comma-separated list. Entries are separated by
+// commas and whitespace, '#' starts a comment to the end of the line.
+// Returns 0, or -1 (after printing why) as soon as one fails.
+int tset_read_list(const char *arg, TsItemFn item, void *ctx);
+
+// Parse a target list (see tset_read_list) into s, replacing its contents.
+// Returns 0, or -1 after printing why.
+int tset_load(TargetSet *s, const char *arg);
+
+// Append [lo, hi] to a set being built in ascending order (lo at or above
+// the last range's start), merging it into the last range when they overlap
+// or touch. Returns 0, or -1 on allocation failure.
+int tset_append(TargetSet *s, uint32_t lo, uint32_t hi);
+
+// out = a op b; a and b must be normalized, out must not alias them.
+// Returns 0, or -1 on allocation failure.
+int tset_union(TargetSet *out, const TargetSet *a, const TargetSet *b);
+int tset_intersect(TargetSet *out, const TargetSet *a, const TargetSet *b);
+int tset_subtract(TargetSet *out, const TargetSet *a, const TargetSet *b);
+
+// Build the host index used by tset_addr() / tset_find(). Returns 0, or -1
+// on allocation failure.
+int tset_index(TargetSet *s);
+
+// Address of the host'th address in the set (0 <= host < total)
+static inline uint32_t tset_addr(const TargetSet *s, int64_t host) {
+    int64_t lo = 0, hi = s->count - 1;
+    while (lo < hi) {
+        int64_t mid = (lo + hi + 1) / 2;
+        if (s->before[mid] <= host)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return s->ranges[lo].lo + (uint32_t)(host - s->before[lo]);
+}
+
+// Host index of addr, or -1 if it isn't in the set
+int64_t tset_find(const TargetSet *s, uint32_t addr);
+
+// Number of hosts in the set below addr (0 <= addr <= 2^32)
+int64_t tset_rank(const TargetSet *s, uint64_t addr);
+
+#endif
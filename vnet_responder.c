@@ -0,0 +1,611 @@
+/*
+ * Virtual Internet Responder (benchmark companion)
+ * Description:
+ *     Creates a Wintun TUN adapter that owns a large virtual IPv4 prefix and
+ *     answers probes to it in userspace from a seeded model, so port_scanner
+ *     can be benchmarked against millions of hosts on a single machine.
+ *
+ *     For every (host, port) the model decides - deterministically from the
+ *     seed - whether the host is up and whether the port is open (SYN-ACK),
+ *     closed (RST) or filtered (silence). Replies are delayed by a per-host
+ *     RTT and inbound packets are dropped with a configurable loss rate.
+ *     Connections are handled statelessly: the SYN-ACK sequence number is a
+ *     keyed hash of the 4-tuple, so the handshake ACK can be validated and
+ *     answered with an optional banner without any per-connection memory.
+ *
+ * Build:
+ *     gcc vnet_responder.c -o vnet_responder -lws2_32 -liphlpapi
+ *     Requires wintun.dll (https://www.wintun.net) next to the executable
+ *     and an elevated prompt to create the adapter.
+ */
+
+// Enable newer Winsock / IP Helper features
+#define _WIN32_WINNT 0x0601
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <iphlpapi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define TCP_FIN 0x01
+#define TCP_SYN 0x02
+#define TCP_RST 0x04
+#define TCP_PSH 0x08
+#define TCP_ACK 0x10
+
+#define MAX_BANNER 256
+#define MAX_REPLY (20 + 24 + MAX_BANNER)
+
+// Wintun session ring size (must be a power of two, 128 KiB - 64 MiB)
+#define RING_CAPACITY 0x4000000
+
+// ---- Wintun API (resolved from wintun.dll at runtime) ----
+
+typedef void *WINTUN_ADAPTER_HANDLE;
+typedef void *WINTUN_SESSION_HANDLE;
+
+typedef WINTUN_ADAPTER_HANDLE (WINAPI *WintunCreateAdapterFunc)(LPCWSTR, LPCWSTR, const GUID*);
+typedef void (WINAPI *WintunCloseAdapterFunc)(WINTUN_ADAPTER_HANDLE);
+typedef void (WINAPI *WintunGetAdapterLUIDFunc)(WINTUN_ADAPTER_HANDLE, NET_LUID*);
+typedef WINTUN_SESSION_HANDLE (WINAPI *WintunStartSessionFunc)(WINTUN_ADAPTER_HANDLE, DWORD);
+typedef void (WINAPI *WintunEndSessionFunc)(WINTUN_SESSION_HANDLE);
+typedef HANDLE (WINAPI *WintunGetReadWaitEventFunc)(WINTUN_SESSION_HANDLE);
+typedef BYTE *(WINAPI *WintunReceivePacketFunc)(WINTUN_SESSION_HANDLE, DWORD*);
+typedef void (WINAPI *WintunReleaseReceivePacketFunc)(WINTUN_SESSION_HANDLE, const BYTE*);
+typedef BYTE *(WINAPI *WintunAllocateSendPacketFunc)(WINTUN_SESSION_HANDLE, DWORD);
+typedef void (WINAPI *WintunSendPacketFunc)(WINTUN_SESSION_HANDLE, const BYTE*);
+
+static WintunCreateAdapterFunc WintunCreateAdapter;
+static WintunCloseAdapterFunc WintunCloseAdapter;
+static WintunGetAdapterLUIDFunc WintunGetAdapterLUID;
+static WintunStartSessionFunc WintunStartSession;
+static WintunEndSessionFunc WintunEndSession;
+static WintunGetReadWaitEventFunc WintunGetReadWaitEvent;
+static WintunReceivePacketFunc WintunReceivePacket;
+static WintunReleaseReceivePacketFunc WintunReleaseReceivePacket;
+static WintunAllocateSendPacketFunc WintunAllocateSendPacket;
+static WintunSendPacketFunc WintunSendPacket;
+
+// ---- Model ----
+
+typedef struct {
+    uint32_t net;           // virtual prefix (host byte order)
+    uint32_t mask;
+    uint32_t local;         // adapter's own address, never answered
+    uint64_t seed;
+    double hosts_up;        // fraction of hosts that answer at all
+    double open_ratio;      // per port; remainder after closed is filtered
+    double closed_ratio;
+    int rtt_min_ms;
+    int rtt_max_ms;
+    double loss;            // inbound packet loss probability
+    const char *banner;     // sent after the handshake, NULL = none
+    int banner_len;
+} Model;
+
+enum { PORT_CLOSED, PORT_OPEN, PORT_FILTERED };
+
+// splitmix64 finalizer: the model's only source of "randomness"
+static uint64_t mix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static double unit(uint64_t h) {
+    return (double)(h >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int host_up(const Model *m, uint32_t addr) {
+    return unit(mix64(m->seed ^ ((uint64_t)addr << 20) ^ 0x1)) < m->hosts_up;
+}
+
+static int host_rtt_ms(const Model *m, uint32_t addr) {
+    int span = m->rtt_max_ms - m->rtt_min_ms + 1;
+    return m->rtt_min_ms + (int)(mix64(m->seed ^ ((uint64_t)addr << 20) ^ 0x2) % span);
+}
+
+static int port_state(const Model *m, uint32_t addr, uint16_t port) {
+    double u = unit(mix64(m->seed ^ ((uint64_t)addr << 16) ^ port));
+    if (u < m->open_ratio)
+        return PORT_OPEN;
+    if (u < m->open_ratio + m->closed_ratio)
+        return PORT_CLOSED;
+    return PORT_FILTERED;
+}
+
+// Stateless SYN-ACK sequence number for a 4-tuple
+static uint32_t syn_cookie(const Model *m, uint32_t src, uint32_t dst,
+                           uint16_t sport, uint16_t dport) {
+    return (uint32_t)mix64(m->seed ^ ((uint64_t)src << 32 | dst) ^
+                           ((uint64_t)sport << 48) ^ ((uint64_t)dport << 32));
+}
+
+// ---- Delayed reply queue (min-heap on due time) ----
+
+typedef struct {
+    double due;
+    uint16_t len;
+    uint8_t data[MAX_REPLY];
+} Pending;
+
+typedef struct {
+    Pending *items;
+    size_t size;
+    size_t cap;
+} ReplyHeap;
+
+static int heap_push(ReplyHeap *h, const Pending *p) {
+    if (h->size == h->cap) {
+        size_t cap = h->cap ? h->cap * 2 : 4096;
+        Pending *items = realloc(h->items, cap * sizeof(Pending));
+        if (items == NULL)
+            return -1;
+        h->items = items;
+        h->cap = cap;
+    }
+    size_t i = h->size++;
+    while (i > 0 && h->items[(i - 1) / 2].due > p->due) {
+        h->items[i] = h->items[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    h->items[i] = *p;
+    return 0;
+}
+
+static void heap_pop(ReplyHeap *h) {
+    Pending last = h->items[--h->size];
+    size_t i = 0;
+    while (1) {
+        size_t c = 2 * i + 1;
+        if (c >= h->size)
+            break;
+        if (c + 1 < h->size && h->items[c + 1].due < h->items[c].due)
+            c++;
+        if (last.due <= h->items[c].due)
+            break;
+        h->items[i] = h->items[c];
+        i = c;
+    }
+    if (h->size > 0)
+        h->items[i] = last;
+}
+
+// ---- Globals ----
+
+static Model MODEL;
+static ReplyHeap REPLIES;
+static WINTUN_SESSION_HANDLE SESSION;
+static volatile LONG RUNNING = 1;
+static uint16_t IP_ID;
+static uint64_t LOSS_RNG = 0x853C49E6748FEA9BULL;
+
+static struct {
+    uint64_t rx, lost, syn, synack, rst, filtered, banners, echo, tx, tx_full;
+} STATS;
+
+// ---- Packet helpers ----
+
+static uint16_t be16(const uint8_t *p) { return (uint16_t)(p[0] << 8 | p[1]); }
+static uint32_t be32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+static void put16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)(v >> 8); p[1] = (uint8_t)v; }
+static void put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8); p[3] = (uint8_t)v;
+}
+
+static uint32_t sum16(const uint8_t *p, size_t len, uint32_t sum) {
+    for (size_t i = 0; i + 1 < len; i += 2)
+        sum += (uint32_t)(p[i] << 8 | p[i + 1]);
+    if (len & 1)
+        sum += (uint32_t)(p[len - 1] << 8);
+    return sum;
+}
+
+static uint16_t fold(uint32_t sum) {
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+static double now_ms(void) {
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart * 1000.0 / (double)freq.QuadPart;
+}
+
+// Fill in a 20-byte IPv4 header in front of a payload of payload_len
+static void build_ip(uint8_t *ip, uint32_t src, uint32_t dst, uint8_t proto, int payload_len) {
+    memset(ip, 0, 20);
+    ip[0] = 0x45;
+    put16(ip + 2, (uint16_t)(20 + payload_len));
+    put16(ip + 4, IP_ID++);
+    put16(ip + 6, 0x4000);          // don't fragment
+    ip[8] = 64;
+    ip[9] = proto;
+    put32(ip + 12, src);
+    put32(ip + 16, dst);
+    put16(ip + 10, fold(sum16(ip, 20, 0)));
+}
+
+// Queue a TCP segment from (src, sport) to (dst, dport) after delay_ms
+static void queue_tcp(uint32_t src, uint32_t dst, uint16_t sport, uint16_t dport,
+                      uint32_t seq, uint32_t ack, uint8_t flags, int with_mss,
+                      const char *data, int data_len, int delay_ms) {
+    Pending p;
+    uint8_t *ip = p.data, *tcp = p.data + 20;
+    int hdr = with_mss ? 24 : 20;
+    int tcp_len = hdr + data_len;
+
+    memset(tcp, 0, hdr);
+    put16(tcp, sport);
+    put16(tcp + 2, dport);
+    put32(tcp + 4, seq);
+    put32(tcp + 8, ack);
+    tcp[12] = (uint8_t)((hdr / 4) << 4);
+    tcp[13] = flags;
+    put16(tcp + 14, 64240);
+    if (with_mss) {
+        tcp[20] = 2;
+        tcp[21] = 4;
+        put16(tcp + 22, 1460);
+    }
+    if (data_len > 0)
+        memcpy(tcp + hdr, data, data_len);
+
+    // Pseudo-header checksum
+    uint32_t sum = (src >> 16) + (src & 0xffff) + (dst >> 16) + (dst & 0xffff) +
+                   6 + (uint32_t)tcp_len;
+    put16(tcp + 16, fold(sum16(tcp, tcp_len, sum)));
+
+    build_ip(ip, src, dst, 6, tcp_len);
+    p.len = (uint16_t)(20 + tcp_len);
+    p.due = now_ms() + delay_ms;
+    if (heap_push(&REPLIES, &p) != 0)
+        STATS.tx_full++;
+}
+
+// Hand every reply whose delay has elapsed to the adapter
+static void flush_due(void) {
+    double now = now_ms();
+    while (REPLIES.size > 0 && REPLIES.items[0].due <= now) {
+        Pending *p = &REPLIES.items[0];
+        BYTE *out = WintunAllocateSendPacket(SESSION, p->len);
+        if (out != NULL) {
+            memcpy(out, p->data, p->len);
+            WintunSendPacket(SESSION, out);
+            STATS.tx++;
+        } else {
+            STATS.tx_full++; // ring full: behaves like loss
+        }
+        heap_pop(&REPLIES);
+    }
+}
+
+// ---- Protocol handlers ----
+
+static void handle_tcp(uint32_t src, uint32_t dst, const uint8_t *t, int len) {
+    const Model *m = &MODEL;
+    if (len < 20)
+        return;
+
+    uint16_t sport = be16(t), dport = be16(t + 2);
+    uint32_t seq = be32(t + 4), ack = be32(t + 8);
+    int doff = (t[12] >> 4) * 4;
+    uint8_t flags = t[13];
+    int payload = len - doff;
+    if (doff < 20 || payload < 0 || (flags & TCP_RST))
+        return;
+
+    int state = port_state(m, dst, dport);
+    int rtt = host_rtt_ms(m, dst);
+
+    if ((flags & (TCP_SYN | TCP_ACK)) == TCP_SYN) {
+        STATS.syn++;
+        if (state == PORT_OPEN) {
+            uint32_t cookie = syn_cookie(m, src, dst, sport, dport);
+            queue_tcp(dst, src, dport, sport, cookie, seq + 1,
+                      TCP_SYN | TCP_ACK, 1, NULL, 0, rtt);
+            STATS.synack++;
+        } else if (state == PORT_CLOSED) {
+            queue_tcp(dst, src, dport, sport, 0, seq + 1,
+                      TCP_RST | TCP_ACK, 0, NULL, 0, rtt);
+            STATS.rst++;
+        } else {
+            STATS.filtered++;
+        }
+        return;
+    }
+
+    if (state == PORT_FILTERED)
+        return;
+
+    // Handshake completion on an open port: optionally greet with a banner
+    uint32_t cookie = syn_cookie(m, src, dst, sport, dport);
+    if (state == PORT_OPEN && (flags & TCP_ACK) && ack == cookie + 1 &&
+        payload == 0 && !(flags & TCP_FIN)) {
+        if (m->banner != NULL) {
+            queue_tcp(dst, src, dport, sport, cookie + 1, seq,
+                      TCP_PSH | TCP_ACK, 0, m->banner, m->banner_len, rtt);
+            STATS.banners++;
+        }
+        return;
+    }
+
+    // Client data, FIN, or an ACK we never sent a SYN-ACK for: reset. Pure
+    // ACKs acknowledging our banner are silently accepted.
+    if (state == PORT_OPEN && (flags & TCP_ACK) && payload == 0 && !(flags & TCP_FIN) &&
+        ack == cookie + 1 + (uint32_t)m->banner_len)
+        return;
+    queue_tcp(dst, src, dport, sport, (flags & TCP_ACK) ? ack : 0,
+              seq + (uint32_t)payload + ((flags & TCP_FIN) ? 1 : 0),
+              (flags & TCP_ACK) ? TCP_RST : (TCP_RST | TCP_ACK), 0, NULL, 0, rtt);
+    STATS.rst++;
+}
+
+static void handle_icmp(uint32_t src, uint32_t dst, const uint8_t *icmp, int len) {
+    if (len < 8 || icmp[0] != 8 || len > MAX_REPLY - 20)
+        return;
+
+    Pending p;
+    memcpy(p.data + 20, icmp, len);
+    p.data[20] = 0;                 // echo reply
+    put16(p.data + 22, 0);
+    put16(p.data + 22, fold(sum16(p.data + 20, len, 0)));
+    build_ip(p.data, dst, src, 1, len);
+    p.len = (uint16_t)(20 + len);
+    p.due = now_ms() + host_rtt_ms(&MODEL, dst);
+    if (heap_push(&REPLIES, &p) != 0)
+        STATS.tx_full++;
+    STATS.echo++;
+}
+
+static void handle_packet(const uint8_t *p, DWORD len) {
+    const Model *m = &MODEL;
+    if (len < 20 || (p[0] >> 4) != 4)
+        return;
+
+    int ihl = (p[0] & 0x0f) * 4;
+    int total = be16(p + 2);
+    if (ihl < 20 || total < ihl || (DWORD)total > len)
+        return;
+    if (be16(p + 6) & 0x3fff)
+        return;                     // fragments are not modeled
+
+    uint32_t src = be32(p + 12), dst = be32(p + 16);
+    if ((dst & m->mask) != m->net || dst == m->local)
+        return;
+
+    STATS.rx++;
+    if (m->loss > 0.0) {
+        LOSS_RNG = mix64(LOSS_RNG);
+        if (unit(LOSS_RNG) < m->loss) {
+            STATS.lost++;
+            return;
+        }
+    }
+    if (!host_up(m, dst))
+        return;
+
+    if (p[9] == 6)
+        handle_tcp(src, dst, p + ihl, total - ihl);
+    else if (p[9] == 1)
+        handle_icmp(src, dst, p + ihl, total - ihl);
+}
+
+// ---- Setup ----
+
+static int load_wintun(const char *path) {
+    HMODULE dll = LoadLibraryExA(path, NULL, LOAD_LIBRARY_SEARCH_APPLICATION_DIR |
+                                 LOAD_LIBRARY_SEARCH_SYSTEM32);
+    if (dll == NULL)
+        dll = LoadLibraryA(path);
+    if (dll == NULL) {
+        printf("Could not load %s (get it from https://www.wintun.net).\n", path);
+        return -1;
+    }
+
+#define RESOLVE(name) \
+    if ((name = (name##Func)(void*)GetProcAddress(dll, #name)) == NULL) { \
+        printf("%s is missing %s.\n", path, #name); \
+        return -1; \
+    }
+    RESOLVE(WintunCreateAdapter)
+    RESOLVE(WintunCloseAdapter)
+    RESOLVE(WintunGetAdapterLUID)
+    RESOLVE(WintunStartSession)
+    RESOLVE(WintunEndSession)
+    RESOLVE(WintunGetReadWaitEvent)
+    RESOLVE(WintunReceivePacket)
+    RESOLVE(WintunReleaseReceivePacket)
+    RESOLVE(WintunAllocateSendPacket)
+    RESOLVE(WintunSendPacket)
+#undef RESOLVE
+    return 0;
+}
+
+// Give the adapter the first address of the prefix; the on-link prefix
+// length routes the whole virtual network through the TUN
+static int assign_prefix(WINTUN_ADAPTER_HANDLE adapter, uint32_t local, int prefix_len) {
+    MIB_UNICASTIPADDRESS_ROW row;
+    InitializeUnicastIpAddressEntry(&row);
+    WintunGetAdapterLUID(adapter, &row.InterfaceLuid);
+    row.Address.Ipv4.sin_family = AF_INET;
+    row.Address.Ipv4.sin_addr.s_addr = htonl(local);
+    row.OnLinkPrefixLength = (UINT8)prefix_len;
+    row.DadState = IpDadStatePreferred;
+
+    DWORD err = CreateUnicastIpAddressEntry(&row);
+    if (err != ERROR_SUCCESS && err != ERROR_OBJECT_ALREADY_EXISTS) {
+        printf("Failed to assign address to adapter (error %lu).\n", (unsigned long)err);
+        return -1;
+    }
+    return 0;
+}
+
+static BOOL WINAPI on_ctrl(DWORD type) {
+    (void)type;
+    InterlockedExchange(&RUNNING, 0);
+    return TRUE;
+}
+
+static void print_stats(void) {
+    printf("rx=%llu lost=%llu syn=%llu synack=%llu rst=%llu filtered=%llu "
+           "banners=%llu echo=%llu tx=%llu tx_drop=%llu pending=%zu\n",
+           (unsigned long long)STATS.rx, (unsigned long long)STATS.lost,
+           (unsigned long long)STATS.syn, (unsigned long long)STATS.synack,
+           (unsigned long long)STATS.rst, (unsigned long long)STATS.filtered,
+           (unsigned long long)STATS.banners, (unsigned long long)STATS.echo,
+           (unsigned long long)STATS.tx, (unsigned long long)STATS.tx_full,
+           REPLIES.size);
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s <prefix/len> [--seed n] [--hosts-up r] [--open r] [--closed r]\n"
+           "          [--rtt min_ms-max_ms] [--loss p] [--banner text] [--wintun dll]\n",
+           prog);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Model *m = &MODEL;
+    m->seed = 1;
+    m->hosts_up = 1.0;
+    m->open_ratio = 0.02;
+    m->closed_ratio = 0.28;
+    m->rtt_min_ms = 10;
+    m->rtt_max_ms = 80;
+    const char *dll_path = "wintun.dll";
+
+    char prefix[64];
+    snprintf(prefix, sizeof(prefix), "%s", argv[1]);
+    char *slash = strchr(prefix, '/');
+    int prefix_len = slash ? atoi(slash + 1) : -1;
+    if (slash)
+        *slash = '\0';
+    struct in_addr net;
+    if (prefix_len < 8 || prefix_len > 30 || inet_pton(AF_INET, prefix, &net) != 1) {
+        printf("Prefix must be an IPv4 CIDR block between /8 and /30: %s\n", argv[1]);
+        return 1;
+    }
+    m->mask = 0xffffffffu << (32 - prefix_len);
+    m->net = ntohl(net.s_addr) & m->mask;
+    m->local = m->net + 1;
+
+    for (int i = 2; i < argc; i++) {
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (val == NULL) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--seed") == 0) m->seed = strtoull(val, NULL, 0);
+        else if (strcmp(argv[i], "--hosts-up") == 0) m->hosts_up = atof(val);
+        else if (strcmp(argv[i], "--open") == 0) m->open_ratio = atof(val);
+        else if (strcmp(argv[i], "--closed") == 0) m->closed_ratio = atof(val);
+        else if (strcmp(argv[i], "--loss") == 0) m->loss = atof(val);
+        else if (strcmp(argv[i], "--wintun") == 0) dll_path = val;
+        else if (strcmp(argv[i], "--banner") == 0) {
+            m->banner = val;
+            m->banner_len = (int)strlen(val);
+            if (m->banner_len > MAX_BANNER)
+                m->banner_len = MAX_BANNER;
+        } else if (strcmp(argv[i], "--rtt") == 0) {
+            if (sscanf(val, "%d-%d", &m->rtt_min_ms, &m->rtt_max_ms) != 2)
+                m->rtt_max_ms = m->rtt_min_ms = atoi(val);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+
+    if (m->rtt_min_ms < 0) m->rtt_min_ms = 0;
+    if (m->rtt_max_ms < m->rtt_min_ms) m->rtt_max_ms = m->rtt_min_ms;
+    if (m->open_ratio + m->closed_ratio > 1.0) {
+        printf("--open + --closed must not exceed 1.\n");
+        return 1;
+    }
+
+    if (load_wintun(dll_path) != 0)
+        return 1;
+
+    WINTUN_ADAPTER_HANDLE adapter = WintunCreateAdapter(L"VirtualInternet", L"PortScannerBench", NULL);
+    if (adapter == NULL) {
+        printf("Failed to create adapter (error %lu); run elevated.\n",
+               (unsigned long)GetLastError());
+        return 1;
+    }
+    if (assign_prefix(adapter, m->local, prefix_len) != 0) {
+        WintunCloseAdapter(adapter);
+        return 1;
+    }
+
+    SESSION = WintunStartSession(adapter, RING_CAPACITY);
+    if (SESSION == NULL) {
+        printf("Failed to start session (error %lu).\n", (unsigned long)GetLastError());
+        WintunCloseAdapter(adapter);
+        return 1;
+    }
+    HANDLE read_event = WintunGetReadWaitEvent(SESSION);
+    SetConsoleCtrlHandler(on_ctrl, TRUE);
+
+    struct in_addr local;
+    local.s_addr = htonl(m->local);
+    char local_ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &local, local_ip, sizeof(local_ip));
+    printf("Responding for %s/%d (adapter %s), seed=%llu, up=%.2f open=%.3f closed=%.3f "
+           "rtt=%d-%d ms loss=%.3f. Ctrl+C to stop.\n",
+           prefix, prefix_len, local_ip, (unsigned long long)m->seed, m->hosts_up,
+           m->open_ratio, m->closed_ratio, m->rtt_min_ms, m->rtt_max_ms, m->loss);
+
+    double next_stats = now_ms() + 1000.0;
+    while (RUNNING) {
+        DWORD len;
+        BYTE *pkt = WintunReceivePacket(SESSION, &len);
+        if (pkt != NULL) {
+            handle_packet(pkt, len);
+            WintunReleaseReceivePacket(SESSION, pkt);
+            // Keep replies flowing under sustained load
+            if ((STATS.rx & 63) == 0)
+                flush_due();
+            continue;
+        }
+        if (GetLastError() != ERROR_NO_MORE_ITEMS) {
+            printf("Receive failed (error %lu).\n", (unsigned long)GetLastError());
+            break;
+        }
+
+        flush_due();
+        double now = now_ms();
+        if (now >= next_stats) {
+            print_stats();
+            next_stats = now + 1000.0;
+        }
+
+        // Sleep until a packet arrives or the next reply is due
+        double wait = next_stats - now;
+        if (REPLIES.size > 0 && REPLIES.items[0].due - now < wait)
+            wait = REPLIES.items[0].due - now;
+        WaitForSingleObject(read_event, wait > 0 ? (DWORD)wait : 0);
+    }
+
+    print_stats();
+    WintunEndSession(SESSION);
+    WintunCloseAdapter(adapter);
+    free(REPLIES.items);
+    return 0;
+}
@@ -0,0 +1,196 @@
+/*
+ * Weighted target groups (see weights.h)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scanner.h"
+#include "targetset.h"
+#include "weights.h"
+
+static int parse_rule(void *ctx, const char *item) {
+    WfqSched *s = ctx;
+    const char *eq = strchr(item, '=');
+    char spec[48];
+    int64_t count;
+    char *end;
+
+    if (eq == NULL || (size_t)(eq - item) >= sizeof(spec)) {
+        printf("Invalid weight (expected block=weight): %s\n", item);
+        return -1;
+    }
+    if (s->num_rules == WEIGHT_MAX_RULES) {
+        printf("Weights: at most %d blocks.\n", WEIGHT_MAX_RULES);
+        return -1;
+    }
+    memcpy(spec, item, (size_t)(eq - item));
+    spec[eq - item] = '\0';
+
+    WeightRule *r = &s->rules[s->num_rules];
+    r->weight = strtod(eq + 1, &end);
+    if (parse_target(spec, &r->lo, &count) != 0 || *end != '\0' || !(r->weight > 0.0)) {
+        printf("Invalid weight: %s\n", item);
+        return -1;
+    }
+    r->hi = (uint32_t)(r->lo + (count - 1));
+    snprintf(r->spec, sizeof(r->spec), "%s", spec);
+    s->num_rules++;
+    return 0;
+}
+
+int wfq_parse(WfqSched *s, const char *arg) {
+    memset(s, 0, sizeof(*s));
+    return tset_read_list(arg, parse_rule, s);
+}
+
+// Host index spans tagged with the rule that owns them (-1 = other)
+typedef struct {
+    int64_t lo, hi;
+    int rule;
+} Paint;
+
+// Append p to out[0 .. m-1], merging it into the last span when they
+// touch and belong to the same rule; returns the new count
+static int push_paint(Paint *out, int m, Paint p) {
+    if (m > 0 && out[m - 1].rule == p.rule && out[m - 1].hi == p.lo) {
+        out[m - 1].hi = p.hi;
+        return m;
+    }
+    out[m] = p;
+    return m + 1;
+}
+
+// Rules by block size, broader first, so more specific ones paint over them
+typedef struct {
+    uint32_t size;
+    int rule;
+} RuleOrder;
+
+static int cmp_rule_size(const void *a, const void *b) {
+    const RuleOrder *x = a, *y = b;
+    return x->size > y->size ? -1 : x->size < y->size ? 1 : x->rule - y->rule;
+}
+
+int wfq_build(WfqSched *s, int64_t num_hosts, int num_ports, WfqRankFn rank, void *ctx) {
+    s->num_ports = num_ports;
+
+    // Every rule can split one span in three
+    int cap = 1 + 2 * s->num_rules;
+    Paint *paint = malloc((size_t)cap * sizeof(Paint));
+    Paint *next = malloc((size_t)cap * sizeof(Paint));
+    RuleOrder order[WEIGHT_MAX_RULES];
+    if (paint == NULL || next == NULL) {
+        printf("Memory allocation failed.\n");
+        free(paint);
+        free(next);
+        return -1;
+    }
+
+    int n = 0;
+    paint[n++] = (Paint){ 0, num_hosts, -1 };
+    for (int i = 0; i < s->num_rules; i++)
+        order[i] = (RuleOrder){ s->rules[i].hi - s->rules[i].lo, i };
+    qsort(order, (size_t)s->num_rules, sizeof(RuleOrder), cmp_rule_size);
+
+    for (int k = 0; k < s->num_rules; k++) {
+        const WeightRule *r = &s->rules[order[k].rule];
+        int64_t a = rank(ctx, r->lo), b = rank(ctx, (uint64_t)r->hi + 1);
+        if (a >= b)
+            continue;       // no targets in this block
+        int m = 0;
+        for (int i = 0; i < n; i++) {
+            Paint p = paint[i];
+            if (p.hi <= a || p.lo >= b) {
+                m = push_paint(next, m, p);
+                continue;
+            }
+            if (p.lo < a)
+                m = push_paint(next, m, (Paint){ p.lo, a, p.rule });
+            m = push_paint(next, m, (Paint){ p.lo > a ? p.lo : a, p.hi < b ? p.hi : b,
+                                             order[k].rule });
+            if (p.hi > b)
+                m = push_paint(next, m, (Paint){ b, p.hi, p.rule });
+        }
+        Paint *t = paint;
+        paint = next;
+        next = t;
+        n = m;
+    }
+    free(next);
+
+    // One group per rule that kept any hosts, plus "other"
+    s->groups = calloc((size_t)s->num_rules + 1, sizeof(WfqGroup));
+    if (s->groups == NULL) {
+        printf("Memory allocation failed.\n");
+        free(paint);
+        return -1;
+    }
+    for (int rule = -1; rule < s->num_rules; rule++) {
+        WfqGroup *g = &s->groups[s->num_groups];
+        for (int i = 0; i < n; i++)
+            g->num_spans += paint[i].rule == rule;
+        if (g->num_spans == 0)
+            continue;
+        g->spans = malloc((size_t)g->num_spans * sizeof(WfqSpan));
+        if (g->spans == NULL) {
+            printf("Memory allocation failed.\n");
+            free(paint);
+            wfq_free(s);
+            return -1;
+        }
+        g->num_spans = 0;
+        for (int i = 0; i < n; i++) {
+            if (paint[i].rule != rule)
+                continue;
+            g->spans[g->num_spans++] = (WfqSpan){ paint[i].lo, paint[i].hi };
+            g->jobs += (paint[i].hi - paint[i].lo) * num_ports;
+        }
+        g->rule = rule >= 0 ? &s->rules[rule] : NULL;
+        g->weight = rule >= 0 ? s->rules[rule].weight : WEIGHT_DEFAULT;
+        g->next = g->spans[0].lo * num_ports;
+        s->num_groups++;
+    }
+    free(paint);
+    return 0;
+}
+
+int64_t wfq_next(WfqSched *s) {
+    WfqGroup *best = NULL;
+    for (int i = 0; i < s->num_groups; i++) {
+        WfqGroup *g = &s->groups[i];
+        if (g->handed < g->jobs && (best == NULL || g->vtime < best->vtime))
+            best = g;
+    }
+    if (best == NULL)
+        return -1;
+
+    int64_t job = best->next++;
+    best->handed++;
+    best->vtime = best->handed / best->weight;
+    if (best->next == best->spans[best->span].hi * s->num_ports && best->span + 1 < best->num_spans) {
+        best->span++;
+        best->next = best->spans[best->span].lo * s->num_ports;
+    }
+    if (best->handed == best->jobs)
+        best->done_ms = now_ms();
+    return job;
+}
+
+void wfq_report(const WfqSched *s, double start_ms) {
+    for (int i = 0; i < s->num_groups; i++) {
+        const WfqGroup *g = &s->groups[i];
+        printf("Weights: %-20s weight %-6g %lld probes, last sent after %.2f s\n",
+               g->rule != NULL ? g->rule->spec : "other", g->weight, (long long)g->jobs,
+               g->done_ms > 0.0 ? (g->done_ms - start_ms) / 1000.0 : 0.0);
+    }
+}
+
+void wfq_free(WfqSched *s) {
+    for (int i = 0; i < s->num_groups; i++)
+        free(s->groups[i].spans);
+    free(s->groups);
+    s->groups = NULL;
+    s->num_groups = 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * Weighted target groups (--weights)
+ * Description:
+ *     Some networks matter more than others. A weight list such as
+ *     "10.1.0.0/16=10,10.9.0.0/16=0.2" splits the targets into groups
+ *     (each address goes to the most specific block that contains it,
+ *     everything else to a weight-1 "other" group), and the job queue
+ *     hands out probes across the groups by weighted fair queuing: each
+ *     group's virtual time advances by 1/weight per probe, and the next
+ *     probe comes from the group furthest behind. A weight-10 group gets
+ *     ten probes for every one of a weight-1 group while both have work,
+ *     so critical segments finish first, and low-weight space runs at full
+ *     speed once they are done.
+ *
+ *     Within a group, probes stay in host-major (address, port) order.
+ *     Groups are spans of host indexes, so job numbers, and everything
+ *     indexed by them, are the same as for an unweighted scan.
+ */
+
+#ifndef WEIGHTS_H
+#define WEIGHTS_H
+
+#include <stdint.h>
+
+// Weight blocks accepted in one list, and the weight of unlisted targets
+#define WEIGHT_MAX_RULES 64
+#define WEIGHT_DEFAULT 1.0
+
+typedef struct {
+    uint32_t lo, hi;            // inclusive, host byte order
+    double weight;
+    char spec[48];              // as written, for the report
+} WeightRule;
+
+typedef struct {
+    int64_t lo, hi;             // host indexes [lo, hi)
+} WfqSpan;
+
+typedef struct {
+    const WeightRule *rule;     // NULL = the "other" group
+    double weight;
+    WfqSpan *spans;             // ascending
+    int num_spans;
+    int span;                   // current span
+    int64_t next;               // next job of the current span
+    int64_t jobs;               // total jobs in the group
+    int64_t handed;             // jobs handed out so far
+    double vtime;               // virtual time: handed / weight
+    double done_ms;             // when the last job was handed out
+} WfqGroup;
+
+typedef struct {
+    WeightRule rules[WEIGHT_MAX_RULES];
+    int num_rules;
+    WfqGroup *groups;           // groups that have targets
+    int num_groups;
+    int num_ports;
+} WfqSched;
+
+// Parse a weight list (read by tset_read_list) of "block=weight" items,
+// where block is an address, a.b.c.d/nn or a.b.c.d-e.f.g.h. Returns 0, or
+// -1 after printing why.
+int wfq_parse(WfqSched *s, const char *arg);
+
+// Number of target hosts whose address is below addr (0 .. 2^32)
+typedef int64_t (*WfqRankFn)(void *ctx, uint64_t addr);
+
+// Split num_hosts target hosts (ranked by rank) into groups. Returns 0, or
+// -1 after printing why.
+int wfq_build(WfqSched *s, int64_t num_hosts, int num_ports, WfqRankFn rank, void *ctx);
+
+// Next job by weighted fair queuing, or -1 once every group is done.
+// Not thread-safe: the caller holds the job queue lock.
+int64_t wfq_next(WfqSched *s);
+
+// When each group's last probe went out, relative to start_ms
+void wfq_report(const WfqSched *s, double start_ms);
+
+void wfq_free(WfqSched *s);
+
+#endif